@@ -6,6 +6,7 @@
 #include <fstream>
 #include <iomanip>
 #include <limits>
+#include <random>
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
@@ -19,7 +20,8 @@ namespace {
 constexpr int kTileSize = 32;
 constexpr int kDefaultWidth = 256;
 constexpr int kDefaultHeight = 144;
-constexpr int kCalendarDaysPerCoarseDay = 30;
+constexpr int kProfilerTraceFrames = 300;
+constexpr const char* kProfilerTracePath = "profile_trace.json";
 
 float Clamp(float value, float min_value, float max_value) {
   if (value < min_value) return min_value;
@@ -33,6 +35,7 @@ App::App() : world_(kDefaultWidth, kDefaultHeight) {
 }
 
 App::~App() {
+  deathLogWriter_.Close();
   WriteDeathLog();
   rendererAssets_.Shutdown();
 
@@ -56,6 +59,10 @@ App::~App() {
 bool App::Init() {
   CrashContextSetStage("App::Init");
   CrashContextSetWorld(world_.width(), world_.height());
+  if (!deathLogWriter_.Open("death_log.csv")) {
+    SDL_Log("Death log: could not open death_log.csv");
+  }
+  humans_.SetDeathLogSink(&deathLogWriter_);
   SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
 
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
@@ -123,21 +130,41 @@ void App::Run() {
   const double freq = static_cast<double>(SDL_GetPerformanceFrequency());
 
   while (running_) {
-    HandleEvents();
+    ProfilerBeginFrame();
+    {
+      FUNSIM_PROFILE_ZONE("App::HandleEvents");
+      HandleEvents();
+    }
 
     Uint64 now = SDL_GetPerformanceCounter();
     float dt = static_cast<float>((now - lastCounter) / freq);
     lastCounter = now;
 
-    ImGui_ImplSDLRenderer2_NewFrame();
-    ImGui_ImplSDL2_NewFrame();
-    ImGui::NewFrame();
+    {
+      FUNSIM_PROFILE_ZONE("App::DrawUI");
+      ImGui_ImplSDLRenderer2_NewFrame();
+      ImGui_ImplSDL2_NewFrame();
+      ImGui::NewFrame();
 
-    DrawUI(ui_, stats_, factions_, settlements_, humans_, hoverInfo_);
+      DrawUI(ui_, stats_, factions_, settlements_, humans_, hoverInfo_);
+    }
 
     Update(dt);
 
     RenderFrame();
+    ProfilerEndFrame();
+
+    if (ui_.profilerDumpTrace) {
+      ui_.profilerDumpTrace = false;
+      if (!ProfilerEnabled()) {
+        ProfilerSetEnabled(true);
+        SDL_Log("Profiler: recording started; dump again to write a trace");
+      } else if (ProfilerWriteChromeTrace(kProfilerTracePath, kProfilerTraceFrames)) {
+        SDL_Log("Profiler: wrote last %d frames to %s", kProfilerTraceFrames, kProfilerTracePath);
+      } else {
+        SDL_Log("Profiler: could not write %s", kProfilerTracePath);
+      }
+    }
   }
 }
 
@@ -147,6 +174,9 @@ void App::HandleEvents() {
     ImGui_ImplSDL2_ProcessEvent(&event);
     if (event.type == SDL_QUIT) {
       running_ = false;
+    } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9 &&
+               event.key.repeat == 0) {
+      ui_.profilerDumpTrace = true;
 #if SDL_VERSION_ATLEAST(2, 0, 2)
     } else if (event.type == SDL_RENDER_TARGETS_RESET) {
       rendererAssets_.OnRenderTargetsReset();
@@ -184,6 +214,7 @@ void App::HandleEvents() {
 }
 
 void App::Update(float dt) {
+  FUNSIM_PROFILE_ZONE("App::Update");
   ImGuiIO& io = ImGui::GetIO();
 
   if (ui_.saveMap) {
@@ -191,6 +222,10 @@ void App::Update(float dt) {
       SDL_Log("Failed to save map: %s", ui_.mapPath);
     }
   }
+  if ((ui_.loadMap || ui_.newWorld || ui_.stopReplayRecording) && replayRecorder_.Active()) {
+    SDL_Log("Replay: stopped recording %s", replayRecorder_.Path().c_str());
+    replayRecorder_.End();
+  }
   if (ui_.loadMap) {
     if (!LoadMap(ui_.mapPath)) {
       SDL_Log("Failed to load map: %s", ui_.mapPath);
@@ -200,12 +235,19 @@ void App::Update(float dt) {
     int scale = (ui_.worldSizeIndex == 1) ? 4 : 1;
     CreateNewWorld(scale);
   }
+  if (ui_.startReplayRecording) {
+    StartReplayRecording();
+  }
+  ui_.replayRecording = replayRecorder_.Active();
 
   UpdateWholeMapView();
   factions_.SetWarEnabled(ui_.warEnabled);
   settlements_.SetRebellionsEnabled(ui_.rebellionsEnabled);
   humans_.SetAllowStarvationDeath(ui_.starvationDeathEnabled);
+  replayRecorder_.RecordToggles(ui_.warEnabled, ui_.rebellionsEnabled, ui_.starvationDeathEnabled);
+  replayRecorder_.RecordSpeed(ui_.speedIndex);
   if (ui_.requestArmyOrdersRefresh && !macroActive_) {
+    replayRecorder_.RecordArmyOrders();
     settlements_.UpdateArmyOrders(world_, humans_, rng_, stats_.dayCount, 1, factions_);
   }
 
@@ -278,7 +320,16 @@ void App::Update(float dt) {
     ExitMacroMode();
   }
 
-  if (!ui_.paused) {
+  // Leaving macro mode on a large world rebuilds humans over several frames; hold the clock
+  // until every settlement is back on the per-human model.
+  const bool rehydrating = humans_.MacroExitPending();
+  if (rehydrating) {
+    replayRecorder_.RecordRehydrate(maxRehydratePerFrame_);
+    humans_.StepExitMacro(settlements_, maxRehydratePerFrame_);
+    worldDirty_ = true;
+  }
+
+  if (!ui_.paused && !rehydrating) {
     double speed = 1.0;
     if (ui_.speedIndex == 1) speed = 5.0;
     if (ui_.speedIndex == 2) speed = 20.0;
@@ -286,9 +337,12 @@ void App::Update(float dt) {
     if (ui_.speedIndex == 4) speed = 2000.0;
     accumulator_ += static_cast<double>(dt) * speed;
     if (wantsMacro) {
+      // Only whole batches are advanced and the rest stays in the accumulator, so batch
+      // boundaries do not depend on frame timing.
       int daysToAdvance = static_cast<int>(accumulator_ / daySeconds_);
+      if (daysToAdvance > maxMacroDaysPerFrame_) daysToAdvance = maxMacroDaysPerFrame_;
+      daysToAdvance -= daysToAdvance % macroBatchDays_;
       if (daysToAdvance > 0) {
-        if (daysToAdvance > maxMacroDaysPerFrame_) daysToAdvance = maxMacroDaysPerFrame_;
         accumulator_ -= static_cast<double>(daysToAdvance) * daySeconds_;
         AdvanceMacro(daysToAdvance);
       }
@@ -298,20 +352,24 @@ void App::Update(float dt) {
         StepTick(static_cast<float>(tickSeconds_));
         accumulator_ -= tickSeconds_;
         tickCount_++;
+        replayRecorder_.RecordTicks(1);
         if ((tickCount_ % ticksPerDay_) == 0) {
-          StepDayCoarse(kCalendarDaysPerCoarseDay);
+          StepDayCoarse(SimHarness::kCalendarDaysPerCoarseDay);
+          RecordReplayDay();
         }
         steps++;
       }
     }
   }
 
-  if (ui_.stepDay) {
+  if (ui_.stepDay && !rehydrating) {
     if (wantsMacro) {
       AdvanceMacro(1);
     } else {
+      replayRecorder_.RecordStepDay(1);
       tickCount_ += ticksPerDay_;
       StepDayCoarse(1);
+      RecordReplayDay();
     }
   }
 
@@ -322,6 +380,7 @@ void App::Update(float dt) {
 }
 
 void App::RenderFrame() {
+  FUNSIM_PROFILE_ZONE("App::RenderFrame");
   int winW = 0;
   int winH = 0;
   SDL_GetWindowSize(window_, &winW, &winH);
@@ -347,62 +406,26 @@ void App::RenderFrame() {
   SDL_RenderPresent(renderer_);
 }
 
+SimSystems App::Systems() {
+  return {world_, humans_, settlements_, factions_, rng_, villageMarkers_};
+}
+
 void App::StepTick(float tickSeconds) {
-  CrashContextSetStage("StepTick:Humans");
-  humans_.UpdateTick(world_, settlements_, rng_, tickCount_, tickSeconds, ticksPerDay_);
+  SimStepTick(Systems(), tickCount_, tickSeconds, ticksPerDay_);
 }
 
 void App::StepDayCoarse(int dayDelta) {
-  if (dayDelta < 1) dayDelta = 1;
-  stats_.birthsToday = 0;
-  stats_.deathsToday = 0;
-  stats_.dayCount += dayDelta;
-  CrashContextSetDay(stats_.dayCount);
-  std::vector<int> warsBefore;
-  for (const auto& war : factions_.Wars()) {
-    if (war.active) warsBefore.push_back(war.id);
-  }
-  CrashContextSetStage("StepDay:World");
-  world_.UpdateDaily(rng_, dayDelta);
-  CrashContextSetStage("StepDay:Settlements");
-  settlements_.UpdateDaily(world_, humans_, rng_, stats_.dayCount, dayDelta, villageMarkers_, factions_);
-  int warDeathsToday = settlements_.ConsumeWarDeaths();
-  CrashContextSetStage("StepDay:Humans");
-  humans_.UpdateDailyCoarse(world_, settlements_, rng_, stats_.dayCount, dayDelta, stats_.birthsToday,
-                            stats_.deathsToday);
-  stats_.deathsToday += warDeathsToday;
+  const SimStepCounts counts = SimStepDayCoarse(Systems(), stats_.dayCount, dayDelta);
+  stats_.birthsToday = counts.births;
+  stats_.deathsToday = counts.deaths;
   stats_.totalBirths += stats_.birthsToday;
   stats_.totalDeaths += stats_.deathsToday;
-  for (auto& marker : villageMarkers_) {
-    if (marker.ttlDays > 0) {
-      marker.ttlDays = std::max(0, marker.ttlDays - dayDelta);
-    }
-  }
-  villageMarkers_.erase(
-      std::remove_if(villageMarkers_.begin(), villageMarkers_.end(),
-                     [](const VillageMarker& marker) { return marker.ttlDays <= 0; }),
-      villageMarkers_.end());
-  factions_.UpdateStats(settlements_);
-  if (!macroActive_) {
-    factions_.UpdateLeaders(settlements_, humans_);
-  }
-  factions_.UpdateDiplomacy(settlements_, rng_, stats_.dayCount);
-  std::vector<int> warsStarted;
-  for (const auto& war : factions_.Wars()) {
-    if (!war.active) continue;
-    if (std::find(warsBefore.begin(), warsBefore.end(), war.id) != warsBefore.end()) continue;
-    warsStarted.push_back(war.id);
-  }
-  if (!macroActive_ && !warsStarted.empty()) {
-    settlements_.MobilizeForWarStart(humans_, rng_, factions_, warsStarted);
-  }
-  settlements_.UpdateArmyOrders(world_, humans_, rng_, stats_.dayCount, dayDelta, factions_);
   if (ui_.warLoggingEnabled) {
+    FUNSIM_PROFILE_ZONE("StepDay:WarLog");
     AppendWarLog(dayDelta);
     AppendWarEvents(dayDelta);
   }
   RefreshTotals();
-  CrashContextSetStage("StepDay:Done");
 }
 
 namespace {
@@ -580,38 +603,26 @@ void App::AdvanceMacro(int days) {
   if (days <= 0) return;
   stats_.birthsToday = 0;
   stats_.deathsToday = 0;
-  int warDeathsTotal = 0;
-  for (int i = 0; i < days; ++i) {
-    stats_.dayCount++;
-    CrashContextSetDay(stats_.dayCount);
-    if ((stats_.dayCount % 7) == 0) {
-      world_.UpdateDaily(rng_, 1);
+  for (int done = 0; done < days;) {
+    const int step = std::min(macroBatchDays_, days - done);
+    done += step;
+    const SimStepCounts counts = SimStepMacroDays(Systems(), stats_.dayCount, step);
+    stats_.birthsToday += counts.births;
+    stats_.deathsToday += counts.deaths;
+    if (replayRecorder_.Active()) {
+      replayRecorder_.RecordMacroDays(step);
+      RecordReplayDay();
     }
-    humans_.AdvanceMacro(world_, settlements_, rng_, 1, stats_.birthsToday, stats_.deathsToday);
-    settlements_.UpdateMacro(world_, rng_, stats_.dayCount, villageMarkers_, factions_);
-    warDeathsTotal += settlements_.ConsumeWarDeaths();
-    factions_.UpdateStats(settlements_);
-    factions_.UpdateDiplomacy(settlements_, rng_, stats_.dayCount);
-  }
-  stats_.deathsToday += warDeathsTotal;
-  humans_.RecordWarDeaths(warDeathsTotal);
+  }
   stats_.totalBirths += stats_.birthsToday;
   stats_.totalDeaths += stats_.deathsToday;
-  for (auto& marker : villageMarkers_) {
-    if (marker.ttlDays > 0) {
-      marker.ttlDays = std::max(0, marker.ttlDays - days);
-    }
-  }
-  villageMarkers_.erase(
-      std::remove_if(villageMarkers_.begin(), villageMarkers_.end(),
-                     [](const VillageMarker& marker) { return marker.ttlDays <= 0; }),
-      villageMarkers_.end());
   RefreshTotals();
 }
 
 void App::EnterMacroMode() {
   if (macroActive_) return;
   macroActive_ = true;
+  replayRecorder_.RecordEnterMacro();
   humans_.EnterMacro(settlements_);
   RefreshTotals();
 }
@@ -619,99 +630,17 @@ void App::EnterMacroMode() {
 void App::ExitMacroMode() {
   if (!macroActive_) return;
   macroActive_ = false;
-  humans_.ExitMacro(settlements_, rng_);
+  replayRecorder_.RecordExitMacro();
+  // Update() rebuilds the first slice this same frame; stepping here too would double it.
+  humans_.BeginExitMacro(settlements_, rng_);
   RefreshTotals();
 }
 
 void App::ApplyToolAt(int tileX, int tileY, bool erase) {
   CrashContextSetNote("ApplyToolAt");
-  int radius = ui_.brushSize / 2;
-  bool spawned = false;
-
-  for (int dy = -radius; dy <= radius; ++dy) {
-    for (int dx = -radius; dx <= radius; ++dx) {
-      int x = tileX + dx;
-      int y = tileY + dy;
-      if (!world_.InBounds(x, y)) continue;
-
-      if (erase) {
-        world_.EraseAt(x, y);
-      } else {
-        switch (ui_.tool) {
-          case ToolType::PlaceLand:
-            world_.SetTileType(x, y, TileType::Land);
-            break;
-          case ToolType::PlaceFreshWater:
-            world_.EditTile(x, y, [&](Tile& tile) {
-              tile.type = TileType::FreshWater;
-              tile.trees = 0;
-              tile.food = 0;
-              tile.burning = false;
-              tile.burnDaysRemaining = 0;
-              tile.building = BuildingType::None;
-              tile.farmStage = 0;
-              tile.buildingOwnerId = -1;
-            });
-            world_.MarkBuildingDirty();
-            break;
-          case ToolType::AddTrees:
-            world_.EditTile(x, y, [&](Tile& tile) {
-              if (tile.type != TileType::Land) return;
-              int trees = static_cast<int>(tile.trees);
-              trees = std::min(20, trees + 5);
-              tile.trees = static_cast<uint8_t>(trees);
-            });
-            break;
-          case ToolType::AddFood:
-            world_.EditTile(x, y, [&](Tile& tile) {
-              if (tile.type != TileType::Land) return;
-              int food = static_cast<int>(tile.food);
-              food = std::min(50, food + 10);
-              tile.food = static_cast<uint8_t>(food);
-            });
-            break;
-          case ToolType::SpawnMale:
-            if (world_.At(x, y).type != TileType::Ocean) {
-              humans_.Spawn(x, y, false, rng_);
-              CrashContextSetNote("ApplyToolAt: SpawnMale");
-              spawned = true;
-            }
-            break;
-          case ToolType::SpawnFemale:
-            if (world_.At(x, y).type != TileType::Ocean) {
-              humans_.Spawn(x, y, true, rng_);
-              CrashContextSetNote("ApplyToolAt: SpawnFemale");
-              spawned = true;
-            }
-            break;
-          case ToolType::Fire:
-            if (world_.At(x, y).type == TileType::Land && world_.At(x, y).trees > 0) {
-              world_.SetBurning(x, y, true, 4);
-            }
-            break;
-          case ToolType::Meteor:
-            world_.EditTile(x, y, [&](Tile& tile) {
-              tile.type = TileType::Ocean;
-              tile.trees = 0;
-              tile.food = 0;
-              tile.burning = false;
-              tile.burnDaysRemaining = 0;
-              tile.building = BuildingType::None;
-              tile.farmStage = 0;
-              tile.buildingOwnerId = -1;
-            });
-            world_.MarkBuildingDirty();
-            break;
-          case ToolType::GiftFood:
-            world_.EditTile(x, y, [&](Tile& tile) {
-              if (tile.type != TileType::Land) return;
-              tile.food = 50;
-            });
-            break;
-        }
-      }
-    }
-  }
+  replayRecorder_.RecordTool(ui_.tool, tileX, tileY, ui_.brushSize, erase);
+  const bool spawned =
+      ApplyTool(world_, humans_, rng_, ui_.tool, tileX, tileY, ui_.brushSize, erase);
 
   stats_.totalFood = world_.TotalFood();
   stats_.totalTrees = world_.TotalTrees();
@@ -721,8 +650,28 @@ void App::ApplyToolAt(int tileX, int tileY, bool erase) {
   CrashContextSetNote("");
 }
 
+void App::StartReplayRecording() {
+  const uint32_t seed = std::random_device{}();
+  if (!replayRecorder_.Begin(ui_.replayPath, seed, world_, ticksPerDay_,
+                             static_cast<float>(tickSeconds_))) {
+    SDL_Log("Replay: could not start recording to %s", ui_.replayPath);
+    return;
+  }
+  ResetSimulationState();
+  rng_ = Random(seed);
+  RefreshTotals();
+  SDL_Log("Replay: recording to %s (seed %u)", ui_.replayPath, seed);
+}
+
+void App::RecordReplayDay() {
+  if (!replayRecorder_.Active()) return;
+  replayRecorder_.RecordDayHash(
+      ComputeStateHash(stats_.dayCount, world_, humans_, settlements_, factions_));
+}
+
 void App::ResetSimulationState() {
   humans_ = HumanManager();
+  humans_.SetDeathLogSink(&deathLogWriter_);
   settlements_ = SettlementManager();
   factions_ = FactionManager();
   villageMarkers_.clear();
@@ -877,7 +826,9 @@ void App::ClampCamera() {
 void App::RefreshTotals() {
   stats_.totalFood = world_.TotalFood();
   stats_.totalTrees = world_.TotalTrees();
-  stats_.totalPop = macroActive_ ? humans_.MacroPopulation(settlements_) : humans_.CountAlive();
+  stats_.totalPop = (macroActive_ || humans_.MacroExitPending())
+                        ? humans_.MacroPopulation(settlements_)
+                        : humans_.CountAlive();
   stats_.totalSettlements = settlements_.Count();
   stats_.totalStockFood = 0;
   stats_.totalStockWood = 0;
@@ -918,28 +869,29 @@ void App::RefreshTotals() {
     }
   }
   factions_.UpdateStats(settlements_);
-  factions_.UpdateLeaders(settlements_, humans_);
   stats_.totalWars = factions_.WarCount();
 
-  for (const auto& human : humans_.Humans()) {
-    if (!human.alive) continue;
-    if (!human.legendary) continue;
-    stats_.totalLegendary++;
-    if (stats_.legendaryShown >= SimStats::kLegendaryDisplayCount) continue;
+  // Leaders are refreshed by the daily step; legendary humans are tracked as they come and go.
+  const std::vector<int>& legendaryIds = humans_.LegendaryIds();
+  stats_.totalLegendary = static_cast<int64_t>(legendaryIds.size());
+  for (int id : legendaryIds) {
+    if (stats_.legendaryShown >= SimStats::kLegendaryDisplayCount) break;
+    const Human* human = humans_.FindById(id);
+    if (!human) continue;
     auto& info = stats_.legendary[stats_.legendaryShown++];
-    info.id = human.id;
-    info.ageDays = human.ageDays;
-    info.settlementId = human.settlementId;
+    info.id = human->id;
+    info.ageDays = human->ageDays;
+    info.settlementId = human->settlementId;
     info.factionId = -1;
-    if (human.settlementId > 0) {
-      const Settlement* settlement = settlements_.Get(human.settlementId);
+    if (human->settlementId > 0) {
+      const Settlement* settlement = settlements_.Get(human->settlementId);
       if (settlement) {
         info.factionId = settlement->factionId;
       }
     }
-    info.traits = human.traits;
-    info.legendary = human.legendary;
-    HumanTraitsToString(info.traitsText, sizeof(info.traitsText), human.traits, human.legendary);
+    info.traits = human->traits;
+    info.legendary = human->legendary;
+    HumanTraitsToString(info.traitsText, sizeof(info.traitsText), human->traits, human->legendary);
   }
   CrashContextSetPopulation(
       static_cast<int>(std::min<int64_t>(stats_.totalPop, std::numeric_limits<int>::max())));
@@ -967,10 +919,9 @@ void App::WriteDeathLog() const {
   out << "macro_fire=" << deathStats.macroFire << "\n";
 
   out << "\n# micro_deaths\n";
-  out << "day,id,reason\n";
-  for (const auto& record : humans_.DeathLog()) {
-    out << record.day << "," << record.humanId << "," << DeathReasonName(record.reason) << "\n";
-  }
+  out << "streamed_to=" << deathLogWriter_.Path() << "\n";
+  out << "records_written=" << deathLogWriter_.Written() << "\n";
+  out << "records_dropped=" << deathLogWriter_.Dropped() << "\n";
 
   out << "\n# macro_deaths_summary\n";
   out << "macro counts are aggregated; no per-human ids in macro mode\n";
@@ -6,10 +6,14 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "death_log.h"
 #include "factions.h"
 #include "humans.h"
+#include "profiler.h"
 #include "render.h"
+#include "replay.h"
 #include "settlements.h"
+#include "sim_harness.h"
 #include "tools.h"
 #include "ui.h"
 #include "util.h"
@@ -27,6 +31,7 @@ class App {
   void HandleEvents();
   void Update(float dt);
   void RenderFrame();
+  SimSystems Systems();
   void StepTick(float tickSeconds);
   void StepDayCoarse(int dayDelta);
   void AdvanceMacro(int days);
@@ -46,6 +51,8 @@ class App {
   void WriteDeathLog() const;
   void AppendWarLog(int dayDelta);
   void AppendWarEvents(int dayDelta);
+  void StartReplayRecording();
+  void RecordReplayDay();
 
   SDL_Window* window_ = nullptr;
   SDL_Renderer* renderer_ = nullptr;
@@ -62,6 +69,8 @@ class App {
   UIState ui_;
   SimStats stats_;
   Random rng_;
+  DeathLogWriter deathLogWriter_;
+  ReplayRecorder replayRecorder_;
   std::vector<VillageMarker> villageMarkers_;
 
   double accumulator_ = 0.0;
@@ -71,6 +80,9 @@ class App {
   int tickCount_ = 0;
   int maxTickStepsPerFrame_ = 200;
   int maxMacroDaysPerFrame_ = 2000;
+  // Macro fast-forward advances whole batches of this many days, a coarse day's worth.
+  int macroBatchDays_ = 30;
+  int maxRehydratePerFrame_ = 200000;
   bool macroActive_ = false;
 
   int hoverTileX_ = 0;
@@ -0,0 +1,517 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "sim_harness.h"
+#include "util.h"
+
+// Reaches into the managers for kernels that are not public entry points.
+struct BenchAccess {
+  static size_t BuildFlowField(const World& world, int x, int y, int radius) {
+    return HumanManager::BuildFlowField(world, x, y, radius).dirX.size();
+  }
+  static bool GetFlowField(HumanManager& humans, const World& world, int x, int y, int radius,
+                           int tick) {
+    int budget = 1;
+    return humans.GetFlowField(world, x, y, radius, tick, budget) != nullptr;
+  }
+  static void SetArrows(HumanManager& humans, const std::vector<ArrowProjectile>& arrows) {
+    humans.arrows_ = arrows;
+  }
+  static void UpdateArrows(HumanManager& humans, SettlementManager& settlements, float dt) {
+    humans.UpdateArrows(settlements, dt);
+  }
+  static void AdvanceMacroCohorts(HumanManager& humans, MacroCohorts& pools,
+                                  const std::vector<float>& birthScale,
+                                  const std::vector<float>& edgeDeathRate,
+                                  const std::vector<float>& allDeathRate, std::vector<int>& births,
+                                  int days, uint64_t key) {
+    HumanManager::RollMacroBirths(pools, birthScale.data(), days, key, births.data());
+    humans.AdvanceMacroCohorts(pools, edgeDeathRate.data(), allDeathRate.data(), births.data(),
+                               days, key + 1);
+  }
+  static void UpdateZoneOwners(SettlementManager& settlements, const World& world) {
+    settlements.UpdateZoneOwners(world);
+  }
+  static void RebuildZoneOwners(SettlementManager& settlements, const World& world) {
+    settlements.ResetZoneClaims();
+    settlements.UpdateZoneOwners(world);
+  }
+  static void UpdateWaterTargets(SettlementManager& settlements, World& world) {
+    settlements.ComputeSettlementWaterTargets(world);
+  }
+  static void RebuildWaterTargets(SettlementManager& settlements, World& world) {
+    settlements.waterRowsWidth_ = 0;
+    settlements.ComputeSettlementWaterTargets(world);
+  }
+};
+
+namespace {
+constexpr uint32_t kBenchSeed = 12345;
+constexpr int kBigWorldSide = 1024;
+constexpr int kScentLookups = 1 << 20;
+constexpr int kFlowTargets = 64;
+constexpr int kArrowCount = 10000;
+constexpr int kNearestLookups = 1 << 16;
+constexpr int kMacroPools = 100000;
+constexpr int kWarmWorldW = 512;
+constexpr int kWarmWorldH = 288;
+constexpr int kWarmPopulation = 3000;
+constexpr int kWarmDays = 20;
+
+constexpr const char* kBenchNames[] = {
+    "world/FoodScentAt",
+    "world/WaterScentAt",
+    "world/FindNearestWithResource/r24",
+    "world/FindNearestWithResource/r96",
+    "world/SaveMap",
+    "world/LoadMap",
+    "flow/BuildFlowField/r56",
+    "flow/BuildFlowField/r80",
+    "flow/GetFlowField/hit",
+    "humans/UpdateTick/10k",
+    "humans/UpdateTick/100k",
+    "humans/UpdateTick/1M",
+    "humans/UpdateArrows",
+    "humans/MacroCohorts/100k/day",
+    "humans/MacroCohorts/100k/year",
+    "settlements/TaskStore/PushClaim",
+    "settlements/UpdateDaily",
+    "settlements/UpdateArmyOrders",
+    "settlements/UpdateZoneOwners/clean",
+    "settlements/UpdateZoneOwners/rebuild",
+    "settlements/WaterTargets/clean",
+    "settlements/WaterTargets/rebuild",
+    "settlements/NearestSettlement",
+    "factions/UpdateDiplomacy/100",
+    "factions/UpdateDiplomacy/1000",
+    "sim/StepDayCoarse/1M",
+};
+
+struct BenchOptions {
+  std::string filter;
+  double minSeconds = 0.5;
+  int minRuns = 3;
+  bool list = false;
+};
+
+BenchOptions gOptions;
+
+bool Wants(const char* name) {
+  return gOptions.filter.empty() || std::strstr(name, gOptions.filter.c_str()) != nullptr;
+}
+
+bool WantsAny(std::initializer_list<const char*> names) {
+  for (const char* name : names) {
+    if (Wants(name)) return true;
+  }
+  return false;
+}
+
+std::string FormatSeconds(double seconds) {
+  char buffer[32];
+  if (seconds >= 1.0) {
+    std::snprintf(buffer, sizeof(buffer), "%.3f s", seconds);
+  } else if (seconds >= 1e-3) {
+    std::snprintf(buffer, sizeof(buffer), "%.3f ms", seconds * 1e3);
+  } else if (seconds >= 1e-6) {
+    std::snprintf(buffer, sizeof(buffer), "%.3f us", seconds * 1e6);
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%.1f ns", seconds * 1e9);
+  }
+  return buffer;
+}
+
+// Times `run` until both minRuns and minSeconds are reached; `reset` runs untimed before each
+// timed call. Reports the median and fastest run plus throughput in `items` per second.
+void RunBench(const char* name, int64_t items, const std::function<void()>& run,
+              const std::function<void()>& reset = nullptr) {
+  if (!Wants(name)) return;
+  using Clock = std::chrono::steady_clock;
+  // Each run stands in for one sim step, so it starts from an empty frame arena.
+  SimFrameArena().Reset();
+  if (reset) reset();
+  run();
+
+  std::vector<double> samples;
+  double total = 0.0;
+  while (static_cast<int>(samples.size()) < gOptions.minRuns || total < gOptions.minSeconds) {
+    SimFrameArena().Reset();
+    if (reset) reset();
+    const auto start = Clock::now();
+    run();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    samples.push_back(elapsed);
+    total += elapsed;
+  }
+  std::sort(samples.begin(), samples.end());
+  const double median = samples[samples.size() / 2];
+  const double rate = (median > 0.0) ? static_cast<double>(items) / median : 0.0;
+  std::printf("%-40s median %12s  min %12s  %14.0f items/s  runs %zu\n", name,
+              FormatSeconds(median).c_str(), FormatSeconds(samples.front()).c_str(), rate,
+              samples.size());
+  std::fflush(stdout);
+}
+
+World MakeWorld(int w, int h) {
+  World world(w, h);
+  GenerateIslandTerrain(world, kBenchSeed);
+  world.RecomputeScentFields();
+  return world;
+}
+
+std::vector<int> LandCoords(const World& world, int count, Random& rng) {
+  std::vector<int> coords;
+  coords.reserve(static_cast<size_t>(count) * 2);
+  while (static_cast<int>(coords.size()) < count * 2) {
+    const int x = rng.RangeInt(0, world.width() - 1);
+    const int y = rng.RangeInt(0, world.height() - 1);
+    if (world.At(x, y).type != TileType::Land) continue;
+    coords.push_back(x);
+    coords.push_back(y);
+  }
+  return coords;
+}
+
+void BenchWorld() {
+  if (!WantsAny({"world/FoodScentAt", "world/WaterScentAt", "world/FindNearestWithResource/r24",
+                 "world/FindNearestWithResource/r96", "world/SaveMap", "world/LoadMap"})) {
+    return;
+  }
+  World world = MakeWorld(kBigWorldSide, kBigWorldSide);
+  Random rng(kBenchSeed);
+  std::vector<int> coords;
+  for (int i = 0; i < kScentLookups; ++i) {
+    coords.push_back(rng.RangeInt(0, world.width() - 1));
+    coords.push_back(rng.RangeInt(0, world.height() - 1));
+  }
+
+  volatile uint64_t sink = 0;
+  RunBench("world/FoodScentAt", kScentLookups, [&] {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < coords.size(); i += 2) {
+      sum += world.FoodScentAt(coords[i], coords[i + 1]);
+    }
+    sink = sink + sum;
+  });
+  RunBench("world/WaterScentAt", kScentLookups, [&] {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < coords.size(); i += 2) {
+      sum += world.WaterScentAt(coords[i], coords[i + 1]);
+    }
+    sink = sink + sum;
+  });
+  const std::vector<int> landCoords = LandCoords(world, kNearestLookups, rng);
+  for (const auto& [name, radius] : {std::pair{"world/FindNearestWithResource/r24", 24},
+                                     std::pair{"world/FindNearestWithResource/r96", 96}}) {
+    RunBench(name, kNearestLookups, [&] {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < landCoords.size(); i += 2) {
+        int x = 0;
+        int y = 0;
+        if (world.FindNearestWithResource(landCoords[i], landCoords[i + 1], ResourceKind::Food,
+                                          radius, x, y)) {
+          sum += static_cast<uint64_t>(x + y);
+        }
+      }
+      sink = sink + sum;
+    });
+  }
+
+  std::error_code ec;
+  const std::filesystem::path mapPath =
+      std::filesystem::temp_directory_path(ec) / "funsim_bench_map.bin";
+  const int64_t tiles = static_cast<int64_t>(world.width()) * world.height();
+  RunBench("world/SaveMap", tiles, [&] { world.SaveMap(mapPath.string()); });
+  if (Wants("world/LoadMap")) {
+    world.SaveMap(mapPath.string());
+    World loaded(0, 0);
+    RunBench("world/LoadMap", tiles, [&] { loaded.LoadMap(mapPath.string()); });
+  }
+  std::filesystem::remove(mapPath, ec);
+}
+
+void BenchFlowFields() {
+  if (!WantsAny({"flow/"})) return;
+  World world = MakeWorld(kBigWorldSide, kBigWorldSide);
+  Random rng(kBenchSeed);
+  std::vector<int> targets = LandCoords(world, kFlowTargets, rng);
+
+  volatile size_t sink = 0;
+  for (int radius : {56, 80}) {
+    const std::string name = "flow/BuildFlowField/r" + std::to_string(radius);
+    size_t next = 0;
+    RunBench(name.c_str(), 1, [&] {
+      sink = sink + BenchAccess::BuildFlowField(world, targets[next], targets[next + 1], radius);
+      next = (next + 2) % targets.size();
+    });
+  }
+
+  if (Wants("flow/GetFlowField/hit")) {
+    HumanManager humans;
+    for (size_t i = 0; i < targets.size(); i += 2) {
+      BenchAccess::GetFlowField(humans, world, targets[i], targets[i + 1], 56, 0);
+    }
+    int tick = 1;
+    RunBench("flow/GetFlowField/hit", kFlowTargets, [&] {
+      int hits = 0;
+      for (size_t i = 0; i < targets.size(); i += 2) {
+        if (BenchAccess::GetFlowField(humans, world, targets[i], targets[i + 1], 56, tick)) hits++;
+      }
+      sink = sink + static_cast<size_t>(hits);
+      tick++;
+    });
+  }
+}
+
+void BenchUpdateTick() {
+  const struct {
+    const char* name;
+    int population;
+  } cases[] = {
+      {"humans/UpdateTick/10k", 10000},
+      {"humans/UpdateTick/100k", 100000},
+      {"humans/UpdateTick/1M", 1000000},
+  };
+  bool any = false;
+  for (const auto& c : cases) any = any || Wants(c.name);
+  if (!any && !Wants("humans/UpdateArrows")) return;
+
+  World world = MakeWorld(kBigWorldSide, kBigWorldSide);
+  for (const auto& c : cases) {
+    if (!Wants(c.name)) continue;
+    SimHarness sim;
+    sim.world = world;
+    sim.rng = Random(kBenchSeed);
+    SpawnClusteredPopulation(sim.world, sim.humans, sim.rng, c.population);
+    RunBench(c.name, sim.humans.CountAlive(), [&] { sim.StepTick(); });
+  }
+
+  if (Wants("humans/UpdateArrows")) {
+    SimHarness sim;
+    sim.world = world;
+    sim.rng = Random(kBenchSeed);
+    SpawnClusteredPopulation(sim.world, sim.humans, sim.rng, kArrowCount);
+    std::vector<ArrowProjectile> arrows;
+    arrows.reserve(kArrowCount);
+    const auto& humans = sim.humans.Humans();
+    for (int i = 0; i < kArrowCount; ++i) {
+      const Human& target = humans[static_cast<size_t>(i) % humans.size()];
+      ArrowProjectile arrow;
+      arrow.x = static_cast<float>(target.x) + 6.0f;
+      arrow.y = static_cast<float>(target.y) + 6.0f;
+      arrow.vx = -4.0f;
+      arrow.vy = -4.0f;
+      arrow.ttlSeconds = 5.0f;
+      arrow.targetId = target.id;
+      arrows.push_back(arrow);
+    }
+    RunBench("humans/UpdateArrows", kArrowCount,
+             [&] { BenchAccess::UpdateArrows(sim.humans, sim.settlements, sim.tickSeconds); },
+             [&] { BenchAccess::SetArrows(sim.humans, arrows); });
+  }
+}
+
+// Cohort kernels alone over kMacroPools synthetic settlements; one in eight is starving or
+// burning so the extra-death lanes are exercised.
+void BenchMacroCohorts() {
+  if (!WantsAny({"humans/MacroCohorts/100k/day", "humans/MacroCohorts/100k/year"})) return;
+  Random rng(kBenchSeed);
+  MacroCohorts start;
+  start.Resize(kMacroPools);
+  std::vector<float> birthScale(kMacroPools);
+  std::vector<float> edgeDeathRate(kMacroPools, 0.0f);
+  std::vector<float> allDeathRate(kMacroPools, 0.0f);
+  std::vector<int> births(kMacroPools, 0);
+  for (size_t i = 0; i < static_cast<size_t>(kMacroPools); ++i) {
+    for (int bin = 0; bin < MacroCohorts::kBins; ++bin) {
+      start.male[bin][i] = rng.RangeInt(0, 60);
+      start.female[bin][i] = rng.RangeInt(0, 60);
+    }
+    birthScale[i] = rng.RangeFloat(0.0f, 1.0f);
+    if (rng.Chance(0.125f)) edgeDeathRate[i] = 0.002f;
+    if (rng.Chance(0.125f)) allDeathRate[i] = 0.0005f;
+  }
+
+  HumanManager humans;
+  MacroCohorts pools;
+  uint64_t key = 0;
+  for (const auto& [name, days] : {std::pair{"humans/MacroCohorts/100k/day", 1},
+                                   std::pair{"humans/MacroCohorts/100k/year", 365}}) {
+    RunBench(
+        name, kMacroPools,
+        [&] {
+          BenchAccess::AdvanceMacroCohorts(humans, pools, birthScale, edgeDeathRate,
+                                           allDeathRate, births, days, key += 2);
+        },
+        [&] { pools = start; });
+  }
+}
+
+// A full task store around one settlement, drained by workers standing at random spots near the
+// town; every other claim is food-only, as during an emergency.
+void BenchTaskStore() {
+  if (!Wants("settlements/TaskStore/PushClaim")) return;
+  constexpr int kCenter = 512;
+  constexpr int kTaskSpread = 32;
+  constexpr int kWorkerSpread = 40;
+  Random rng(kBenchSeed);
+  std::vector<Task> tasks;
+  while (static_cast<int>(tasks.size()) < TaskStore::kMaxTasks) {
+    Task task;
+    task.type = static_cast<TaskType>(rng.RangeInt(0, static_cast<int>(TaskType::PatrolEdge)));
+    task.x = kCenter + rng.RangeInt(-kTaskSpread, kTaskSpread);
+    task.y = kCenter + rng.RangeInt(-kTaskSpread, kTaskSpread);
+    if (task.type == TaskType::BuildStructure) task.buildType = BuildingType::House;
+    tasks.push_back(task);
+  }
+  std::vector<int> workers;
+  for (int i = 0; i < TaskStore::kMaxTasks * 2; ++i) {
+    workers.push_back(kCenter + rng.RangeInt(-kWorkerSpread, kWorkerSpread));
+  }
+  const uint32_t foodTypes = TaskStore::TypeBit(TaskType::CollectFood) |
+                             TaskStore::TypeBit(TaskType::HarvestFarm) |
+                             TaskStore::TypeBit(TaskType::PlantFarm);
+
+  TaskStore store;
+  store.SetOrigin(kCenter, kCenter);
+  volatile int64_t sink = 0;
+  RunBench("settlements/TaskStore/PushClaim", TaskStore::kMaxTasks, [&] {
+    store.Clear();
+    for (const Task& task : tasks) store.Push(task);
+    int64_t sum = 0;
+    Task claimed;
+    for (size_t i = 0; i < workers.size(); i += 2) {
+      const uint32_t mask = (i & 2) ? foodTypes : TaskStore::kAnyType;
+      if (store.ClaimNearest(workers[i], workers[i + 1], mask, claimed)) sum += claimed.x;
+    }
+    sink = sink + sum;
+  });
+}
+
+void BenchSettlementsAndFactions() {
+  if (!WantsAny({"settlements/", "factions/"})) return;
+  SimHarness sim;
+  sim.world = MakeWorld(kWarmWorldW, kWarmWorldH);
+  sim.rng = Random(kBenchSeed);
+  SpawnClusteredPopulation(sim.world, sim.humans, sim.rng, kWarmPopulation);
+  for (int day = 0; day < kWarmDays; ++day) sim.StepDayMicro();
+  std::printf("# warm sim: pop %lld settlements %d factions %d\n",
+              static_cast<long long>(sim.Population()), sim.settlements.Count(),
+              sim.factions.Count());
+
+  RunBench("settlements/UpdateDaily", sim.settlements.Count(), [&] {
+    sim.dayCount++;
+    sim.settlements.UpdateDaily(sim.world, sim.humans, sim.rng, sim.dayCount, 1, sim.markers,
+                                sim.factions);
+  });
+  RunBench("settlements/UpdateArmyOrders", sim.settlements.Count(), [&] {
+    sim.settlements.UpdateArmyOrders(sim.world, sim.humans, sim.rng, sim.dayCount, 1,
+                                     sim.factions);
+  });
+  RunBench("settlements/UpdateZoneOwners/clean", sim.settlements.Count(),
+           [&] { BenchAccess::UpdateZoneOwners(sim.settlements, sim.world); });
+  RunBench("settlements/UpdateZoneOwners/rebuild", sim.settlements.Count(),
+           [&] { BenchAccess::RebuildZoneOwners(sim.settlements, sim.world); });
+  RunBench("settlements/WaterTargets/clean", sim.settlements.Count(),
+           [&] { BenchAccess::UpdateWaterTargets(sim.settlements, sim.world); });
+  RunBench("settlements/WaterTargets/rebuild", sim.settlements.Count(),
+           [&] { BenchAccess::RebuildWaterTargets(sim.settlements, sim.world); });
+  if (Wants("settlements/NearestSettlement")) {
+    std::vector<int> coords;
+    for (int i = 0; i < kNearestLookups; ++i) {
+      coords.push_back(sim.rng.RangeInt(0, sim.world.width() - 1));
+      coords.push_back(sim.rng.RangeInt(0, sim.world.height() - 1));
+    }
+    volatile int64_t sink = 0;
+    RunBench("settlements/NearestSettlement", kNearestLookups, [&] {
+      int64_t sum = 0;
+      for (size_t i = 0; i < coords.size(); i += 2) {
+        int dist = 0;
+        sum += sim.settlements.Index().Nearest(coords[i], coords[i + 1],
+                                               DistanceMetric::Manhattan, dist);
+      }
+      sink = sink + sum;
+    });
+  }
+
+  for (int count : {100, 1000}) {
+    const std::string name = "factions/UpdateDiplomacy/" + std::to_string(count);
+    if (!Wants(name.c_str())) continue;
+    FactionManager factions;
+    Random rng(kBenchSeed);
+    for (int i = 0; i < count; ++i) factions.CreateFaction(rng);
+    int day = sim.dayCount;
+    RunBench(name.c_str(), count, [&] { factions.UpdateDiplomacy(sim.settlements, rng, ++day); });
+  }
+}
+
+// The whole coarse day at scale, where the human sweeps dominate.
+void BenchStepDayCoarse() {
+  if (!Wants("sim/StepDayCoarse/1M")) return;
+  SimHarness sim;
+  sim.world = MakeWorld(kBigWorldSide, kBigWorldSide);
+  sim.rng = Random(kBenchSeed);
+  SpawnClusteredPopulation(sim.world, sim.humans, sim.rng, 1000000);
+  RunBench("sim/StepDayCoarse/1M", sim.humans.CountAlive(),
+           [&] { sim.StepDayCoarse(SimHarness::kCalendarDaysPerCoarseDay); });
+}
+
+void PrintUsage(const char* exe) {
+  std::printf(
+      "usage: %s [--filter SUBSTR] [--min-time SECONDS] [--min-runs N] [--list]\n", exe);
+}
+
+bool ParseArgs(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (std::strcmp(arg, "--list") == 0) {
+      gOptions.list = true;
+    } else if (std::strcmp(arg, "--filter") == 0 && value) {
+      gOptions.filter = value;
+      ++i;
+    } else if (std::strcmp(arg, "--min-time") == 0 && value) {
+      gOptions.minSeconds = std::max(0.0, std::atof(value));
+      ++i;
+    } else if (std::strcmp(arg, "--min-runs") == 0 && value) {
+      gOptions.minRuns = std::max(1, std::atoi(value));
+      ++i;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!ParseArgs(argc, argv)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  if (gOptions.list) {
+    for (const char* name : kBenchNames) {
+      if (Wants(name)) std::printf("%s\n", name);
+    }
+    return 0;
+  }
+  InstallCrashHandlers();
+
+  BenchWorld();
+  BenchFlowFields();
+  BenchUpdateTick();
+  BenchMacroCohorts();
+  BenchTaskStore();
+  BenchSettlementsAndFactions();
+  BenchStepDayCoarse();
+  return 0;
+}
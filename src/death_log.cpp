@@ -0,0 +1,149 @@
+#include "death_log.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace {
+constexpr size_t kLineMaxBytes = 48;
+constexpr size_t kBufferFlushBytes = 256u * 1024u;
+constexpr const char* kHeader = "day,id,reason\n";
+
+char* AppendInt(char* out, char* end, int value) {
+  auto result = std::to_chars(out, end, value);
+  return result.ptr;
+}
+
+char* AppendStr(char* out, const char* text) {
+  size_t len = std::strlen(text);
+  std::memcpy(out, text, len);
+  return out + len;
+}
+
+std::string RotatedPath(const std::string& path, int index) {
+  return path + "." + std::to_string(index);
+}
+}  // namespace
+
+DeathLogWriter::DeathLogWriter() : ring_(kRingCapacity) {}
+
+DeathLogWriter::~DeathLogWriter() {
+  Close();
+}
+
+bool DeathLogWriter::Open(const std::string& path, size_t maxFileBytes, int maxFiles) {
+  Close();
+  path_ = path;
+  maxFileBytes_ = std::max<size_t>(maxFileBytes, 4096u);
+  maxFiles_ = std::max(1, maxFiles);
+  if (!OpenFile()) return false;
+
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+  written_.store(0, std::memory_order_relaxed);
+  dropped_.store(0, std::memory_order_relaxed);
+  buffer_.clear();
+  buffer_.reserve(kBufferFlushBytes + kLineMaxBytes);
+  stopRequested_ = false;
+  running_.store(true, std::memory_order_release);
+  thread_ = std::thread(&DeathLogWriter::Run, this);
+  return true;
+}
+
+void DeathLogWriter::Close() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      stopRequested_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+  running_.store(false, std::memory_order_release);
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool DeathLogWriter::OpenFile() {
+  std::filesystem::path outPath(path_);
+  if (outPath.has_parent_path()) {
+    std::error_code ec;
+    std::filesystem::create_directories(outPath.parent_path(), ec);
+  }
+  file_ = std::fopen(path_.c_str(), "wb");
+  if (!file_) return false;
+  fileBytes_ = std::fwrite(kHeader, 1, std::strlen(kHeader), file_);
+  return true;
+}
+
+void DeathLogWriter::RotateFiles() {
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  std::error_code ec;
+  if (maxFiles_ > 1) {
+    std::filesystem::remove(RotatedPath(path_, maxFiles_ - 1), ec);
+    for (int i = maxFiles_ - 2; i >= 1; --i) {
+      std::filesystem::rename(RotatedPath(path_, i), RotatedPath(path_, i + 1), ec);
+    }
+    std::filesystem::rename(path_, RotatedPath(path_, 1), ec);
+  }
+  OpenFile();
+}
+
+size_t DeathLogWriter::Drain() {
+  const size_t head = head_.load(std::memory_order_acquire);
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  size_t drained = 0;
+  while (tail != head) {
+    const DeathRecord& record = ring_[tail & (kRingCapacity - 1)];
+    size_t used = buffer_.size();
+    buffer_.resize(used + kLineMaxBytes);
+    char* out = buffer_.data() + used;
+    char* end = buffer_.data() + buffer_.size();
+    out = AppendInt(out, end, record.day);
+    *out++ = ',';
+    out = AppendInt(out, end, record.humanId);
+    *out++ = ',';
+    out = AppendStr(out, DeathReasonName(record.reason));
+    *out++ = '\n';
+    buffer_.resize(static_cast<size_t>(out - buffer_.data()));
+    tail++;
+    drained++;
+
+    if (buffer_.size() >= kBufferFlushBytes) {
+      tail_.store(tail, std::memory_order_release);
+      if (file_) fileBytes_ += std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+      buffer_.clear();
+      if (fileBytes_ >= maxFileBytes_) RotateFiles();
+    }
+  }
+  tail_.store(tail, std::memory_order_release);
+  if (!buffer_.empty()) {
+    if (file_) fileBytes_ += std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    buffer_.clear();
+    if (fileBytes_ >= maxFileBytes_) RotateFiles();
+  }
+  written_.fetch_add(drained, std::memory_order_relaxed);
+  return drained;
+}
+
+void DeathLogWriter::Run() {
+  std::unique_lock<std::mutex> lock(wakeMutex_);
+  while (!stopRequested_) {
+    wake_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+                   [this] { return stopRequested_; });
+    lock.unlock();
+    if (Drain() > 0 && file_) std::fflush(file_);
+    lock.lock();
+  }
+  lock.unlock();
+  Drain();
+  if (file_) std::fflush(file_);
+}
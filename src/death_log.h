@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "humans.h"
+
+// Streams DeathRecords to a rotating CSV (day,id,reason). The sim thread only writes into a
+// fixed single-producer ring; a background thread formats, writes and flushes. When the ring is
+// full new records are dropped and counted rather than blocking the sim.
+class DeathLogWriter {
+ public:
+  static constexpr size_t kRingCapacity = 1u << 18;
+  static constexpr size_t kDefaultMaxFileBytes = 64u * 1024u * 1024u;
+  static constexpr int kDefaultMaxFiles = 4;
+  static constexpr int kFlushIntervalMs = 500;
+
+  DeathLogWriter();
+  ~DeathLogWriter();
+  DeathLogWriter(const DeathLogWriter&) = delete;
+  DeathLogWriter& operator=(const DeathLogWriter&) = delete;
+
+  bool Open(const std::string& path, size_t maxFileBytes = kDefaultMaxFileBytes,
+            int maxFiles = kDefaultMaxFiles);
+  void Close();
+  bool IsOpen() const { return running_.load(std::memory_order_acquire); }
+
+  void Push(const DeathRecord& record) {
+    if (!running_.load(std::memory_order_relaxed)) return;
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kRingCapacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ring_[head & (kRingCapacity - 1)] = record;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  uint64_t Written() const { return written_.load(std::memory_order_relaxed); }
+  uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  const std::string& Path() const { return path_; }
+
+ private:
+  void Run();
+  size_t Drain();
+  bool OpenFile();
+  void RotateFiles();
+
+  std::vector<DeathRecord> ring_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<bool> running_{false};
+
+  std::string path_;
+  size_t maxFileBytes_ = kDefaultMaxFileBytes;
+  int maxFiles_ = kDefaultMaxFiles;
+  FILE* file_ = nullptr;
+  size_t fileBytes_ = 0;
+  std::vector<char> buffer_;
+
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+  bool stopRequested_ = false;
+  std::thread thread_;
+};
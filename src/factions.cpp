@@ -364,34 +364,20 @@ void FactionManager::UpdateStats(const SettlementManager& settlements) {
   UpdateTerritory(settlements);
 }
 
-void FactionManager::UpdateLeaders(const SettlementManager& settlements, const HumanManager& humans) {
+void FactionManager::UpdateLeaders(const HumanManager& humans) {
   if (factions_.empty()) return;
 
-  std::vector<int> bestAge(factions_.size(), -1);
-  std::vector<int> bestIndex(factions_.size(), -1);
-
-  for (int i = 0; i < static_cast<int>(humans.Humans().size()); ++i) {
-    const auto& human = humans.Humans()[i];
-    if (!human.alive) continue;
-    if (human.settlementId <= 0) continue;
-    const Settlement* settlement = settlements.Get(human.settlementId);
-    if (!settlement) continue;
-    int factionId = settlement->factionId;
-    int index = IndexForId(factionId);
-    if (index < 0) continue;
-    if (human.ageDays > bestAge[index]) {
-      bestAge[index] = human.ageDays;
-      bestIndex[index] = i;
+  // The eldest member of each faction is found by the coarse day's human sweep.
+  const std::vector<EldestMember>& eldest = humans.EldestByFaction();
+  for (Faction& faction : factions_) {
+    const Human* human = nullptr;
+    if (faction.id > 0 && faction.id < static_cast<int>(eldest.size())) {
+      human = humans.FindById(eldest[static_cast<size_t>(faction.id)].id);
     }
-  }
-
-  for (size_t i = 0; i < factions_.size(); ++i) {
-    Faction& faction = factions_[i];
-    if (bestIndex[i] >= 0) {
-      const auto& human = humans.Humans()[bestIndex[i]];
-      faction.leaderId = human.id;
-      faction.leaderName = MakeLeaderNameFromId(human.id);
-      faction.leaderInfluence = InfluenceFromHuman(human);
+    if (human) {
+      faction.leaderId = human->id;
+      faction.leaderName = MakeLeaderNameFromId(human->id);
+      faction.leaderInfluence = InfluenceFromHuman(*human);
     } else {
       if (faction.leaderName.empty() || faction.leaderName == "Unassigned") {
         faction.leaderId = -1;
@@ -416,7 +402,7 @@ void FactionManager::UpdateDiplomacy(const SettlementManager& settlements, Rando
     EnsureWarsForNewFaction();
   }
 
-  std::vector<int> borderPressure(count * count, 0);
+  std::pmr::vector<int> borderPressure(static_cast<size_t>(count) * count, 0, &SimFrameArena());
   int zonesX = settlements.ZonesX();
   int zonesY = settlements.ZonesY();
   if (zonesX > 0 && zonesY > 0) {
@@ -1114,3 +1100,75 @@ void FactionManager::SyncWarMatrixFromWars(int dayCount) {
   wars_.swap(next);
   (void)dayCount;
 }
+
+uint64_t FactionManager::StateHash() const {
+  StateHasher hasher;
+  hasher.Add(factions_.size());
+  for (const Faction& faction : factions_) {
+    hasher.Add(faction.id);
+    hasher.AddBytes(faction.name.data(), faction.name.size());
+    hasher.Add(faction.color.r);
+    hasher.Add(faction.color.g);
+    hasher.Add(faction.color.b);
+    hasher.Add(faction.leaderId);
+    hasher.AddBytes(faction.leaderName.data(), faction.leaderName.size());
+    hasher.AddBytes(faction.leaderTitle.data(), faction.leaderTitle.size());
+    hasher.AddBytes(faction.ideology.data(), faction.ideology.size());
+    hasher.Add(faction.traits.temperament);
+    hasher.Add(faction.traits.outlook);
+    hasher.Add(faction.traits.expansionBias);
+    hasher.Add(faction.traits.aggressionBias);
+    hasher.Add(faction.traits.diplomacyBias);
+    hasher.Add(faction.stats.population);
+    hasher.Add(faction.stats.settlements);
+    hasher.Add(faction.stats.territoryZones);
+    hasher.Add(faction.stats.stockFood);
+    hasher.Add(faction.stats.stockWood);
+    hasher.Add(faction.techTier);
+    hasher.Add(faction.techProgress);
+    hasher.Add(faction.warExhaustion);
+    hasher.Add(faction.stability);
+    hasher.Add(faction.leaderInfluence.expansion);
+    hasher.Add(faction.leaderInfluence.aggression);
+    hasher.Add(faction.leaderInfluence.diplomacy);
+    hasher.Add(faction.leaderInfluence.stability);
+    hasher.Add(faction.leaderInfluence.tech);
+    hasher.Add(faction.leaderInfluence.legendary);
+    hasher.Add(faction.allianceId);
+  }
+  for (int relation : relations_) hasher.Add(relation);
+  for (uint8_t war : wars_) hasher.Add(war);
+  for (int days : warDays_) hasher.Add(days);
+  hasher.Add(alliances_.size());
+  for (const Alliance& alliance : alliances_) {
+    hasher.Add(alliance.id);
+    hasher.AddBytes(alliance.name.data(), alliance.name.size());
+    hasher.Add(alliance.founderFactionId);
+    hasher.Add(alliance.members.size());
+    for (int member : alliance.members) hasher.Add(member);
+    hasher.Add(alliance.createdDay);
+    hasher.Add(alliance.level);
+  }
+  hasher.Add(warsList_.size());
+  for (const War& war : warsList_) {
+    hasher.Add(war.id);
+    hasher.Add(war.declaringFactionId);
+    hasher.Add(war.defendingFactionId);
+    for (const WarSide* side : {&war.attackers, &war.defenders}) {
+      hasher.Add(side->factions.size());
+      for (int factionId : side->factions) hasher.Add(factionId);
+      hasher.Add(side->allianceId);
+    }
+    hasher.Add(war.startDay);
+    hasher.Add(war.lastMajorEventDay);
+    hasher.Add(war.focusTargetSetDay);
+    hasher.Add(war.focusTargetSettlementId);
+    hasher.Add(war.deathsAttackers);
+    hasher.Add(war.deathsDefenders);
+    hasher.Add(war.active);
+  }
+  hasher.Add(nextAllianceId_);
+  hasher.Add(nextWarId_);
+  hasher.Add(warEnabled_);
+  return hasher.Digest();
+}
@@ -119,7 +119,8 @@ class FactionManager {
 
   int CreateFaction(Random& rng);
   void UpdateStats(const SettlementManager& settlements);
-  void UpdateLeaders(const SettlementManager& settlements, const HumanManager& humans);
+  // Leaders come from HumanManager::EldestByFaction, so call after UpdateDailyCoarse.
+  void UpdateLeaders(const HumanManager& humans);
   void UpdateDiplomacy(const SettlementManager& settlements, Random& rng, int dayCount);
 
   int RelationScore(int factionA, int factionB) const;
@@ -180,6 +181,7 @@ class FactionManager {
   }
   void SetWarEnabled(bool enabled);
   bool WarEnabled() const { return warEnabled_; }
+  uint64_t StateHash() const;
 
  private:
   int IndexForId(int id) const;
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "death_log.h"
+#include "profiler.h"
+#include "replay.h"
+#include "sim_harness.h"
+#include "util.h"
+
+namespace {
+constexpr int kMinWorldSide = 16;
+
+struct HeadlessOptions {
+  std::string mapPath;
+  std::string deathLogPath;
+  std::string tracePath;
+  std::string recordPath;
+  std::string replayPath;
+  uint32_t seed = 1;
+  int width = 256;
+  int height = 144;
+  int population = 200;
+  int days = 100;
+  int warmupDays = 0;
+  bool macro = false;
+  int macroBatch = 1;
+  int threads = 0;
+  int ticksPerDay = 50;
+  double daySeconds = 5.0;
+  int reportEvery = 0;
+};
+
+void PrintUsage(const char* exe) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --map PATH         load a saved map instead of generating one\n"
+      "  --seed N           RNG seed for terrain, spawns and simulation (default 1)\n"
+      "  --size WxH         generated world size in tiles (default 256x144)\n"
+      "  --pop N            initial population (default 200)\n"
+      "  --days N           days to simulate (default 100)\n"
+      "  --warmup N         untimed micro days to run first (default 0)\n"
+      "  --mode micro|macro per-human ticks or settlement cohorts (default micro)\n"
+      "  --macro-batch N    macro days advanced per batched step (default 1)\n"
+      "  --threads N        worker threads, 0 = auto (default 0)\n"
+      "  --ticks-per-day N  micro ticks per coarse day (default 50)\n"
+      "  --report N         print progress every N days (default off)\n"
+      "  --death-log PATH   stream deaths to a CSV\n"
+      "  --trace PATH       write a Chrome trace of the last timed days (one frame per day)\n"
+      "  --record PATH      record the run (map, inputs, per-day state hashes) to a replay\n"
+      "  --replay PATH      play a replay back and report the first divergent day/subsystem\n",
+      exe);
+}
+
+bool ParseInt(const char* text, int& out) {
+  char* end = nullptr;
+  long value = std::strtol(text, &end, 10);
+  if (!end || *end != '\0') return false;
+  out = static_cast<int>(value);
+  return true;
+}
+
+bool ParseArgs(int argc, char** argv, HeadlessOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    auto takeInt = [&](int& out) {
+      if (!value || !ParseInt(value, out)) return false;
+      ++i;
+      return true;
+    };
+
+    if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+      return false;
+    } else if (std::strcmp(arg, "--map") == 0 && value) {
+      options.mapPath = value;
+      ++i;
+    } else if (std::strcmp(arg, "--death-log") == 0 && value) {
+      options.deathLogPath = value;
+      ++i;
+    } else if (std::strcmp(arg, "--trace") == 0 && value) {
+      options.tracePath = value;
+      ++i;
+    } else if (std::strcmp(arg, "--record") == 0 && value) {
+      options.recordPath = value;
+      ++i;
+    } else if (std::strcmp(arg, "--replay") == 0 && value) {
+      options.replayPath = value;
+      ++i;
+    } else if (std::strcmp(arg, "--seed") == 0) {
+      int seed = 0;
+      if (!takeInt(seed)) return false;
+      options.seed = static_cast<uint32_t>(seed);
+    } else if (std::strcmp(arg, "--size") == 0 && value) {
+      if (std::sscanf(value, "%dx%d", &options.width, &options.height) != 2) return false;
+      ++i;
+    } else if (std::strcmp(arg, "--pop") == 0) {
+      if (!takeInt(options.population)) return false;
+    } else if (std::strcmp(arg, "--days") == 0) {
+      if (!takeInt(options.days)) return false;
+    } else if (std::strcmp(arg, "--warmup") == 0) {
+      if (!takeInt(options.warmupDays)) return false;
+    } else if (std::strcmp(arg, "--threads") == 0) {
+      if (!takeInt(options.threads)) return false;
+    } else if (std::strcmp(arg, "--ticks-per-day") == 0) {
+      if (!takeInt(options.ticksPerDay)) return false;
+    } else if (std::strcmp(arg, "--macro-batch") == 0) {
+      if (!takeInt(options.macroBatch)) return false;
+    } else if (std::strcmp(arg, "--report") == 0) {
+      if (!takeInt(options.reportEvery)) return false;
+    } else if (std::strcmp(arg, "--mode") == 0 && value) {
+      if (std::strcmp(value, "micro") == 0) {
+        options.macro = false;
+      } else if (std::strcmp(value, "macro") == 0) {
+        options.macro = true;
+      } else {
+        return false;
+      }
+      ++i;
+    } else {
+      std::fprintf(stderr, "unknown or incomplete option: %s\n", arg);
+      return false;
+    }
+  }
+  options.width = std::max(options.width, kMinWorldSide);
+  options.height = std::max(options.height, kMinWorldSide);
+  options.ticksPerDay = std::max(options.ticksPerDay, 1);
+  options.macroBatch = std::max(options.macroBatch, 1);
+  options.days = std::max(options.days, 0);
+  options.warmupDays = std::max(options.warmupDays, 0);
+  options.population = std::max(options.population, 0);
+  return true;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int RunReplayFile(const HeadlessOptions& options) {
+  Replay replay;
+  std::string error;
+  if (!LoadReplay(options.replayPath, replay, error)) {
+    std::fprintf(stderr, "replay: %s\n", error.c_str());
+    return 1;
+  }
+  SimHarness sim;
+  sim.humans.SetWorkerThreads(options.threads);
+  sim.settlements.SetWorkerThreads(options.threads);
+  ReplayResult result;
+  const auto start = std::chrono::steady_clock::now();
+  if (!RunReplay(replay, sim, result, error)) {
+    std::fprintf(stderr, "replay: %s\n", error.c_str());
+    return 1;
+  }
+  const double elapsed = SecondsSince(start);
+  if (result.diverged) {
+    if (result.expected.day - result.lastMatchedDay > 1) {
+      // Coarse days and macro batches hash once per step, not once per calendar day.
+      std::printf("replay diverged between day %d and day %d after %d matching steps: %s\n",
+                  result.lastMatchedDay + 1, result.expected.day, result.daysChecked,
+                  result.subsystems.c_str());
+    } else {
+      std::printf("replay diverged on day %d after %d matching steps: %s\n", result.expected.day,
+                  result.daysChecked, result.subsystems.c_str());
+    }
+    std::printf("  expected world %016llx humans %016llx settlements %016llx factions %016llx\n",
+                static_cast<unsigned long long>(result.expected.world),
+                static_cast<unsigned long long>(result.expected.humans),
+                static_cast<unsigned long long>(result.expected.settlements),
+                static_cast<unsigned long long>(result.expected.factions));
+    std::printf("  actual   world %016llx humans %016llx settlements %016llx factions %016llx\n",
+                static_cast<unsigned long long>(result.actual.world),
+                static_cast<unsigned long long>(result.actual.humans),
+                static_cast<unsigned long long>(result.actual.settlements),
+                static_cast<unsigned long long>(result.actual.factions));
+    return 2;
+  }
+  std::printf("replay ok: %d days matched (calendar day %d, pop %lld) in %.3f s\n",
+              result.daysChecked, sim.dayCount, static_cast<long long>(sim.Population()),
+              elapsed);
+  return 0;
+}
+
+void RecordDay(ReplayRecorder& recorder, const SimHarness& sim, bool macro, int macroDays = 1) {
+  if (!recorder.Active()) return;
+  if (macro) {
+    recorder.RecordMacroDays(macroDays);
+  } else {
+    recorder.RecordTicks(sim.ticksPerDay);
+  }
+  recorder.RecordDayHash(
+      ComputeStateHash(sim.dayCount, sim.world, sim.humans, sim.settlements, sim.factions));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  HeadlessOptions options;
+  if (!ParseArgs(argc, argv, options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  InstallCrashHandlers();
+  CrashContextSetStage("Headless::Init");
+  if (!options.replayPath.empty()) return RunReplayFile(options);
+
+  SimHarness sim;
+  sim.rng = Random(options.seed);
+  sim.ticksPerDay = options.ticksPerDay;
+  sim.tickSeconds =
+      static_cast<float>(options.daySeconds / static_cast<double>(options.ticksPerDay));
+  if (!options.mapPath.empty()) {
+    if (!sim.world.LoadMap(options.mapPath)) {
+      std::fprintf(stderr, "failed to load map: %s\n", options.mapPath.c_str());
+      return 1;
+    }
+  } else {
+    sim.world = World(options.width, options.height);
+    GenerateIslandTerrain(sim.world, options.seed);
+  }
+  sim.world.RecomputeScentFields();
+  CrashContextSetWorld(sim.world.width(), sim.world.height());
+  sim.humans.SetWorkerThreads(options.threads);
+  sim.settlements.SetWorkerThreads(options.threads);
+
+  DeathLogWriter deathLog;
+  if (!options.deathLogPath.empty()) {
+    if (deathLog.Open(options.deathLogPath)) {
+      sim.humans.SetDeathLogSink(&deathLog);
+    } else {
+      std::fprintf(stderr, "could not open death log: %s\n", options.deathLogPath.c_str());
+    }
+  }
+
+  ReplayRecorder recorder;
+  if (!options.recordPath.empty()) {
+    if (!recorder.Begin(options.recordPath, options.seed, sim.world, sim.ticksPerDay,
+                        sim.tickSeconds)) {
+      std::fprintf(stderr, "could not record replay: %s\n", options.recordPath.c_str());
+      return 1;
+    }
+    recorder.RecordToggles(true, true, true);
+    recorder.RecordPopulate(options.population);
+  }
+
+  const int spawned =
+      SpawnClusteredPopulation(sim.world, sim.humans, sim.rng, options.population);
+  if (spawned < options.population) {
+    std::fprintf(stderr, "spawned %d of %d humans (not enough land)\n", spawned,
+                 options.population);
+  }
+  std::printf("world %dx%d seed %u pop %d mode %s threads %d\n", sim.world.width(),
+              sim.world.height(), options.seed, sim.humans.CountAlive(),
+              options.macro ? "macro" : "micro", options.threads);
+
+  for (int day = 0; day < options.warmupDays; ++day) {
+    sim.StepDayMicro();
+    RecordDay(recorder, sim, false);
+  }
+  if (options.warmupDays > 0) {
+    std::printf("warmup %d days: pop %d settlements %d\n", options.warmupDays,
+                sim.humans.CountAlive(), sim.settlements.Count());
+  }
+  if (options.macro) {
+    sim.humans.EnterMacro(sim.settlements);
+    recorder.RecordEnterMacro();
+  }
+  ProfilerSetEnabled(!options.tracePath.empty());
+
+  const auto start = std::chrono::steady_clock::now();
+  auto reportStart = start;
+  int64_t ticks = 0;
+  for (int day = 0; day < options.days;) {
+    const int step = options.macro ? std::min(options.macroBatch, options.days - day) : 1;
+    ProfilerBeginFrame();
+    if (options.macro) {
+      sim.StepMacroDays(step);
+    } else {
+      sim.StepDayMicro();
+      ticks += sim.ticksPerDay;
+    }
+    ProfilerEndFrame();
+    RecordDay(recorder, sim, options.macro, step);
+    const int reportedBefore = (options.reportEvery > 0) ? day / options.reportEvery : 0;
+    day += step;
+
+    if (options.reportEvery > 0 && day / options.reportEvery != reportedBefore) {
+      const double elapsed = SecondsSince(reportStart);
+      reportStart = std::chrono::steady_clock::now();
+      std::printf("day %d pop %lld settlements %d factions %d wars %d (%.1f days/s)\n", day,
+                  static_cast<long long>(sim.Population()), sim.settlements.Count(),
+                  sim.factions.Count(), sim.factions.WarCount(),
+                  elapsed > 0.0 ? options.reportEvery / elapsed : 0.0);
+    }
+  }
+  const double elapsed = SecondsSince(start);
+
+  const int64_t finalPop = sim.Population();
+  double exitSeconds = 0.0;
+  if (options.macro) {
+    const auto exitStart = std::chrono::steady_clock::now();
+    sim.humans.ExitMacro(sim.settlements, sim.rng);
+    exitSeconds = SecondsSince(exitStart);
+    if (recorder.Active()) {
+      recorder.RecordExitMacro();
+      recorder.RecordRehydrate(0);
+      recorder.RecordDayHash(
+          ComputeStateHash(sim.dayCount, sim.world, sim.humans, sim.settlements, sim.factions));
+    }
+  }
+  deathLog.Close();
+  recorder.End();
+  if (!options.tracePath.empty() &&
+      !ProfilerWriteChromeTrace(options.tracePath, kProfilerHistoryFrames)) {
+    std::fprintf(stderr, "could not write trace: %s\n", options.tracePath.c_str());
+  }
+
+  const DeathSummary& summary = sim.humans.GetDeathSummary();
+  std::printf("simulated %d days (calendar day %d) in %.3f s\n", options.days, sim.dayCount,
+              elapsed);
+  if (!options.macro) {
+    std::printf("ticks/s %.1f\n", elapsed > 0.0 ? static_cast<double>(ticks) / elapsed : 0.0);
+  }
+  std::printf("days/s %.2f\n", elapsed > 0.0 ? options.days / elapsed : 0.0);
+  if (options.macro) std::printf("macro exit %.3f s\n", exitSeconds);
+  std::printf("population %lld births %lld deaths %lld\n", static_cast<long long>(finalPop),
+              static_cast<long long>(sim.births), static_cast<long long>(sim.deaths));
+  std::printf("settlements %d factions %d wars %d\n", sim.settlements.Count(),
+              sim.factions.Count(), sim.factions.WarCount());
+  std::printf("deaths: starvation %d dehydration %d old_age %d war %d macro %d/%d/%d\n",
+              summary.starvation, summary.dehydration, summary.oldAge, summary.war,
+              summary.macroNatural, summary.macroStarvation, summary.macroFire);
+  if (deathLog.Written() > 0 || deathLog.Dropped() > 0) {
+    std::printf("death log %s written %llu dropped %llu\n", deathLog.Path().c_str(),
+                static_cast<unsigned long long>(deathLog.Written()),
+                static_cast<unsigned long long>(deathLog.Dropped()));
+  }
+  return 0;
+}
@@ -1,19 +1,28 @@
 #include "humans.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
+#include <functional>
 #include <limits>
+#include <thread>
 
+#include "death_log.h"
+#include "profiler.h"
 #include "settlements.h"
 
 namespace {
 constexpr int kGestationDays = 90;
 constexpr int kCrowdPenalty = 25;
 constexpr int kMateRadius = 4;
+// Side of the square cells that key the eligible-male pools; a kMateRadius window overlaps at
+// most 2x2 of them.
+constexpr int kMateCellTiles = 8;
 constexpr int kMateCooldownDays = 30;
 constexpr float kMateBaseChance = 0.01f;
 constexpr float kMatePerMaleChance = 0.02f;
@@ -48,11 +57,15 @@ constexpr int kGathererWanderRadius = 18;
 constexpr int kScoutWanderRadius = 26;
 constexpr int kNoStockFoodSearchRadius = 24;
 constexpr int kNoStockFoodSearchSamples = 16;
+constexpr int kNoStockFoodExploreRadius = 96;
+constexpr uint32_t kFoodTaskTypes = TaskStore::TypeBit(TaskType::CollectFood) |
+                                    TaskStore::TypeBit(TaskType::HarvestFarm) |
+                                    TaskStore::TypeBit(TaskType::PlantFarm);
 constexpr int kOldAgeStartDays = 80 * Human::kDaysPerYear;
 constexpr int kOldAgeMaxDays = 130 * Human::kDaysPerYear;
 constexpr uint16_t kOldAgeMaxDailyChanceQ16 = 1311;  // ~0.02 * 65535
 
-constexpr int kMacroBins = 6;
+constexpr int kMacroBins = MacroCohorts::kBins;
 constexpr int kMacroBinDays[kMacroBins] = {
     Human::kDaysPerYear,
     4 * Human::kDaysPerYear,
@@ -63,6 +76,10 @@ constexpr int kMacroBinDays[kMacroBins] = {
 };
 constexpr float kMacroDeathRate[kMacroBins] = {0.0020f, 0.0003f, 0.00008f, 0.00012f, 0.0006f, 0.0025f};
 constexpr float kMacroBirthRatePerDay = 0.0014f;
+// Settlements per block in the macro cohort kernels; a block's working set stays in L1.
+constexpr size_t kMacroLaneBlock = 256;
+constexpr int kRehydrateChunk = 8192;
+constexpr int kRehydrateMaxThreads = 8;
 
 bool IsWalkable(const Tile& tile) {
   return tile.type != TileType::Ocean;
@@ -198,40 +215,16 @@ bool TryPickNoStockFoodTarget(Human& human, const World& world, const Settlement
       bestY = y;
     }
   }
-  if (bestX == -1 || bestY == -1) return false;
+  if (bestX == -1 || bestY == -1) {
+    // Every probe missed: sparse food, not none. Take the nearest to the same base instead.
+    return world.FindNearestWithResource(baseX, baseY, ResourceKind::Food,
+                                         kNoStockFoodSearchRadius, human.targetX, human.targetY);
+  }
   human.targetX = bestX;
   human.targetY = bestY;
   return true;
 }
 
-void PickNoStockFoodExploreTarget(Human& human, const World& world, const SettlementManager& settlements,
-                                  int tickCount) {
-  int baseX = human.x;
-  int baseY = human.y;
-  if (human.settlementId != -1) {
-    const Settlement* settlement = settlements.Get(human.settlementId);
-    if (settlement) {
-      baseX = settlement->centerX;
-      baseY = settlement->centerY;
-    }
-  }
-
-  uint32_t hash = HashNoise(static_cast<uint32_t>(human.id),
-                            static_cast<uint32_t>(tickCount),
-                            0xF0u, 0x0Du);
-  int radius = kNoStockFoodSearchRadius;
-  int dx = static_cast<int>(hash % (radius * 2 + 1)) - radius;
-  int dy = static_cast<int>((hash >> 8) % (radius * 2 + 1)) - radius;
-  int x = ClampInt(baseX + dx, 0, world.width() - 1);
-  int y = ClampInt(baseY + dy, 0, world.height() - 1);
-  if (world.At(x, y).type == TileType::Ocean) {
-    x = human.x;
-    y = human.y;
-  }
-  human.targetX = x;
-  human.targetY = y;
-}
-
 uint16_t OldAgeDailyChanceQ16(int ageDays, bool legendary) {
   if (ageDays < kOldAgeStartDays) return 0;
   if (ageDays >= kOldAgeMaxDays) return 65535u;
@@ -313,15 +306,50 @@ int AgeBinIndex(int ageDays) {
   return kMacroBins - 1;
 }
 
-int ApplyRate(int count, float rate, Random& rng) {
-  if (count <= 0 || rate <= 0.0f) return 0;
-  float expected = static_cast<float>(count) * rate;
-  int whole = static_cast<int>(expected);
-  float frac = expected - static_cast<float>(whole);
-  int extra = rng.Chance(frac) ? 1 : 0;
-  int total = whole + extra;
-  if (total > count) total = count;
-  return total;
+// Expected flow of one macro day, out[to][from]: deaths in every bin first, then ageing from the
+// youngest bin up, so arrivals can move on the same day.
+void DailyCohortTransition(const float (&deathRate)[kMacroBins],
+                           double (&out)[kMacroBins][kMacroBins]) {
+  for (int from = 0; from < kMacroBins; ++from) {
+    double v[kMacroBins] = {};
+    v[from] = 1.0;
+    for (int bin = 0; bin < kMacroBins; ++bin) {
+      v[bin] *= std::max(0.0, 1.0 - static_cast<double>(deathRate[bin]));
+    }
+    for (int bin = 0; bin < kMacroBins - 1; ++bin) {
+      double move = v[bin] / static_cast<double>(kMacroBinDays[bin]);
+      v[bin] -= move;
+      v[bin + 1] += move;
+    }
+    for (int to = 0; to < kMacroBins; ++to) out[to][from] = v[to];
+  }
+}
+
+void MultiplyCohortTransitions(const double (&a)[kMacroBins][kMacroBins],
+                               const double (&b)[kMacroBins][kMacroBins],
+                               double (&out)[kMacroBins][kMacroBins]) {
+  double result[kMacroBins][kMacroBins] = {};
+  for (int to = 0; to < kMacroBins; ++to) {
+    for (int mid = 0; mid < kMacroBins; ++mid) {
+      if (a[to][mid] == 0.0) continue;
+      for (int from = 0; from < kMacroBins; ++from) result[to][from] += a[to][mid] * b[mid][from];
+    }
+  }
+  std::memcpy(out, result, sizeof(result));
+}
+
+// The daily transition raised to days by squaring.
+void CohortTransitionPower(const float (&deathRate)[kMacroBins], int days,
+                           double (&out)[kMacroBins][kMacroBins]) {
+  double base[kMacroBins][kMacroBins];
+  DailyCohortTransition(deathRate, base);
+  double result[kMacroBins][kMacroBins] = {};
+  for (int bin = 0; bin < kMacroBins; ++bin) result[bin][bin] = 1.0;
+  for (int n = days; n > 0; n >>= 1) {
+    if (n & 1) MultiplyCohortTransitions(result, base, result);
+    MultiplyCohortTransitions(base, base, base);
+  }
+  std::memcpy(out, result, sizeof(result));
 }
 
 bool TaskTargetsTile(TaskType type) {
@@ -549,11 +577,16 @@ void HumanTraitsToString(char* buffer, size_t size, uint16_t traits, bool legend
 
 HumanManager::HumanManager() {
   newborns_.reserve(32);
+  macroFallback_.Resize(1);
 }
 
 Human HumanManager::CreateHuman(int x, int y, bool female, Random& rng, int ageDays) {
+  return CreateHumanWithId(AcquireHumanId(), x, y, female, rng, ageDays);
+}
+
+Human HumanManager::CreateHumanWithId(int id, int x, int y, bool female, Random& rng, int ageDays) {
   Human human;
-  human.id = nextId_++;
+  human.id = id;
   human.female = female;
   human.ageDays = ageDays;
   human.x = x;
@@ -622,24 +655,156 @@ Human HumanManager::CreateHuman(int x, int y, bool female, Random& rng, int ageD
 void HumanManager::Spawn(int x, int y, bool female, Random& rng) {
   humans_.push_back(CreateHuman(x, y, female, rng, Human::kAdultAgeDays));
   const int idx = static_cast<int>(humans_.size()) - 1;
-  const int id = humans_[static_cast<size_t>(idx)].id;
-  if (id > 0) {
-    if (id >= static_cast<int>(humanIdToIndex_.size())) {
-      humanIdToIndex_.resize(static_cast<size_t>(nextId_), -1);
+  const Human& human = humans_[static_cast<size_t>(idx)];
+  slotIndex_[static_cast<size_t>(SlotFromId(human.id))] = idx;
+  if (human.legendary) legendaryIds_.push_back(human.id);
+  dailyCensusGeneration_ = 0;
+}
+
+int HumanManager::AcquireHumanId() {
+  int slot = 0;
+  if (!freeSlots_.empty()) {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+  } else {
+    slot = static_cast<int>(slotIndex_.size());
+    if (slot >= kHumanSlotLimit) {
+      // Every (slot, generation) pair has been issued; handing one out again would alias.
+      CrashContextSetNote("AcquireHumanId: human id space exhausted");
+      std::fprintf(stderr, "human id space exhausted (%d slots x %d generations)\n",
+                   kHumanSlotLimit, static_cast<int>(kHumanGenerationMax));
+      std::terminate();
     }
-    humanIdToIndex_[static_cast<size_t>(id)] = idx;
+    slotIndex_.push_back(-1);
+    slotGeneration_.push_back(1);
+    matePoolBySlot_.push_back(-1);
+    matePosBySlot_.push_back(-1);
   }
+  slotIndex_[static_cast<size_t>(slot)] = -1;
+  return (static_cast<int>(slotGeneration_[static_cast<size_t>(slot)]) << kHumanSlotBits) | slot;
 }
 
-void HumanManager::RebuildIdMap() {
-  humanIdToIndex_.assign(nextId_, -1);
-  for (int i = 0; i < static_cast<int>(humans_.size()); ++i) {
-    humanIdToIndex_[humans_[i].id] = i;
+void HumanManager::ReleaseHumanId(int id) {
+  const int slot = SlotFromId(id);
+  if (slot < 0 || slot >= static_cast<int>(slotIndex_.size())) return;
+  uint8_t& generation = slotGeneration_[static_cast<size_t>(slot)];
+  if (generation != static_cast<uint8_t>(id >> kHumanSlotBits)) return;
+  if (matePoolBySlot_[static_cast<size_t>(slot)] >= 0) RemoveFromMatePool(slot);
+  slotIndex_[static_cast<size_t>(slot)] = -1;
+  if (generation >= kHumanGenerationMax) {
+    // Retired: no issued id carries generation 0, so every id of this slot stays stale and
+    // the slot is never handed out again.
+    generation = 0;
+    return;
   }
+  generation = static_cast<uint8_t>(generation + 1);
+  freeSlots_.push_back(slot);
+}
+
+int HumanManager::IndexForId(int id) const {
+  if (id <= 0) return -1;
+  const int slot = SlotFromId(id);
+  if (slot >= static_cast<int>(slotIndex_.size())) return -1;
+  if (slotGeneration_[static_cast<size_t>(slot)] != static_cast<uint8_t>(id >> kHumanSlotBits)) {
+    return -1;
+  }
+  return slotIndex_[static_cast<size_t>(slot)];
+}
+
+const Human* HumanManager::FindById(int id) const {
+  int idx = IndexForId(id);
+  if (idx < 0 || idx >= static_cast<int>(humans_.size())) return nullptr;
+  const Human& human = humans_[static_cast<size_t>(idx)];
+  return human.alive ? &human : nullptr;
+}
+
+Human* HumanManager::FindByIdMutable(int id) {
+  int idx = IndexForId(id);
+  if (idx < 0 || idx >= static_cast<int>(humans_.size())) return nullptr;
+  Human& human = humans_[static_cast<size_t>(idx)];
+  return human.alive ? &human : nullptr;
+}
+
+void HumanManager::KillHuman(Human& human, int day, DeathReason reason) {
+  RecordDeath(human.id, day, reason);
+  human.alive = false;
+  if (human.legendary) {
+    auto it = std::find(legendaryIds_.begin(), legendaryIds_.end(), human.id);
+    if (it != legendaryIds_.end()) legendaryIds_.erase(it);
+  }
+  dailyCensusGeneration_ = 0;
+  ReleaseHumanId(human.id);
+  deadIndices_.push_back(static_cast<int>(&human - humans_.data()));
+}
+
+int HumanManager::MatePoolAt(int x, int y) const {
+  if (mateCellsX_ <= 0) return -1;
+  if (static_cast<unsigned>(x) >= static_cast<unsigned>(crowdGridW_) ||
+      static_cast<unsigned>(y) >= static_cast<unsigned>(crowdGridH_)) {
+    return -1;
+  }
+  return (y / kMateCellTiles) * mateCellsX_ + x / kMateCellTiles;
+}
+
+int HumanManager::MatePoolFor(const Human& human) const {
+  if (!human.alive || human.female || human.ageDays < Human::kAdultAgeDays) return -1;
+  return MatePoolAt(human.x, human.y);
+}
+
+void HumanManager::SyncMatePool(const Human& human) {
+  const int slot = SlotFromId(human.id);
+  const int pool = MatePoolFor(human);
+  if (matePoolBySlot_[static_cast<size_t>(slot)] == pool) return;
+  if (matePoolBySlot_[static_cast<size_t>(slot)] >= 0) RemoveFromMatePool(slot);
+  if (pool < 0) return;
+  std::vector<int>& members = matePools_[static_cast<size_t>(pool)];
+  matePoolBySlot_[static_cast<size_t>(slot)] = pool;
+  matePosBySlot_[static_cast<size_t>(slot)] = static_cast<int>(members.size());
+  members.push_back(human.id);
+}
+
+void HumanManager::RemoveFromMatePool(int slot) {
+  std::vector<int>& members =
+      matePools_[static_cast<size_t>(matePoolBySlot_[static_cast<size_t>(slot)])];
+  const int pos = matePosBySlot_[static_cast<size_t>(slot)];
+  const int movedId = members.back();
+  members[static_cast<size_t>(pos)] = movedId;
+  matePosBySlot_[static_cast<size_t>(SlotFromId(movedId))] = pos;
+  members.pop_back();
+  matePoolBySlot_[static_cast<size_t>(slot)] = -1;
+  matePosBySlot_[static_cast<size_t>(slot)] = -1;
+}
+
+void HumanManager::NoteEldest(const Settlement* settlement, const Human& human) {
+  if (!settlement || settlement->factionId <= 0) return;
+  const size_t index = static_cast<size_t>(settlement->factionId);
+  if (index >= eldestByFaction_.size()) eldestByFaction_.resize(index + 1);
+  EldestMember& eldest = eldestByFaction_[index];
+  if (human.ageDays > eldest.ageDays ||
+      (human.ageDays == eldest.ageDays && human.id < eldest.id)) {
+    eldest.id = human.id;
+    eldest.ageDays = human.ageDays;
+  }
+}
+
+void HumanManager::RemoveDeadHumans() {
+  if (deadIndices_.empty()) return;
+  // Swap-remove from the back so every move only touches survivors.
+  std::sort(deadIndices_.begin(), deadIndices_.end(), std::greater<int>());
+  for (int idx : deadIndices_) {
+    if (idx < 0 || idx >= static_cast<int>(humans_.size())) continue;
+    const int last = static_cast<int>(humans_.size()) - 1;
+    if (idx != last) {
+      humans_[static_cast<size_t>(idx)] = humans_[static_cast<size_t>(last)];
+      slotIndex_[static_cast<size_t>(SlotFromId(humans_[static_cast<size_t>(idx)].id))] = idx;
+    }
+    humans_.pop_back();
+  }
+  deadIndices_.clear();
 }
 
 void HumanManager::RecordDeath(int humanId, int day, DeathReason reason) {
-  deathLog_.push_back(DeathRecord{day, humanId, reason});
+  if (deathLogSink_) deathLogSink_->Push(DeathRecord{day, humanId, reason});
   switch (reason) {
     case DeathReason::Starvation:
       deathSummary_.starvation++;
@@ -657,13 +822,10 @@ void HumanManager::RecordDeath(int humanId, int day, DeathReason reason) {
 }
 
 bool HumanManager::GetHumanById(int id, int& outX, int& outY) const {
-  if (id <= 0 || id >= static_cast<int>(humanIdToIndex_.size())) return false;
-  int idx = humanIdToIndex_[id];
-  if (idx < 0 || idx >= static_cast<int>(humans_.size())) return false;
-  const Human& human = humans_[idx];
-  if (!human.alive) return false;
-  outX = human.x;
-  outY = human.y;
+  const Human* human = FindById(id);
+  if (!human) return false;
+  outX = human->x;
+  outY = human->y;
   return true;
 }
 
@@ -689,17 +851,6 @@ int HumanManager::AdultMaleCountAt(int x, int y) const {
   return adultMaleCountByTile_[static_cast<size_t>(idx)];
 }
 
-int HumanManager::AdultMaleSampleIdAt(int x, int y) const {
-  if (crowdGridW_ <= 0 || crowdGridH_ <= 0) return -1;
-  if (static_cast<unsigned>(x) >= static_cast<unsigned>(crowdGridW_) ||
-      static_cast<unsigned>(y) >= static_cast<unsigned>(crowdGridH_)) {
-    return -1;
-  }
-  const int idx = y * crowdGridW_ + x;
-  if (adultMaleStampByTile_[static_cast<size_t>(idx)] != crowdGeneration_) return -1;
-  return adultMaleSampleIdByTile_[static_cast<size_t>(idx)];
-}
-
 void HumanManager::EnsureCrowdGrids(int w, int h) {
   if (w <= 0 || h <= 0) {
     crowdGridW_ = 0;
@@ -709,7 +860,6 @@ void HumanManager::EnsureCrowdGrids(int w, int h) {
     popCountByTile_.clear();
     adultMaleStampByTile_.clear();
     adultMaleCountByTile_.clear();
-    adultMaleSampleIdByTile_.clear();
     soldierGridGeneration_ = 1;
     soldierStampByTile_.clear();
     soldierCountByTile_.clear();
@@ -718,6 +868,11 @@ void HumanManager::EnsureCrowdGrids(int w, int h) {
     unitStampByTile_.clear();
     unitCountByTile_.clear();
     unitSampleIdByTile_.clear();
+    gradientGeneration_ = 1;
+    gradientCache_.clear();
+    mateCellsX_ = 0;
+    matePools_.clear();
+    std::fill(matePoolBySlot_.begin(), matePoolBySlot_.end(), -1);
     return;
   }
 
@@ -731,7 +886,6 @@ void HumanManager::EnsureCrowdGrids(int w, int h) {
   popCountByTile_.assign(total, 0);
   adultMaleStampByTile_.assign(total, 0u);
   adultMaleCountByTile_.assign(total, 0);
-  adultMaleSampleIdByTile_.assign(total, -1);
   soldierGridGeneration_ = 1;
   soldierStampByTile_.assign(total, 0u);
   soldierCountByTile_.assign(total, 0);
@@ -740,30 +894,84 @@ void HumanManager::EnsureCrowdGrids(int w, int h) {
   unitStampByTile_.assign(total, 0u);
   unitCountByTile_.assign(total, 0);
   unitSampleIdByTile_.assign(total, -1);
+  gradientGeneration_ = 1;
+  gradientCache_.assign(total, GradientCell{});
+  mateCellsX_ = (w + kMateCellTiles - 1) / kMateCellTiles;
+  matePools_.clear();
+  matePools_.resize(static_cast<size_t>(mateCellsX_) *
+                    static_cast<size_t>((h + kMateCellTiles - 1) / kMateCellTiles));
+  std::fill(matePoolBySlot_.begin(), matePoolBySlot_.end(), -1);
 }
 
-int HumanManager::FindMateTargetId(const Human& human, const World& world, Random& rng) const {
-  const int w = world.width();
-  const int h = world.height();
-  int total = 0;
-  int selected = -1;
+void HumanManager::BeginDailyCensus(int w, int h) {
+  EnsureCrowdGrids(w, h);
+  crowdGeneration_++;
+  if (crowdGeneration_ == 0) {
+    std::fill(popStampByTile_.begin(), popStampByTile_.end(), 0u);
+    std::fill(adultMaleStampByTile_.begin(), adultMaleStampByTile_.end(), 0u);
+    crowdGeneration_ = 1;
+  }
+  dailyCensusGeneration_ = crowdGeneration_;
+}
 
-  for (int dy = -kMateRadius; dy <= kMateRadius; ++dy) {
-    int ny = human.y + dy;
-    if (ny < 0 || ny >= h) continue;
-    for (int dx = -kMateRadius; dx <= kMateRadius; ++dx) {
-      int nx = human.x + dx;
-      if (nx < 0 || nx >= w) continue;
-      int count = AdultMaleCountAt(nx, ny);
-      if (count <= 0) continue;
-      total += count;
-      int sampleId = AdultMaleSampleIdAt(nx, ny);
-      if (sampleId != -1 && rng.RangeInt(0, total - 1) < count) {
-        selected = sampleId;
-      }
+void HumanManager::CountForDailyCensus(const Human& human) {
+  if (static_cast<unsigned>(human.x) >= static_cast<unsigned>(crowdGridW_) ||
+      static_cast<unsigned>(human.y) >= static_cast<unsigned>(crowdGridH_)) {
+    return;
+  }
+  const size_t idx = static_cast<size_t>(human.y) * static_cast<size_t>(crowdGridW_) +
+                     static_cast<size_t>(human.x);
+  if (popStampByTile_[idx] != crowdGeneration_) {
+    popStampByTile_[idx] = crowdGeneration_;
+    popCountByTile_[idx] = 0;
+  }
+  popCountByTile_[idx]++;
+
+  if (!human.female && human.ageDays >= Human::kAdultAgeDays) {
+    if (adultMaleStampByTile_[idx] != crowdGeneration_) {
+      adultMaleStampByTile_[idx] = crowdGeneration_;
+      adultMaleCountByTile_[idx] = 0;
     }
+    adultMaleCountByTile_[idx]++;
   }
+  SyncMatePool(human);
+}
 
+int HumanManager::FindMateTargetId(const Human& human, Random& rng) const {
+  if (mateCellsX_ <= 0) return -1;
+  // Same window the daily mating chance counts: every adult male within kMateRadius (Chebyshev),
+  // drawn uniformly. Only the pool cells overlapping the window are visited.
+  const int minX = std::max(human.x - kMateRadius, 0);
+  const int minY = std::max(human.y - kMateRadius, 0);
+  const int maxX = std::min(human.x + kMateRadius, crowdGridW_ - 1);
+  const int maxY = std::min(human.y + kMateRadius, crowdGridH_ - 1);
+  if (minX > maxX || minY > maxY) return -1;
+  auto forEachInRange = [&](auto&& visit) {
+    for (int cy = minY / kMateCellTiles; cy <= maxY / kMateCellTiles; ++cy) {
+      for (int cx = minX / kMateCellTiles; cx <= maxX / kMateCellTiles; ++cx) {
+        for (int id : matePools_[static_cast<size_t>(cy * mateCellsX_ + cx)]) {
+          const int idx = IndexForId(id);
+          if (idx < 0) continue;
+          const Human& male = humans_[static_cast<size_t>(idx)];
+          if (male.x < minX || male.x > maxX || male.y < minY || male.y > maxY) continue;
+          if (visit(id)) return;
+        }
+      }
+    }
+  };
+  int inRange = 0;
+  forEachInRange([&](int) {
+    inRange++;
+    return false;
+  });
+  if (inRange == 0) return -1;
+  int pick = rng.RangeInt(0, inRange - 1);
+  int selected = -1;
+  forEachInRange([&](int id) {
+    if (pick-- > 0) return false;
+    selected = id;
+    return true;
+  });
   return selected;
 }
 
@@ -892,6 +1100,62 @@ const HumanManager::FlowFieldEntry* HumanManager::GetFlowField(const World& worl
   return &flowFields_.back();
 }
 
+void HumanManager::PickNoStockFoodExploreTarget(Human& human, const World& world,
+                                                const SettlementManager& settlements,
+                                                int tickCount, int day) {
+  int baseX = human.x;
+  int baseY = human.y;
+  const Settlement* settlement =
+      (human.settlementId != -1) ? settlements.Get(human.settlementId) : nullptr;
+  if (settlement) {
+    baseX = settlement->centerX;
+    baseY = settlement->centerY;
+  }
+
+  // Head for the nearest food beyond the local search before wandering blindly. Every member
+  // searches from the settlement center, so one query per settlement per day serves them all;
+  // the entry is redone early only once its tile has been eaten.
+  if (settlement) {
+    if (static_cast<int>(exploreFoodCache_.size()) <= settlement->id) {
+      exploreFoodCache_.resize(static_cast<size_t>(settlement->id) + 1);
+    }
+    ExploreFoodTarget& entry = exploreFoodCache_[static_cast<size_t>(settlement->id)];
+    const bool stale = entry.day != day || entry.centerX != baseX || entry.centerY != baseY ||
+                       (entry.found && world.At(entry.x, entry.y).food == 0);
+    if (stale) {
+      entry.day = day;
+      entry.centerX = baseX;
+      entry.centerY = baseY;
+      entry.found = world.FindNearestWithResource(baseX, baseY, ResourceKind::Food,
+                                                  kNoStockFoodExploreRadius, entry.x, entry.y);
+    }
+    if (entry.found) {
+      human.targetX = entry.x;
+      human.targetY = entry.y;
+      return;
+    }
+  } else if (world.FindNearestWithResource(baseX, baseY, ResourceKind::Food,
+                                           kNoStockFoodExploreRadius, human.targetX,
+                                           human.targetY)) {
+    return;
+  }
+
+  uint32_t hash = HashNoise(static_cast<uint32_t>(human.id),
+                            static_cast<uint32_t>(tickCount),
+                            0xF0u, 0x0Du);
+  int radius = kNoStockFoodSearchRadius;
+  int dx = static_cast<int>(hash % (radius * 2 + 1)) - radius;
+  int dy = static_cast<int>((hash >> 8) % (radius * 2 + 1)) - radius;
+  int x = ClampInt(baseX + dx, 0, world.width() - 1);
+  int y = ClampInt(baseY + dy, 0, world.height() - 1);
+  if (world.At(x, y).type == TileType::Ocean) {
+    x = human.x;
+    y = human.y;
+  }
+  human.targetX = x;
+  human.targetY = y;
+}
+
 void HumanManager::ReplanGoal(Human& human, const World& world, const SettlementManager& settlements,
                               Random& rng, int tickCount, int ticksPerDay) {
   if (!human.alive) return;
@@ -974,7 +1238,8 @@ void HumanManager::ReplanGoal(Human& human, const World& world, const Settlement
     human.mateTargetId = -1;
     if (!SettlementHasStockFood(settlements, human)) {
       if (!TryPickNoStockFoodTarget(human, world, settlements, rng, tickCount)) {
-        PickNoStockFoodExploreTarget(human, world, settlements, tickCount);
+        PickNoStockFoodExploreTarget(human, world, settlements, tickCount,
+                                     tickCount / std::max(1, ticksPerDay));
       }
     } else {
       human.targetX = human.x;
@@ -1014,7 +1279,7 @@ void HumanManager::ReplanGoal(Human& human, const World& world, const Settlement
       }
     }
     if (canMate) {
-      int mateId = FindMateTargetId(human, world, rng);
+      int mateId = FindMateTargetId(human, rng);
       if (mateId != -1) {
         human.goal = Goal::SeekMate;
         human.mateTargetId = mateId;
@@ -1209,19 +1474,9 @@ void HumanManager::UpdateMoveStep(Human& human, World& world, SettlementManager&
     Settlement* settlement = settlements.GetMutable(human.settlementId);
     if (settlement) {
       Task task;
-      int attempts = 0;
-      bool allowFoodTask = emergency;
-      bool picked = false;
-      while (attempts < 4 && settlement->PopTask(task)) {
-        attempts++;
-        if (!allowFoodTask ||
-            task.type == TaskType::CollectFood || task.type == TaskType::HarvestFarm ||
-            task.type == TaskType::PlantFarm) {
-          picked = true;
-          break;
-        }
-      }
-      if (picked) {
+      // In an emergency only food work is claimed; everything else stays queued.
+      const uint32_t typeMask = emergency ? kFoodTaskTypes : TaskStore::kAnyType;
+      if (settlements.ClaimNearestTask(*settlement, human.x, human.y, typeMask, task)) {
         human.hasTask = true;
         human.taskType = task.type;
         human.taskX = task.x;
@@ -1373,12 +1628,65 @@ void HumanManager::UpdateMoveStep(Human& human, World& world, SettlementManager&
   }
 }
 
+void HumanManager::UpdateArrows(SettlementManager& settlements, float tickSeconds) {
+  if (arrows_.empty()) return;
+  auto indexForId = [&](int id) -> int {
+    int idx = IndexForId(id);
+    if (idx < 0 || idx >= static_cast<int>(humans_.size())) return -1;
+    return idx;
+  };
+
+  size_t write = 0;
+  const float hitRadiusSq = kArrowHitRadiusTiles * kArrowHitRadiusTiles;
+  for (size_t read = 0; read < arrows_.size(); ++read) {
+    ArrowProjectile arrow = arrows_[read];
+    arrow.prevX = arrow.x;
+    arrow.prevY = arrow.y;
+    arrow.x += arrow.vx * tickSeconds;
+    arrow.y += arrow.vy * tickSeconds;
+    arrow.ttlSeconds -= tickSeconds;
+
+    bool keep = (arrow.ttlSeconds > 0.0f);
+    if (keep) {
+      int tidx = indexForId(arrow.targetId);
+      if (tidx < 0) {
+        keep = false;
+      } else {
+        Human& target = humans_[tidx];
+        if (!target.alive) {
+          keep = false;
+        } else {
+          float tx = target.px;
+          float ty = target.py;
+          float dx = tx - arrow.x;
+          float dy = ty - arrow.y;
+          float distSq = dx * dx + dy * dy;
+          if (distSq <= hitRadiusSq) {
+            target.health = std::max(0, target.health - kArrowDamage);
+            if (target.health <= 0) {
+              MarkDeadByIndex(tidx, currentDay_, DeathReason::War);
+              settlements.AddWarDeaths(1);
+            }
+            keep = false;
+          }
+        }
+      }
+    }
+
+    if (keep) {
+      arrows_[write++] = arrow;
+    }
+  }
+  arrows_.resize(write);
+}
+
 void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Random& rng,
                               int tickCount, float tickSeconds, int ticksPerDay) {
   if (macroActive_) return;
   if (humans_.empty()) return;
 
   CrashContextSetStage("Humans::UpdateTick");
+  FUNSIM_PROFILE_ZONE("Humans::UpdateTick");
   const int w = world.width();
   const int h = world.height();
   EnsureCrowdGrids(w, h);
@@ -1417,72 +1725,11 @@ void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Rand
       }
       popCountByTile_[static_cast<size_t>(idx)]++;
 
-      if (!human.female && human.ageDays >= Human::kAdultAgeDays) {
-        if (adultMaleStampByTile_[static_cast<size_t>(idx)] != crowdGeneration_) {
-          adultMaleStampByTile_[static_cast<size_t>(idx)] = crowdGeneration_;
-          adultMaleCountByTile_[static_cast<size_t>(idx)] = 0;
-          adultMaleSampleIdByTile_[static_cast<size_t>(idx)] = -1;
-        }
-        int count = ++adultMaleCountByTile_[static_cast<size_t>(idx)];
-        int currentSample = adultMaleSampleIdByTile_[static_cast<size_t>(idx)];
-        if (currentSample == -1 || rng.RangeInt(0, count - 1) == 0) {
-          adultMaleSampleIdByTile_[static_cast<size_t>(idx)] = human.id;
-        }
-      }
+      SyncMatePool(human);
     }
   }
 
-  if (!arrows_.empty()) {
-    auto indexForId = [&](int id) -> int {
-      if (id <= 0 || id >= static_cast<int>(humanIdToIndex_.size())) return -1;
-      int idx = humanIdToIndex_[id];
-      if (idx < 0 || idx >= static_cast<int>(humans_.size())) return -1;
-      return idx;
-    };
-
-    size_t write = 0;
-    const float hitRadiusSq = kArrowHitRadiusTiles * kArrowHitRadiusTiles;
-    for (size_t read = 0; read < arrows_.size(); ++read) {
-      ArrowProjectile arrow = arrows_[read];
-      arrow.prevX = arrow.x;
-      arrow.prevY = arrow.y;
-      arrow.x += arrow.vx * tickSeconds;
-      arrow.y += arrow.vy * tickSeconds;
-      arrow.ttlSeconds -= tickSeconds;
-
-      bool keep = (arrow.ttlSeconds > 0.0f);
-      if (keep) {
-        int tidx = indexForId(arrow.targetId);
-        if (tidx < 0) {
-          keep = false;
-        } else {
-          Human& target = humans_[tidx];
-          if (!target.alive) {
-            keep = false;
-          } else {
-            float tx = target.px;
-            float ty = target.py;
-            float dx = tx - arrow.x;
-            float dy = ty - arrow.y;
-            float distSq = dx * dx + dy * dy;
-            if (distSq <= hitRadiusSq) {
-              target.health = std::max(0, target.health - kArrowDamage);
-              if (target.health <= 0) {
-                MarkDeadByIndex(tidx, currentDay_, DeathReason::War);
-                settlements.AddWarDeaths(1);
-              }
-              keep = false;
-            }
-          }
-        }
-      }
-
-      if (keep) {
-        arrows_[write++] = arrow;
-      }
-    }
-    arrows_.resize(write);
-  }
+  UpdateArrows(settlements, tickSeconds);
 
   int thinkBudget = ClampInt(static_cast<int>(humans_.size() / 500), 200, 5000);
   for (int i = 0; i < thinkBudget && !humans_.empty(); ++i) {
@@ -1539,6 +1786,34 @@ void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Rand
       return Vec2{gx, gy};
     };
 
+    gradientGeneration_++;
+    if (gradientGeneration_ == 0) {
+      std::fill(gradientCache_.begin(), gradientCache_.end(), GradientCell{});
+      gradientGeneration_ = 1;
+    }
+    // Normalized gradients are shared by everyone standing on the same tile this tick.
+    auto cachedGradient = [&](ScentField field, auto&& sampleFn, int tx, int ty) -> Vec2 {
+      if (static_cast<unsigned>(tx) >= static_cast<unsigned>(w) ||
+          static_cast<unsigned>(ty) >= static_cast<unsigned>(h) || gradientCache_.empty()) {
+        return NormalizeOrZero(sampleFieldGradient(sampleFn, tx, ty));
+      }
+      GradientCell& cell = gradientCache_[static_cast<size_t>(ty * w + tx)];
+      if (cell.stamp != gradientGeneration_) {
+        cell.stamp = gradientGeneration_;
+        cell.mask = 0;
+      }
+      const int f = static_cast<int>(field);
+      const uint8_t bit = static_cast<uint8_t>(1u << f);
+      if ((cell.mask & bit) == 0) {
+        Vec2 g = NormalizeOrZero(sampleFieldGradient(sampleFn, tx, ty));
+        cell.dirX[f] = static_cast<int8_t>(std::lround(g.x * 127.0f));
+        cell.dirY[f] = static_cast<int8_t>(std::lround(g.y * 127.0f));
+        cell.mask |= bit;
+      }
+      return Vec2{static_cast<float>(cell.dirX[f]) * (1.0f / 127.0f),
+                  static_cast<float>(cell.dirY[f]) * (1.0f / 127.0f)};
+    };
+
     int flowBuildBudget = 1;  // build at most 1 new flow-field per tick to avoid spikes
 
     for (auto& human : humans_) {
@@ -1568,9 +1843,7 @@ void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Rand
         targetPos = Vec2{static_cast<float>(stayX) + 0.5f, static_cast<float>(stayY) + 0.5f};
         hasTarget = true;
       } else if (human.goal == Goal::SeekMate && human.mateTargetId != -1) {
-        int tidx = (human.mateTargetId > 0 && human.mateTargetId < static_cast<int>(humanIdToIndex_.size()))
-                       ? humanIdToIndex_[human.mateTargetId]
-                       : -1;
+        int tidx = IndexForId(human.mateTargetId);
         if (tidx >= 0 && tidx < static_cast<int>(humans_.size()) && humans_[tidx].alive) {
           targetPos = Vec2{humans_[tidx].px, humans_[tidx].py};
           hasTarget = true;
@@ -1584,8 +1857,8 @@ void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Rand
 
       if (human.goal == Goal::FleeFire) {
         auto fireAt = [&](int x, int y) { return world.FireRiskAt(x, y); };
-        Vec2 g = sampleFieldGradient(fireAt, human.x, human.y);
-        steer = steer + NormalizeOrZero(g) * -1.4f;
+        Vec2 g = cachedGradient(ScentField::Fire, fireAt, human.x, human.y);
+        steer = steer + g * -1.4f;
       }
 
       if (human.settlementId != -1) {
@@ -1593,16 +1866,16 @@ void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Rand
         const bool wanderHeavy = (human.goal == Goal::Wander || isGatherOrScout);
         if (!wanderHeavy) {
           auto homeAt = [&](int x, int y) { return world.HomeScentAt(x, y); };
-          Vec2 g = sampleFieldGradient(homeAt, human.x, human.y);
+          Vec2 g = cachedGradient(ScentField::Home, homeAt, human.x, human.y);
           float homeBias = 1.0f - (static_cast<float>(human.wanderlust) / 255.0f);
-          steer = steer + NormalizeOrZero(g) * (0.55f * homeBias);
+          steer = steer + g * (0.55f * homeBias);
         }
       }
 
       if (human.goal == Goal::SeekFood) {
         auto foodAt = [&](int x, int y) { return world.FoodScentAt(x, y); };
-        Vec2 g = sampleFieldGradient(foodAt, human.x, human.y);
-        steer = steer + NormalizeOrZero(g) * 0.25f;
+        Vec2 g = cachedGradient(ScentField::Food, foodAt, human.x, human.y);
+        steer = steer + g * 0.25f;
       }
 
       if (hasTarget) {
@@ -1810,8 +2083,7 @@ void HumanManager::UpdateTick(World& world, SettlementManager& settlements, Rand
                    kBaseMaxActiveArrows, kHardMaxActiveArrows);
 
     auto indexForId = [&](int id) -> int {
-      if (id <= 0 || id >= static_cast<int>(humanIdToIndex_.size())) return -1;
-      int idx = humanIdToIndex_[id];
+      int idx = IndexForId(id);
       if (idx < 0 || idx >= static_cast<int>(humans_.size())) return -1;
       return idx;
     };
@@ -2003,8 +2275,7 @@ void HumanManager::MarkDeadByIndex(int index, int day, DeathReason reason) {
   if (index < 0 || index >= static_cast<int>(humans_.size())) return;
   Human& human = humans_[index];
   if (!human.alive) return;
-  RecordDeath(human.id, day, reason);
-  human.alive = false;
+  KillHuman(human, day, reason);
 }
 
 void HumanManager::RecordWarDeaths(int count) {
@@ -2017,6 +2288,7 @@ void HumanManager::UpdateDailyCoarse(World& world, SettlementManager& settlement
                                      int& deathsToday) {
   if (macroActive_) return;
   CrashContextSetStage("Humans::UpdateDailyCoarse begin");
+  FUNSIM_PROFILE_ZONE("Humans::UpdateDailyCoarse");
   CrashContextSetPopulation(static_cast<int>(humans_.size()));
   currentDay_ = dayCount;
   birthsToday = 0;
@@ -2026,43 +2298,20 @@ void HumanManager::UpdateDailyCoarse(World& world, SettlementManager& settlement
   const int w = world.width();
   const int h = world.height();
 
+  // The census normally comes from SettlementManager's assignment sweep earlier in the day;
+  // take it here only when that did not happen or humans changed since.
   EnsureCrowdGrids(w, h);
-  crowdGeneration_++;
-  if (crowdGeneration_ == 0) {
-    std::fill(popStampByTile_.begin(), popStampByTile_.end(), 0u);
-    std::fill(adultMaleStampByTile_.begin(), adultMaleStampByTile_.end(), 0u);
-    crowdGeneration_ = 1;
-  }
-
-  CrashContextSetStage("Humans::UpdateDailyCoarse count");
-  for (const auto& human : humans_) {
-    if (!human.alive) continue;
-    if (static_cast<unsigned>(human.x) >= static_cast<unsigned>(w) ||
-        static_cast<unsigned>(human.y) >= static_cast<unsigned>(h)) {
-      continue;
-    }
-    const int idx = human.y * w + human.x;
-    if (popStampByTile_[static_cast<size_t>(idx)] != crowdGeneration_) {
-      popStampByTile_[static_cast<size_t>(idx)] = crowdGeneration_;
-      popCountByTile_[static_cast<size_t>(idx)] = 0;
-    }
-    popCountByTile_[static_cast<size_t>(idx)]++;
-
-    if (!human.female && human.ageDays >= Human::kAdultAgeDays) {
-      if (adultMaleStampByTile_[static_cast<size_t>(idx)] != crowdGeneration_) {
-        adultMaleStampByTile_[static_cast<size_t>(idx)] = crowdGeneration_;
-        adultMaleCountByTile_[static_cast<size_t>(idx)] = 0;
-        adultMaleSampleIdByTile_[static_cast<size_t>(idx)] = -1;
-      }
-      int count = ++adultMaleCountByTile_[static_cast<size_t>(idx)];
-      int currentSample = adultMaleSampleIdByTile_[static_cast<size_t>(idx)];
-      if (currentSample == -1 || rng.RangeInt(0, count - 1) == 0) {
-        adultMaleSampleIdByTile_[static_cast<size_t>(idx)] = human.id;
-      }
+  if (dailyCensusGeneration_ != crowdGeneration_) {
+    CrashContextSetStage("Humans::UpdateDailyCoarse count");
+    BeginDailyCensus(w, h);
+    for (const auto& human : humans_) {
+      if (human.alive) CountForDailyCensus(human);
     }
   }
+  dailyCensusGeneration_ = 0;
 
   newborns_.clear();
+  std::fill(eldestByFaction_.begin(), eldestByFaction_.end(), EldestMember{});
 
   CrashContextSetStage("Humans::UpdateDailyCoarse loop");
   for (auto& human : humans_) {
@@ -2123,8 +2372,7 @@ void HumanManager::UpdateDailyCoarse(World& world, SettlementManager& settlement
         }
         human.health = std::max(0, human.health - damage);
         if (human.health <= 0) {
-          RecordDeath(human.id, dayCount, DeathReason::Starvation);
-          human.alive = false;
+          KillHuman(human, dayCount, DeathReason::Starvation);
           deathsToday++;
           break;
         }
@@ -2278,42 +2526,35 @@ void HumanManager::UpdateDailyCoarse(World& world, SettlementManager& settlement
     }
 
     if (RollOldAgeDeathWindow(rng, ageDaysStart, dayDelta, human.legendary)) {
-      RecordDeath(human.id, dayCount, DeathReason::OldAge);
-      human.alive = false;
+      KillHuman(human, dayCount, DeathReason::OldAge);
       deathsToday++;
       continue;
     }
+    NoteEldest(settlement, human);
   }
 
-  if (!newborns_.empty()) {
-    humans_.insert(humans_.end(), newborns_.begin(), newborns_.end());
-  }
-
-  size_t write = 0;
-  for (size_t read = 0; read < humans_.size(); ++read) {
-    if (!humans_[read].alive) continue;
-    if (write != read) {
-      humans_[write] = humans_[read];
-    }
-    write++;
+  RemoveDeadHumans();
+  for (const Human& baby : newborns_) {
+    slotIndex_[static_cast<size_t>(SlotFromId(baby.id))] = static_cast<int>(humans_.size());
+    humans_.push_back(baby);
+    if (baby.legendary) legendaryIds_.push_back(baby.id);
+    if (baby.settlementId != -1) NoteEldest(settlements.Get(baby.settlementId), baby);
   }
-  humans_.resize(write);
-
-  RebuildIdMap();
 }
 
 void HumanManager::EnterMacro(SettlementManager& settlements) {
   if (macroActive_) return;
+  if (MacroExitPending()) StepExitMacro(settlements, 0);
   macroActive_ = true;
   arrows_.clear();
 
   auto& list = settlements.SettlementsMutable();
+  MacroCohorts& pools = settlements.MacroPoolsMutable();
   for (auto& settlement : list) {
-    settlement.ClearMacroPools();
+    settlements.ClearMacroPools(settlement);
+    settlements.ClearTasks(settlement);
   }
-  std::fill(std::begin(macroFallbackM_), std::end(macroFallbackM_), 0);
-  std::fill(std::begin(macroFallbackF_), std::end(macroFallbackF_), 0);
-  macroFallbackBirthAccum_ = 0.0f;
+  macroFallback_.Clear(0);
   macroHasFallback_ = false;
   long long fallbackSumX = 0;
   long long fallbackSumY = 0;
@@ -2322,37 +2563,19 @@ void HumanManager::EnterMacro(SettlementManager& settlements) {
   for (const auto& human : humans_) {
     int bin = AgeBinIndex(human.ageDays);
     if (human.settlementId != -1) {
-      Settlement* settlement = settlements.GetMutable(human.settlementId);
+      const Settlement* settlement = settlements.Get(human.settlementId);
       if (!settlement) continue;
-      if (human.female) {
-        settlement->macroPopF[bin]++;
-      } else {
-        settlement->macroPopM[bin]++;
-      }
+      const size_t slot = static_cast<size_t>(settlement - list.data());
+      (human.female ? pools.female : pools.male)[bin][slot]++;
     } else if (!list.empty()) {
-      int bestIdx = -1;
       int bestDist = std::numeric_limits<int>::max();
-      for (int i = 0; i < static_cast<int>(list.size()); ++i) {
-        const Settlement& settlement = list[i];
-        int dist = Manhattan(human.x, human.y, settlement.centerX, settlement.centerY);
-        if (dist < bestDist) {
-          bestDist = dist;
-          bestIdx = i;
-        }
-      }
+      const int bestIdx =
+          settlements.Index().Nearest(human.x, human.y, DistanceMetric::Manhattan, bestDist);
       if (bestIdx >= 0) {
-        if (human.female) {
-          list[bestIdx].macroPopF[bin]++;
-        } else {
-          list[bestIdx].macroPopM[bin]++;
-        }
+        (human.female ? pools.female : pools.male)[bin][static_cast<size_t>(bestIdx)]++;
       }
     } else {
-      if (human.female) {
-        macroFallbackF_[bin]++;
-      } else {
-        macroFallbackM_[bin]++;
-      }
+      (human.female ? macroFallback_.female : macroFallback_.male)[bin][0]++;
       fallbackSumX += human.x;
       fallbackSumY += human.y;
       fallbackCount++;
@@ -2364,262 +2587,499 @@ void HumanManager::EnterMacro(SettlementManager& settlements) {
     macroFallbackY_ = static_cast<int>(fallbackSumY / fallbackCount);
   }
 
+  for (const auto& human : humans_) {
+    if (human.alive) ReleaseHumanId(human.id);
+  }
   humans_.clear();
   newborns_.clear();
-  humanIdToIndex_.clear();
+  deadIndices_.clear();
+  eldestByFaction_.clear();
+  legendaryIds_.clear();
+  dailyCensusGeneration_ = 0;
 }
 
 void HumanManager::ExitMacro(SettlementManager& settlements, Random& rng) {
+  BeginExitMacro(settlements, rng);
+  StepExitMacro(settlements, 0);
+}
+
+void HumanManager::BeginExitMacro(SettlementManager& settlements, Random& rng) {
   if (!macroActive_) return;
   macroActive_ = false;
   arrows_.clear();
 
   humans_.clear();
   newborns_.clear();
-  nextId_ = 1;
-
-  for (auto& settlement : settlements.SettlementsMutable()) {
-    int total = settlement.MacroTotal();
-    if (total <= 0) {
-      settlement.ClearMacroPools();
-      continue;
-    }
-
+  deadIndices_.clear();
+  eldestByFaction_.clear();
+  legendaryIds_.clear();
+  dailyCensusGeneration_ = 0;
+  rehydrateJobs_.clear();
+  rehydrateIds_.clear();
+  rehydrateCursor_ = 0;
+
+  // Ids and RNG streams are fixed here so the result does not depend on how the work is split
+  // across frames or threads.
+  const uint64_t seed = (static_cast<uint64_t>(rng.NextU32()) << 32) | rng.NextU32();
+  auto pushJobs = [&](int settlementId, int x, int y, const MacroCohorts& pools, int slot) {
     for (int bin = 0; bin < kMacroBins; ++bin) {
-      for (int i = 0; i < settlement.macroPopM[bin]; ++i) {
-        int ageDays = 0;
-        for (int b = 0; b < bin; ++b) {
-          ageDays += kMacroBinDays[b];
-        }
-        ageDays += rng.RangeInt(0, kMacroBinDays[bin] - 1);
-        Human human = CreateHuman(settlement.centerX, settlement.centerY, false, rng, ageDays);
-        human.settlementId = settlement.id;
-        human.homeX = settlement.centerX;
-        human.homeY = settlement.centerY;
-        humans_.push_back(human);
-      }
-      for (int i = 0; i < settlement.macroPopF[bin]; ++i) {
-        int ageDays = 0;
-        for (int b = 0; b < bin; ++b) {
-          ageDays += kMacroBinDays[b];
+      for (int sex = 0; sex < 2; ++sex) {
+        int remaining = ((sex == 0) ? pools.male : pools.female)[bin][static_cast<size_t>(slot)];
+        uint32_t chunk = 0;
+        while (remaining > 0) {
+          RehydrateJob job;
+          job.settlementId = settlementId;
+          job.x = x;
+          job.y = y;
+          job.bin = bin;
+          job.female = (sex == 1);
+          job.idOffset = static_cast<int>(rehydrateIds_.size());
+          job.count = std::min(remaining, kRehydrateChunk);
+          job.rngKey = RngKey(seed, static_cast<uint32_t>(settlementId),
+                              (static_cast<uint64_t>(bin * 2 + sex) << 32) | chunk++,
+                              RngPurpose::Rehydrate);
+          for (int i = 0; i < job.count; ++i) rehydrateIds_.push_back(AcquireHumanId());
+          remaining -= job.count;
+          rehydrateJobs_.push_back(job);
         }
-        ageDays += rng.RangeInt(0, kMacroBinDays[bin] - 1);
-        Human human = CreateHuman(settlement.centerX, settlement.centerY, true, rng, ageDays);
-        human.settlementId = settlement.id;
-        human.homeX = settlement.centerX;
-        human.homeY = settlement.centerY;
-        humans_.push_back(human);
       }
     }
-    settlement.ClearMacroPools();
-  }
+  };
 
+  const MacroCohorts& pools = settlements.MacroPools();
+  const auto& list = settlements.Settlements();
+  for (int i = 0; i < static_cast<int>(list.size()); ++i) {
+    const Settlement& settlement = list[static_cast<size_t>(i)];
+    if (pools.Total(i) <= 0) continue;
+    pushJobs(settlement.id, settlement.centerX, settlement.centerY, pools, i);
+  }
   if (macroHasFallback_) {
-    for (int bin = 0; bin < kMacroBins; ++bin) {
-      for (int i = 0; i < macroFallbackM_[bin]; ++i) {
-        int ageDays = 0;
-        for (int b = 0; b < bin; ++b) {
-          ageDays += kMacroBinDays[b];
-        }
-        ageDays += rng.RangeInt(0, kMacroBinDays[bin] - 1);
-        Human human = CreateHuman(macroFallbackX_, macroFallbackY_, false, rng, ageDays);
-        humans_.push_back(human);
-      }
-      for (int i = 0; i < macroFallbackF_[bin]; ++i) {
-        int ageDays = 0;
-        for (int b = 0; b < bin; ++b) {
-          ageDays += kMacroBinDays[b];
-        }
-        ageDays += rng.RangeInt(0, kMacroBinDays[bin] - 1);
-        Human human = CreateHuman(macroFallbackX_, macroFallbackY_, true, rng, ageDays);
-        humans_.push_back(human);
-      }
+    pushJobs(-1, macroFallbackX_, macroFallbackY_, macroFallback_, 0);
+  }
+  for (auto& settlement : settlements.SettlementsMutable()) {
+    if (settlements.MacroTotal(settlement) <= 0) {
+      settlements.ClearMacroPools(settlement);
+      settlements.ClearTasks(settlement);
     }
   }
-  std::fill(std::begin(macroFallbackM_), std::end(macroFallbackM_), 0);
-  std::fill(std::begin(macroFallbackF_), std::end(macroFallbackF_), 0);
-  macroFallbackBirthAccum_ = 0.0f;
+  macroFallback_.Clear(0);
   macroHasFallback_ = false;
 
-  RebuildIdMap();
+  humans_.reserve(rehydrateIds_.size());
+}
+
+bool HumanManager::StepExitMacro(SettlementManager& settlements, int maxHumans) {
+  if (rehydrateCursor_ >= rehydrateJobs_.size()) {
+    rehydrateJobs_.clear();
+    rehydrateIds_.clear();
+    rehydrateCursor_ = 0;
+    return true;
+  }
+  CrashContextSetStage("Humans::StepExitMacro");
+  FUNSIM_PROFILE_ZONE("Humans::StepExitMacro");
+
+  // Whole settlements only, so a settlement is never split between the two models.
+  size_t begin = rehydrateCursor_;
+  size_t end = begin;
+  int batchCount = 0;
+  while (end < rehydrateJobs_.size()) {
+    const int settlementId = rehydrateJobs_[end].settlementId;
+    size_t groupEnd = end;
+    int groupCount = 0;
+    while (groupEnd < rehydrateJobs_.size() &&
+           rehydrateJobs_[groupEnd].settlementId == settlementId) {
+      groupCount += rehydrateJobs_[groupEnd].count;
+      groupEnd++;
+    }
+    if (maxHumans > 0 && batchCount > 0 && batchCount + groupCount > maxHumans) break;
+    batchCount += groupCount;
+    end = groupEnd;
+  }
+
+  int binStart[kMacroBins] = {};
+  for (int bin = 1; bin < kMacroBins; ++bin) {
+    binStart[bin] = binStart[bin - 1] + kMacroBinDays[bin - 1];
+  }
+
+  const int firstOffset = rehydrateJobs_[begin].idOffset;
+  const size_t base = humans_.size();
+  humans_.resize(base + static_cast<size_t>(batchCount));
+
+  auto runJob = [&](const RehydrateJob& job) {
+    Random jobRng = Random::FromKey(job.rngKey);
+    Human* out = humans_.data() + base + static_cast<size_t>(job.idOffset - firstOffset);
+    const int span = kMacroBinDays[job.bin];
+    for (int i = 0; i < job.count; ++i) {
+      int ageDays = binStart[job.bin] + jobRng.RangeInt(0, span - 1);
+      Human human = CreateHumanWithId(rehydrateIds_[static_cast<size_t>(job.idOffset + i)], job.x,
+                                      job.y, job.female, jobRng, ageDays);
+      if (job.settlementId != -1) {
+        human.settlementId = job.settlementId;
+        human.homeX = job.x;
+        human.homeY = job.y;
+      }
+      out[i] = human;
+    }
+  };
+
+  const int jobCount = static_cast<int>(end - begin);
+  int threadCount = workerThreads_;
+  if (threadCount <= 0) {
+    threadCount = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1,
+                             kRehydrateMaxThreads);
+  }
+  if (batchCount < kRehydrateChunk * 2) threadCount = 1;
+  threadCount = std::min(threadCount, jobCount);
+  if (threadCount <= 1) {
+    for (size_t j = begin; j < end; ++j) runJob(rehydrateJobs_[j]);
+  } else {
+    std::atomic<int> nextJob{0};
+    auto worker = [&]() {
+      for (int j = nextJob.fetch_add(1); j < jobCount; j = nextJob.fetch_add(1)) {
+        runJob(rehydrateJobs_[begin + static_cast<size_t>(j)]);
+      }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(threadCount - 1));
+    for (int t = 1; t < threadCount; ++t) workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers) thread.join();
+  }
+
+  for (size_t j = begin; j < end; ++j) {
+    const RehydrateJob& job = rehydrateJobs_[j];
+    if (job.settlementId == -1) continue;
+    if (j + 1 < end && rehydrateJobs_[j + 1].settlementId == job.settlementId) continue;
+    Settlement* settlement = settlements.GetMutable(job.settlementId);
+    if (settlement) {
+      settlements.ClearMacroPools(*settlement);
+      settlements.ClearTasks(*settlement);
+    }
+  }
+
+  for (size_t i = base; i < humans_.size(); ++i) {
+    slotIndex_[static_cast<size_t>(SlotFromId(humans_[i].id))] = static_cast<int>(i);
+    if (humans_[i].legendary) legendaryIds_.push_back(humans_[i].id);
+  }
+  dailyCensusGeneration_ = 0;
+  rehydrateCursor_ = end;
+  if (rehydrateCursor_ < rehydrateJobs_.size()) return false;
+  rehydrateJobs_.clear();
+  rehydrateIds_.clear();
+  rehydrateCursor_ = 0;
+  return true;
+}
+
+int HumanManager::PendingRehydrateCount() const {
+  int total = 0;
+  for (size_t j = rehydrateCursor_; j < rehydrateJobs_.size(); ++j) {
+    total += rehydrateJobs_[j].count;
+  }
+  return total;
 }
 
 void HumanManager::AdvanceMacro(World& world, SettlementManager& settlements, Random& rng,
                                 int days, int& birthsToday, int& deathsToday) {
   if (!macroActive_) return;
   if (days <= 0) return;
+  FUNSIM_PROFILE_ZONE("Humans::AdvanceMacro");
+  // The cohort kernels draw from counters under one key per step, so a lane's numbers do not
+  // depend on the other lanes.
+  const uint64_t seed = (static_cast<uint64_t>(rng.NextU32()) << 32) | rng.NextU32();
+  const float daysF = static_cast<float>(days);
 
-  for (int day = 0; day < days; ++day) {
-    settlements.RefreshBuildingStats(world);
-    for (auto& settlement : settlements.SettlementsMutable()) {
-      int popTotal = settlement.MacroTotal();
-      settlement.population = popTotal;
-
-      if (settlement.farms > 0) {
-        float dailyFarmFood =
-            static_cast<float>(settlement.farms) *
-            (static_cast<float>(FarmYieldForTier(settlement.techTier)) / 3.0f);
-        settlement.macroFarmFoodAccum += dailyFarmFood;
-        int farmFood = static_cast<int>(settlement.macroFarmFoodAccum);
-        if (farmFood > 0) {
-          settlement.stockFood += farmFood;
-          settlement.macroFarmFoodAccum -= static_cast<float>(farmFood);
-        }
+  settlements.RefreshBuildingStats(world);
+  auto& list = settlements.SettlementsMutable();
+  MacroCohorts& pools = settlements.MacroPoolsMutable();
+  const size_t count = list.size();
+  FrameArena& arena = SimFrameArena();
+  std::pmr::vector<float> birthScale(count, 0.0f, &arena);
+  std::pmr::vector<int> births(count, 0, &arena);
+  std::pmr::vector<float> edgeDeathRate(count, 0.0f, &arena);
+  std::pmr::vector<float> allDeathRate(count, 0.0f, &arena);
+
+  // Food, wood and the birth multiplier come from the start-of-step population.
+  for (size_t i = 0; i < count; ++i) {
+    Settlement& settlement = list[i];
+    int popTotal = pools.Total(static_cast<int>(i));
+    settlement.population = popTotal;
+
+    if (settlement.farms > 0) {
+      float dailyFarmFood =
+          static_cast<float>(settlement.farms) *
+          (static_cast<float>(FarmYieldForTier(settlement.techTier)) / 3.0f);
+      pools.farmFoodAccum[i] += dailyFarmFood * daysF;
+      int farmFood = static_cast<int>(pools.farmFoodAccum[i]);
+      if (farmFood > 0) {
+        settlement.stockFood += farmFood;
+        pools.farmFoodAccum[i] -= static_cast<float>(farmFood);
       }
+    }
 
-      if (popTotal > 0) {
-        settlement.stockFood += popTotal / 5;
-        settlement.stockWood += std::max(1, popTotal / 6);
-      }
+    if (popTotal > 0) {
+      settlement.stockFood += (popTotal / 5) * days;
+      settlement.stockWood += std::max(1, popTotal / 6) * days;
+    }
 
-      float dailyNeed = (kFoodIntervalDays > 0)
-                            ? (static_cast<float>(popTotal) / static_cast<float>(kFoodIntervalDays))
-                            : static_cast<float>(popTotal);
-      settlement.macroFoodNeedAccum += dailyNeed;
-      int need = static_cast<int>(settlement.macroFoodNeedAccum);
-      if (need > 0) {
-        settlement.macroFoodNeedAccum -= static_cast<float>(need);
-        if (settlement.stockFood > 0) {
-          settlement.stockFood = std::max(0, settlement.stockFood - need);
-        }
-      }
+    float dailyNeed = (kFoodIntervalDays > 0)
+                          ? (static_cast<float>(popTotal) / static_cast<float>(kFoodIntervalDays))
+                          : static_cast<float>(popTotal);
+    pools.foodNeedAccum[i] += dailyNeed * daysF;
+    int need = static_cast<int>(pools.foodNeedAccum[i]);
+    if (need > 0) {
+      pools.foodNeedAccum[i] -= static_cast<float>(need);
+      settlement.stockFood = std::max(0, settlement.stockFood - need);
+    }
 
-      float foodFactor = 0.0f;
-      if (popTotal > 0) {
-        foodFactor = static_cast<float>(settlement.stockFood) /
-                     static_cast<float>(std::max(1, popTotal * kMateFoodReservePerPop));
-        if (foodFactor > 1.0f) foodFactor = 1.0f;
-      }
-
-      float waterFactor = 1.0f;
-
-      float housingFactor = (settlement.housingCap > popTotal) ? 1.0f : 0.0f;
-
-      int fertileFemales = settlement.macroPopF[3];
-      int adultMales = settlement.macroPopM[3] + settlement.macroPopM[4];
-      int mates = std::min(fertileFemales, adultMales);
-      float expectedBirths =
-          static_cast<float>(mates) * kMacroBirthRatePerDay * foodFactor * waterFactor * housingFactor;
-      settlement.macroBirthAccum += expectedBirths;
-      int births = static_cast<int>(settlement.macroBirthAccum);
-      settlement.macroBirthAccum -= static_cast<float>(births);
-      if (rng.Chance(settlement.macroBirthAccum)) {
-        births++;
-        settlement.macroBirthAccum = 0.0f;
-      }
-
-      int femaleBirths = births / 2;
-      int maleBirths = births - femaleBirths;
-      if (rng.Chance(0.5f)) {
-        std::swap(femaleBirths, maleBirths);
-      }
-      settlement.macroPopF[0] += femaleBirths;
-      settlement.macroPopM[0] += maleBirths;
-      birthsToday += births;
-      if (births > 0 && settlement.stockFood > 0) {
-        settlement.stockFood = std::max(0, settlement.stockFood - births * 2);
-      }
-
-      float fireFactor = static_cast<float>(world.FireRiskAt(settlement.centerX,
-                                                             settlement.centerY)) /
-                         60000.0f;
-      float starvationRate =
-          (allowStarvationDeath_ && settlement.stockFood == 0) ? 0.002f : 0.0f;
-      for (int bin = 0; bin < kMacroBins; ++bin) {
-        int baseDeathsM = ApplyRate(settlement.macroPopM[bin], kMacroDeathRate[bin], rng);
-        int baseDeathsF = ApplyRate(settlement.macroPopF[bin], kMacroDeathRate[bin], rng);
-        int starveDeathsM = 0;
-        int starveDeathsF = 0;
-        int fireDeathsM = 0;
-        int fireDeathsF = 0;
-        if (starvationRate > 0.0f && (bin == 0 || bin == kMacroBins - 1)) {
-          starveDeathsM = ApplyRate(settlement.macroPopM[bin], starvationRate, rng);
-          starveDeathsF = ApplyRate(settlement.macroPopF[bin], starvationRate, rng);
-        }
-        if (fireFactor > 0.2f) {
-          float fireRate = fireFactor * 0.0008f;
-          fireDeathsM = ApplyRate(settlement.macroPopM[bin], fireRate, rng);
-          fireDeathsF = ApplyRate(settlement.macroPopF[bin], fireRate, rng);
-        }
+    float foodFactor = 0.0f;
+    if (popTotal > 0) {
+      foodFactor = static_cast<float>(settlement.stockFood) /
+                   static_cast<float>(std::max(1, popTotal * kMateFoodReservePerPop));
+      if (foodFactor > 1.0f) foodFactor = 1.0f;
+    }
+    float housingFactor = (settlement.housingCap > popTotal) ? 1.0f : 0.0f;
+    birthScale[i] = foodFactor * housingFactor;
+  }
 
-        settlement.macroPopM[bin] =
-            std::max(0, settlement.macroPopM[bin] - baseDeathsM - starveDeathsM - fireDeathsM);
-        settlement.macroPopF[bin] =
-            std::max(0, settlement.macroPopF[bin] - baseDeathsF - starveDeathsF - fireDeathsF);
-        deathsToday += baseDeathsM + baseDeathsF + starveDeathsM + starveDeathsF + fireDeathsM +
-                       fireDeathsF;
-        deathSummary_.macroNatural += baseDeathsM + baseDeathsF;
-        if (starvationRate > 0.0f && (bin == 0 || bin == kMacroBins - 1)) {
-          deathSummary_.macroStarvation += starveDeathsM + starveDeathsF;
-        }
-        if (fireFactor > 0.2f) {
-          deathSummary_.macroFire += fireDeathsM + fireDeathsF;
-        }
-      }
+  RollMacroBirths(pools, birthScale.data(), days, RngKey(seed, 0, 0, RngPurpose::Macro),
+                  births.data());
 
-      for (int bin = 0; bin < kMacroBins - 1; ++bin) {
-        int moveM = ApplyRate(settlement.macroPopM[bin], 1.0f / kMacroBinDays[bin], rng);
-        int moveF = ApplyRate(settlement.macroPopF[bin], 1.0f / kMacroBinDays[bin], rng);
-        settlement.macroPopM[bin] -= moveM;
-        settlement.macroPopF[bin] -= moveF;
-        settlement.macroPopM[bin + 1] += moveM;
-        settlement.macroPopF[bin + 1] += moveF;
-      }
+  for (size_t i = 0; i < count; ++i) {
+    Settlement& settlement = list[i];
+    if (births[i] > 0 && settlement.stockFood > 0) {
+      settlement.stockFood = std::max(0, settlement.stockFood - births[i] * 2);
+    }
+    float fireFactor = static_cast<float>(world.FireRiskAt(settlement.centerX,
+                                                           settlement.centerY)) /
+                       60000.0f;
+    edgeDeathRate[i] = (allowStarvationDeath_ && settlement.stockFood == 0) ? 0.002f : 0.0f;
+    allDeathRate[i] = (fireFactor > 0.2f) ? fireFactor * 0.0008f : 0.0f;
+  }
+
+  const MacroCohortDeaths deaths =
+      AdvanceMacroCohorts(pools, edgeDeathRate.data(), allDeathRate.data(), births.data(), days,
+                          RngKey(seed, 0, 1, RngPurpose::Macro));
+  for (size_t i = 0; i < count; ++i) {
+    Settlement& settlement = list[i];
+    settlement.population = pools.Total(static_cast<int>(i));
+    settlement.ageDays += days;
+    birthsToday += births[i];
+  }
+  deathsToday += deaths.natural + deaths.edge + deaths.all;
+  deathSummary_.macroNatural += deaths.natural;
+  deathSummary_.macroStarvation += deaths.edge;
+  deathSummary_.macroFire += deaths.all;
+
+  if (macroHasFallback_ && macroFallback_.Total(0) > 0) {
+    const float fallbackBirthScale = 0.1f;
+    const float fallbackEdgeRate = 0.0f;
+    const float fallbackAllRate = 0.0015f;
+    int fallbackBirths = 0;
+    RollMacroBirths(macroFallback_, &fallbackBirthScale, days,
+                    RngKey(seed, 1, 0, RngPurpose::Macro), &fallbackBirths);
+    const MacroCohortDeaths fallbackDeaths =
+        AdvanceMacroCohorts(macroFallback_, &fallbackEdgeRate, &fallbackAllRate,
+                            &fallbackBirths, days, RngKey(seed, 1, 1, RngPurpose::Macro));
+    const int lost = fallbackDeaths.natural + fallbackDeaths.edge + fallbackDeaths.all;
+    birthsToday += fallbackBirths;
+    deathsToday += lost;
+    deathSummary_.macroNatural += lost;
+  }
+}
 
-      settlement.population = settlement.MacroTotal();
-      settlement.ageDays++;
+// Each lane keeps the per-day rule: add the expected births to the carry, take the whole part,
+// then roll the fraction and clear the carry on a hit. Between hits the carry moves
+// deterministically, so a lane draws once per hit instead of once per day: the hit lands on the
+// first day the running product of (1 - carry) drops below the draw. Lanes run in blocks with
+// the day loop outside the flat lane loop; lane i's draws use counters i << 32 onwards.
+void HumanManager::RollMacroBirths(MacroCohorts& pools, const float* birthScale, int days,
+                                   uint64_t key, int* births) {
+  const size_t size = static_cast<size_t>(pools.Size());
+  const int* fertile = pools.female[3].data();
+  const int* youngMen = pools.male[3].data();
+  const int* olderMen = pools.male[4].data();
+  float* accum = pools.birthAccum.data();
+  for (size_t begin = 0; begin < size; begin += kMacroLaneBlock) {
+    const size_t count = std::min(kMacroLaneBlock, size - begin);
+    float expected[kMacroLaneBlock];
+    float carry[kMacroLaneBlock];
+    float survival[kMacroLaneBlock];
+    float threshold[kMacroLaneBlock];
+    int total[kMacroLaneBlock];
+    int hit[kMacroLaneBlock];
+    uint16_t hitLanes[kMacroLaneBlock];
+    uint64_t counter[kMacroLaneBlock];
+    for (size_t j = 0; j < count; ++j) {
+      const size_t i = begin + j;
+      const int mates = std::min(fertile[i], youngMen[i] + olderMen[i]);
+      expected[j] = static_cast<float>(mates) * kMacroBirthRatePerDay * birthScale[i];
+      carry[j] = accum[i];
+      survival[j] = 1.0f;
+      total[j] = 0;
+      counter[j] = static_cast<uint64_t>(i) << 32;
+      threshold[j] = RngFloat01(RngAt(key, counter[j]++));
+    }
+    for (int day = 0; day < days; ++day) {
+      int anyHit = 0;
+      for (size_t j = 0; j < count; ++j) {
+        float next = carry[j] + expected[j];
+        const int whole = static_cast<int>(next);
+        next -= static_cast<float>(whole);
+        const float kept = survival[j] * (1.0f - next);
+        hit[j] = (kept < threshold[j]) ? 1 : 0;
+        total[j] += whole + hit[j];
+        carry[j] = hit[j] ? 0.0f : next;
+        survival[j] = hit[j] ? 1.0f : kept;
+        anyHit |= hit[j];
+      }
+      if (!anyHit) continue;
+      size_t hits = 0;
+      for (size_t j = 0; j < count; ++j) {
+        hitLanes[hits] = static_cast<uint16_t>(j);
+        hits += static_cast<size_t>(hit[j]);
+      }
+      for (size_t h = 0; h < hits; ++h) {
+        const size_t j = hitLanes[h];
+        threshold[j] = RngFloat01(RngAt(key, counter[j]++));
+      }
     }
+    for (size_t j = 0; j < count; ++j) {
+      accum[begin + j] = carry[j];
+      births[begin + j] = total[j];
+    }
+  }
+}
 
-    if (macroHasFallback_) {
-      int popTotal = 0;
-      for (int bin = 0; bin < kMacroBins; ++bin) {
-        popTotal += macroFallbackM_[bin] + macroFallbackF_[bin];
+// Expected counts come from the cached base transition power; the extra rates scale the bins
+// they hit by (1 - rate)^days. Each sex's bins are then rounded by systematic sampling (one
+// offset per lane against the running sum), so bins and totals are unbiased and the survivors
+// never outnumber the people moved. Newborns join bin 0 after the flow.
+HumanManager::MacroCohortDeaths HumanManager::AdvanceMacroCohorts(
+    MacroCohorts& pools, const float* edgeDeathRate, const float* allDeathRate,
+    const int* births, int days, uint64_t key) {
+  if (macroBaseTransitionDays_ != days) {
+    double transition[kMacroBins][kMacroBins];
+    CohortTransitionPower(kMacroDeathRate, days, transition);
+    for (int to = 0; to < kMacroBins; ++to) {
+      for (int from = 0; from < kMacroBins; ++from) {
+        macroBaseTransition_[to][from] = static_cast<float>(transition[to][from]);
+      }
+    }
+    macroBaseTransitionDays_ = days;
+  }
+
+  const size_t size = static_cast<size_t>(pools.Size());
+  MacroCohortDeaths deaths;
+  for (size_t begin = 0; begin < size; begin += kMacroLaneBlock) {
+    const size_t count = std::min(kMacroLaneBlock, size - begin);
+    float edgeSurvival[kMacroLaneBlock];
+    float allSurvival[kMacroLaneBlock];
+    float naturalWeight[kMacroLaneBlock] = {};
+    float edgeWeight[kMacroLaneBlock] = {};
+    float allWeight[kMacroLaneBlock] = {};
+    float expected[kMacroBins][kMacroLaneBlock];
+    float running[kMacroLaneBlock];
+    uint64_t draw[kMacroLaneBlock];
+    int before[kMacroLaneBlock];
+    int placed[kMacroLaneBlock];
+    int lost[kMacroLaneBlock] = {};
+
+    // (1 - rate)^days by squaring; days is shared, so the lanes stay in step.
+    float edgeBase[kMacroLaneBlock];
+    float allBase[kMacroLaneBlock];
+    for (size_t j = 0; j < count; ++j) {
+      edgeBase[j] = 1.0f - edgeDeathRate[begin + j];
+      allBase[j] = 1.0f - allDeathRate[begin + j];
+      edgeSurvival[j] = 1.0f;
+      allSurvival[j] = 1.0f;
+    }
+    for (int n = days; n > 0; n >>= 1) {
+      const float take = (n & 1) ? 1.0f : 0.0f;
+      for (size_t j = 0; j < count; ++j) {
+        edgeSurvival[j] *= take * edgeBase[j] + (1.0f - take);
+        allSurvival[j] *= take * allBase[j] + (1.0f - take);
+        edgeBase[j] *= edgeBase[j];
+        allBase[j] *= allBase[j];
+      }
+    }
+    for (int bin = 0; bin < kMacroBins; ++bin) {
+      const int* male = pools.male[bin].data() + begin;
+      const int* female = pools.female[bin].data() + begin;
+      const float* edgeRate = edgeDeathRate + begin;
+      const float* allRate = allDeathRate + begin;
+      const float edge = (bin == 0 || bin == kMacroBins - 1) ? 1.0f : 0.0f;
+      for (size_t j = 0; j < count; ++j) {
+        const float people = static_cast<float>(male[j] + female[j]);
+        naturalWeight[j] += people * kMacroDeathRate[bin];
+        edgeWeight[j] += people * edge * edgeRate[j];
+        allWeight[j] += people * allRate[j];
       }
-      if (popTotal > 0) {
-        float foodFactor = 0.1f;
-        float waterFactor = 1.0f;
+    }
 
-        int fertileFemales = macroFallbackF_[3];
-        int adultMales = macroFallbackM_[3] + macroFallbackM_[4];
-        int mates = std::min(fertileFemales, adultMales);
-        float expectedBirths = static_cast<float>(mates) * kMacroBirthRatePerDay * foodFactor *
-                               waterFactor;
-        macroFallbackBirthAccum_ += expectedBirths;
-        int births = static_cast<int>(macroFallbackBirthAccum_);
-        macroFallbackBirthAccum_ -= static_cast<float>(births);
-        if (rng.Chance(macroFallbackBirthAccum_)) {
-          births++;
-          macroFallbackBirthAccum_ = 0.0f;
-        }
-        int femaleBirths = births / 2;
-        int maleBirths = births - femaleBirths;
-        if (rng.Chance(0.5f)) {
-          std::swap(femaleBirths, maleBirths);
+    // One draw per lane: its top 24 bits offset the male bins, the next 24 the female bins,
+    // and the low bit picks which sex gets the odd newborn.
+    for (size_t j = 0; j < count; ++j) draw[j] = RngAt(key, begin + j);
+
+    for (int sex = 0; sex < 2; ++sex) {
+      std::vector<int>* bins = (sex == 0) ? pools.male : pools.female;
+      const int offsetShift = (sex == 0) ? 0 : 24;
+      for (size_t j = 0; j < count; ++j) before[j] = 0;
+      for (int to = 0; to < kMacroBins; ++to) {
+        float* out = expected[to];
+        const int* people = bins[to].data() + begin;
+        for (size_t j = 0; j < count; ++j) {
+          before[j] += people[j];
+          out[j] = 0.0f;
         }
-        macroFallbackF_[0] += femaleBirths;
-        macroFallbackM_[0] += maleBirths;
-        birthsToday += births;
-
-        for (int bin = 0; bin < kMacroBins; ++bin) {
-          int deathsM = ApplyRate(macroFallbackM_[bin], kMacroDeathRate[bin] + 0.0015f, rng);
-          int deathsF = ApplyRate(macroFallbackF_[bin], kMacroDeathRate[bin] + 0.0015f, rng);
-          macroFallbackM_[bin] = std::max(0, macroFallbackM_[bin] - deathsM);
-          macroFallbackF_[bin] = std::max(0, macroFallbackF_[bin] - deathsF);
-          deathsToday += deathsM + deathsF;
-          deathSummary_.macroNatural += deathsM + deathsF;
+        for (int from = 0; from <= to; ++from) {
+          const float share = macroBaseTransition_[to][from];
+          if (share == 0.0f) continue;
+          const int* source = bins[from].data() + begin;
+          for (size_t j = 0; j < count; ++j) out[j] += share * static_cast<float>(source[j]);
         }
+      }
 
-        for (int bin = 0; bin < kMacroBins - 1; ++bin) {
-          int moveM = ApplyRate(macroFallbackM_[bin], 1.0f / kMacroBinDays[bin], rng);
-          int moveF = ApplyRate(macroFallbackF_[bin], 1.0f / kMacroBinDays[bin], rng);
-          macroFallbackM_[bin] -= moveM;
-          macroFallbackF_[bin] -= moveF;
-          macroFallbackM_[bin + 1] += moveM;
-          macroFallbackF_[bin + 1] += moveF;
+      for (size_t j = 0; j < count; ++j) {
+        running[j] = RngFloat01(draw[j] << offsetShift);
+        placed[j] = 0;
+      }
+      for (int to = 0; to < kMacroBins; ++to) {
+        const float* in = expected[to];
+        const bool edge = (to == 0 || to == kMacroBins - 1);
+        int* people = bins[to].data() + begin;
+        for (size_t j = 0; j < count; ++j) {
+          running[j] += in[j] * allSurvival[j] * (edge ? edgeSurvival[j] : 1.0f);
+          // running starts at the offset and never drops, so truncation is floor.
+          const int upTo = std::min(before[j], static_cast<int>(running[j]));
+          people[j] = std::max(0, upTo - placed[j]);
+          placed[j] += people[j];
         }
       }
+      for (size_t j = 0; j < count; ++j) lost[j] += before[j] - placed[j];
+    }
+
+    int* newbornMale = pools.male[0].data() + begin;
+    int* newbornFemale = pools.female[0].data() + begin;
+    for (size_t j = 0; j < count; ++j) {
+      const int half = births[begin + j] / 2;
+      const int rest = births[begin + j] - half;
+      const bool swap = (draw[j] & 1) != 0;
+      newbornFemale[j] += swap ? rest : half;
+      newbornMale[j] += swap ? half : rest;
+    }
+
+    for (size_t j = 0; j < count; ++j) {
+      const float weightTotal = naturalWeight[j] + edgeWeight[j] + allWeight[j];
+      // Empty lanes have no weight and no deaths.
+      const float share = static_cast<float>(lost[j]) / std::max(weightTotal, 1e-30f);
+      const int edge = static_cast<int>(edgeWeight[j] * share);
+      const int all = static_cast<int>(allWeight[j] * share);
+      deaths.edge += edge;
+      deaths.all += all;
+      deaths.natural += lost[j] - edge - all;
     }
   }
+  return deaths;
 }
 
 void HumanManager::UpdateAnimation(float dt) {
@@ -2644,15 +3104,100 @@ int HumanManager::CountAlive() const {
 }
 
 int HumanManager::MacroPopulation(const SettlementManager& settlements) const {
-  if (!macroActive_) return CountAlive();
+  if (!macroActive_) return CountAlive() + PendingRehydrateCount();
+  const MacroCohorts& pools = settlements.MacroPools();
   int total = 0;
-  for (const auto& settlement : settlements.Settlements()) {
-    total += settlement.MacroTotal();
-  }
-  if (macroHasFallback_) {
-    for (int i = 0; i < 6; ++i) {
-      total += macroFallbackM_[i] + macroFallbackF_[i];
-    }
-  }
+  for (int i = 0; i < pools.Size(); ++i) total += pools.Total(i);
+  if (macroHasFallback_) total += macroFallback_.Total(0);
   return total;
 }
+
+uint64_t HumanManager::StateHash() const {
+  StateHasher hasher;
+  hasher.Add(humans_.size());
+  for (const Human& human : humans_) {
+    hasher.Add(human.id);
+    hasher.Add(human.female);
+    hasher.Add(human.ageDays);
+    hasher.Add(human.x);
+    hasher.Add(human.y);
+    hasher.Add(human.px);
+    hasher.Add(human.py);
+    hasher.Add(human.vx);
+    hasher.Add(human.vy);
+    hasher.Add(human.personalOffsetX);
+    hasher.Add(human.personalOffsetY);
+    hasher.Add(human.alive);
+    hasher.Add(human.pregnant);
+    hasher.Add(human.gestationDays);
+    hasher.Add(human.nutrition);
+    hasher.Add(human.nutritionMonthAccumulator);
+    hasher.Add(human.maxHealth);
+    hasher.Add(human.health);
+    hasher.Add(human.moving);
+    hasher.Add(human.goal);
+    hasher.Add(human.role);
+    hasher.Add(human.targetX);
+    hasher.Add(human.targetY);
+    hasher.Add(human.homeX);
+    hasher.Add(human.homeY);
+    hasher.Add(human.lastFoodX);
+    hasher.Add(human.lastFoodY);
+    hasher.Add(human.rethinkCooldownTicks);
+    hasher.Add(human.mateCooldownDays);
+    hasher.Add(human.settlementId);
+    hasher.Add(human.bravery);
+    hasher.Add(human.greed);
+    hasher.Add(human.wanderlust);
+    hasher.Add(human.traits);
+    hasher.Add(human.legendary);
+    hasher.Add(human.legendPower);
+    hasher.Add(human.parentIdMother);
+    hasher.Add(human.parentIdFather);
+    hasher.Add(human.moveAccum);
+    hasher.Add(human.blockedTicks);
+    hasher.Add(human.forceReplan);
+    hasher.Add(human.mateTargetId);
+    hasher.Add(human.hasTask);
+    hasher.Add(human.taskType);
+    hasher.Add(human.taskX);
+    hasher.Add(human.taskY);
+    hasher.Add(human.taskAmount);
+    hasher.Add(human.taskSettlementId);
+    hasher.Add(human.taskBuildType);
+    hasher.Add(human.carrying);
+    hasher.Add(human.carryFood);
+    hasher.Add(human.carryWood);
+    hasher.Add(human.armyState);
+    hasher.Add(human.warId);
+    hasher.Add(human.warTargetSettlementId);
+    hasher.Add(human.formationSlot);
+    hasher.Add(human.isGeneral);
+    hasher.Add(human.meleeCooldownSeconds);
+    hasher.Add(human.bowCooldownSeconds);
+    hasher.Add(human.bowTargetId);
+  }
+  hasher.Add(arrows_.size());
+  for (const ArrowProjectile& arrow : arrows_) {
+    hasher.Add(arrow.x);
+    hasher.Add(arrow.y);
+    hasher.Add(arrow.vx);
+    hasher.Add(arrow.vy);
+    hasher.Add(arrow.ttlSeconds);
+    hasher.Add(arrow.targetId);
+    hasher.Add(arrow.shooterFactionId);
+  }
+  hasher.Add(deathSummary_.starvation);
+  hasher.Add(deathSummary_.dehydration);
+  hasher.Add(deathSummary_.oldAge);
+  hasher.Add(deathSummary_.war);
+  hasher.Add(deathSummary_.macroNatural);
+  hasher.Add(deathSummary_.macroStarvation);
+  hasher.Add(deathSummary_.macroFire);
+  hasher.Add(thinkCursor_);
+  hasher.Add(macroActive_);
+  hasher.Add(rehydrateJobs_.size() - rehydrateCursor_);
+  macroFallback_.Hash(hasher, 0);
+  hasher.Add(macroHasFallback_);
+  return hasher.Digest();
+}
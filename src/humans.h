@@ -4,10 +4,13 @@
 #include <cstdint>
 #include <vector>
 
+#include "macro_cohorts.h"
 #include "util.h"
 #include "world.h"
 
+class DeathLogWriter;
 class SettlementManager;
+struct Settlement;
 enum class TaskType : uint8_t;
 
 enum class Goal : uint8_t { Wander, SeekFood, SeekMate, StayHome, FleeFire };
@@ -124,6 +127,12 @@ struct Human {
   int bowTargetId = -1;
 };
 
+// Oldest living member of one faction, as of the last coarse day.
+struct EldestMember {
+  int id = -1;
+  int ageDays = -1;
+};
+
 class HumanManager {
  public:
   HumanManager();
@@ -135,22 +144,48 @@ class HumanManager {
                          int dayDelta, int& birthsToday, int& deathsToday);
   void EnterMacro(SettlementManager& settlements);
   void ExitMacro(SettlementManager& settlements, Random& rng);
+  // Split exit: Begin snapshots the macro pools, Step rebuilds up to maxHumans (0 = all) per
+  // call and returns true once every settlement is back on the per-human model.
+  void BeginExitMacro(SettlementManager& settlements, Random& rng);
+  bool StepExitMacro(SettlementManager& settlements, int maxHumans);
+  bool MacroActive() const { return macroActive_; }
+  bool MacroExitPending() const { return rehydrateCursor_ < rehydrateJobs_.size(); }
+  // Advances food, births and every settlement's cohorts by days in one step, running the
+  // cohort kernels down the bin-major pools (transition-matrix powers for deaths and ageing).
   void AdvanceMacro(World& world, SettlementManager& settlements, Random& rng, int days,
                     int& birthsToday, int& deathsToday);
   int MacroPopulation(const SettlementManager& settlements) const;
   void UpdateAnimation(float dt);
   void MarkDeadByIndex(int index, int day, DeathReason reason);
   void RecordWarDeaths(int count);
+  // Daily crowd census, taken inside the settlement assignment sweep: Begin opens a new crowd
+  // generation and Count stamps one living human's tile and syncs its mate pool. The next
+  // UpdateDailyCoarse reuses it unless humans were added, killed or ticked in between.
+  void BeginDailyCensus(int w, int h);
+  void CountForDailyCensus(const Human& human);
   void SetAllowStarvationDeath(bool enabled) { allowStarvationDeath_ = enabled; }
+  void SetDeathLogSink(DeathLogWriter* sink) { deathLogSink_ = sink; }
+  // 0 picks a count from the hardware; used by the parallel passes (macro exit rehydration).
+  void SetWorkerThreads(int count) { workerThreads_ = (count > 0) ? count : 0; }
+  int WorkerThreads() const { return workerThreads_; }
 
   int CountAlive() const;
+  const Human* FindById(int id) const;
+  Human* FindByIdMutable(int id);
   const std::vector<Human>& Humans() const { return humans_; }
   std::vector<Human>& HumansMutable() { return humans_; }
   const std::vector<ArrowProjectile>& Arrows() const { return arrows_; }
-  const std::vector<DeathRecord>& DeathLog() const { return deathLog_; }
   const DeathSummary& GetDeathSummary() const { return deathSummary_; }
+  // Indexed by faction id; filled by the UpdateDailyCoarse sweep (ties go to the lower id).
+  const std::vector<EldestMember>& EldestByFaction() const { return eldestByFaction_; }
+  // Living legendary humans in the order they appeared.
+  const std::vector<int>& LegendaryIds() const { return legendaryIds_; }
+  // Hash of every human, arrow and macro pool; animation state is left out.
+  uint64_t StateHash() const;
 
  private:
+  friend struct BenchAccess;
+
   struct FlowFieldEntry {
     int targetX = 0;
     int targetY = 0;
@@ -165,17 +200,85 @@ class HumanManager {
     std::vector<int8_t> dirY;
   };
 
+  enum class ScentField : uint8_t { Fire, Home, Food, Count };
+
+  struct GradientCell {
+    uint32_t stamp = 0;
+    uint8_t mask = 0;
+    int8_t dirX[static_cast<int>(ScentField::Count)] = {};
+    int8_t dirY[static_cast<int>(ScentField::Count)] = {};
+  };
+
+  // Nearest food to a settlement center within the no-stock explore radius, refreshed daily.
+  struct ExploreFoodTarget {
+    int day = -1;
+    int centerX = 0;
+    int centerY = 0;
+    int x = 0;
+    int y = 0;
+    bool found = false;
+  };
+
+  struct RehydrateJob {
+    int settlementId = -1;
+    int x = 0;
+    int y = 0;
+    int bin = 0;
+    bool female = false;
+    int idOffset = 0;
+    int count = 0;
+    uint64_t rngKey = 0;
+  };
+
+  // Human ids are generational handles: the low bits pick a slot in slotIndex_ and the high
+  // bits must match that slot's generation, so ids of the dead go stale instead of aliasing.
+  // Generations never wrap: a slot whose generation reaches kHumanGenerationMax is retired, so
+  // every id is issued at most once per run and death-log ids stay unique.
+  static constexpr int kHumanSlotBits = 24;
+  static constexpr int kHumanSlotMask = (1 << kHumanSlotBits) - 1;
+  static constexpr int kHumanSlotLimit = kHumanSlotMask + 1;
+  static constexpr uint8_t kHumanGenerationMax = 127;
+  static int SlotFromId(int id) { return id & kHumanSlotMask; }
+
   Human CreateHuman(int x, int y, bool female, Random& rng, int ageDays);
+  static Human CreateHumanWithId(int id, int x, int y, bool female, Random& rng, int ageDays);
+  int PendingRehydrateCount() const;
+  struct MacroCohortDeaths {
+    int natural = 0;
+    int edge = 0;
+    int all = 0;
+  };
+  // Cohort kernels: one lane per pool slot, every per-slot array sized pools.Size(). Draws are
+  // counter-based under key, so results do not depend on how the lanes are split.
+  static void RollMacroBirths(MacroCohorts& pools, const float* birthScale, int days,
+                              uint64_t key, int* births);
+  // edgeDeathRate applies to the youngest and oldest bins, allDeathRate to every bin; both are
+  // daily rates on top of the base ones. Deaths are split by cause in proportion to the rates.
+  MacroCohortDeaths AdvanceMacroCohorts(MacroCohorts& pools, const float* edgeDeathRate,
+                                        const float* allDeathRate, const int* births, int days,
+                                        uint64_t key);
+  int AcquireHumanId();
+  void ReleaseHumanId(int id);
+  int IndexForId(int id) const;
+  void KillHuman(Human& human, int day, DeathReason reason);
+  int MatePoolAt(int x, int y) const;
+  int MatePoolFor(const Human& human) const;
+  void SyncMatePool(const Human& human);
+  void RemoveFromMatePool(int slot);
+  void RemoveDeadHumans();
+  void NoteEldest(const Settlement* settlement, const Human& human);
   void ReplanGoal(Human& human, const World& world, const SettlementManager& settlements,
                   Random& rng, int tickCount, int ticksPerDay);
+  void PickNoStockFoodExploreTarget(Human& human, const World& world,
+                                    const SettlementManager& settlements, int tickCount, int day);
   bool GetHumanById(int id, int& outX, int& outY) const;
-  int FindMateTargetId(const Human& human, const World& world, Random& rng) const;
+  int FindMateTargetId(const Human& human, Random& rng) const;
+  void UpdateArrows(SettlementManager& settlements, float tickSeconds);
   void UpdateMoveStep(Human& human, World& world, SettlementManager& settlements, Random& rng,
                       int tickCount, int ticksPerDay);
   const FlowFieldEntry* GetFlowField(const World& world, int targetX, int targetY, int radius,
                                      int tickCount, int& ioBuildBudget);
   static FlowFieldEntry BuildFlowField(const World& world, int targetX, int targetY, int radius);
-  void RebuildIdMap();
   void RecordDeath(int humanId, int day, DeathReason reason);
 
   static uint64_t PackCoord(int x, int y) {
@@ -185,20 +288,19 @@ class HumanManager {
 
   int PopCountAt(int x, int y) const;
   int AdultMaleCountAt(int x, int y) const;
-  int AdultMaleSampleIdAt(int x, int y) const;
   void EnsureCrowdGrids(int w, int h);
 
-  int nextId_ = 1;
   std::vector<Human> humans_;
   std::vector<ArrowProjectile> arrows_;
   int crowdGridW_ = 0;
   int crowdGridH_ = 0;
   uint32_t crowdGeneration_ = 1;
+  // crowdGeneration_ the daily census was taken in; 0 once it no longer matches humans_.
+  uint32_t dailyCensusGeneration_ = 0;
   std::vector<uint32_t> popStampByTile_;
   std::vector<int> popCountByTile_;
   std::vector<uint32_t> adultMaleStampByTile_;
   std::vector<int> adultMaleCountByTile_;
-  std::vector<int> adultMaleSampleIdByTile_;
   uint32_t soldierGridGeneration_ = 1;
   std::vector<uint32_t> soldierStampByTile_;
   std::vector<uint16_t> soldierCountByTile_;
@@ -207,21 +309,41 @@ class HumanManager {
   std::vector<uint32_t> unitStampByTile_;
   std::vector<uint16_t> unitCountByTile_;
   std::vector<int> unitSampleIdByTile_;
-  std::vector<int> humanIdToIndex_;
+  uint32_t gradientGeneration_ = 1;
+  std::vector<GradientCell> gradientCache_;
+  std::vector<int> slotIndex_;
+  std::vector<uint8_t> slotGeneration_;
+  std::vector<int> freeSlots_;
+  std::vector<int> deadIndices_;
+  // Eligible adult males by pool, one pool per square cell of tiles (row-major), settled or
+  // not. Members are ids; matePoolBySlot_/matePosBySlot_ allow O(1) removal.
+  int mateCellsX_ = 0;
+  std::vector<std::vector<int>> matePools_;
+  std::vector<int> matePoolBySlot_;
+  std::vector<int> matePosBySlot_;
   std::vector<FlowFieldEntry> flowFields_;
   std::vector<Human> newborns_;
-  std::vector<DeathRecord> deathLog_;
+  std::vector<EldestMember> eldestByFaction_;
+  std::vector<int> legendaryIds_;
+  std::vector<ExploreFoodTarget> exploreFoodCache_;
+  DeathLogWriter* deathLogSink_ = nullptr;
   DeathSummary deathSummary_;
   int thinkCursor_ = 0;
   int currentDay_ = 0;
   bool macroActive_ = false;
-  int macroFallbackM_[6] = {};
-  int macroFallbackF_[6] = {};
-  float macroFallbackBirthAccum_ = 0.0f;
+  std::vector<RehydrateJob> rehydrateJobs_;
+  std::vector<int> rehydrateIds_;
+  size_t rehydrateCursor_ = 0;
+  // Single slot for people with no settlement to join.
+  MacroCohorts macroFallback_;
   int macroFallbackX_ = 0;
   int macroFallbackY_ = 0;
   bool macroHasFallback_ = false;
+  // Expected cohort flow over macroBaseTransitionDays_ days at the base death rates.
+  int macroBaseTransitionDays_ = 0;
+  float macroBaseTransition_[MacroCohorts::kBins][MacroCohorts::kBins] = {};
   bool allowStarvationDeath_ = true;
+  int workerThreads_ = 0;
 };
 
 const char* DeathReasonName(DeathReason reason);
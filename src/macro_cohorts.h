@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "util.h"
+
+// Macro-mode population of many pools (one per settlement, indexed like SettlementManager's
+// settlement vector), stored bin-major: each sex and age bin is one contiguous array across all
+// slots, so the cohort kernels in HumanManager run straight down the lanes.
+struct MacroCohorts {
+  static constexpr int kBins = 6;
+
+  int Size() const { return static_cast<int>(birthAccum.size()); }
+  // New slots start empty; existing slots keep their counts.
+  void Resize(int count) {
+    const size_t size = static_cast<size_t>(count);
+    for (int bin = 0; bin < kBins; ++bin) {
+      male[bin].resize(size, 0);
+      female[bin].resize(size, 0);
+    }
+    birthAccum.resize(size, 0.0f);
+    farmFoodAccum.resize(size, 0.0f);
+    foodNeedAccum.resize(size, 0.0f);
+  }
+  void Clear(int slot) {
+    const size_t i = static_cast<size_t>(slot);
+    for (int bin = 0; bin < kBins; ++bin) {
+      male[bin][i] = 0;
+      female[bin][i] = 0;
+    }
+    birthAccum[i] = 0.0f;
+    farmFoodAccum[i] = 0.0f;
+    foodNeedAccum[i] = 0.0f;
+  }
+  int Total(int slot) const {
+    const size_t i = static_cast<size_t>(slot);
+    int total = 0;
+    for (int bin = 0; bin < kBins; ++bin) total += male[bin][i] + female[bin][i];
+    return total;
+  }
+  void Hash(StateHasher& hasher, int slot) const {
+    const size_t i = static_cast<size_t>(slot);
+    for (int bin = 0; bin < kBins; ++bin) {
+      hasher.Add(male[bin][i]);
+      hasher.Add(female[bin][i]);
+    }
+    hasher.Add(birthAccum[i]);
+    hasher.Add(farmFoodAccum[i]);
+    hasher.Add(foodNeedAccum[i]);
+  }
+
+  std::vector<int> male[kBins];
+  std::vector<int> female[kBins];
+  // Fractional carries of the daily birth, farm yield and food need rates.
+  std::vector<float> birthAccum;
+  std::vector<float> farmFoodAccum;
+  std::vector<float> foodNeedAccum;
+};
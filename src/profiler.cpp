@@ -0,0 +1,253 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+constexpr int kMaxZoneDepth = 32;
+
+struct ZoneHistory {
+  const char* name = nullptr;
+  std::string parent;
+  int depth = 0;
+  int callsLastFrame = 0;
+  double lastMs = 0.0;
+  uint64_t lastFrame = 0;
+  int head = 0;
+  int count = 0;
+  float samples[kProfilerStatSamples] = {};
+};
+
+// Off until asked for: a zone costs two clock reads and an event push, which every GUI frame
+// would otherwise pay.
+bool gEnabled = false;
+thread_local bool tRecording = false;
+thread_local int tDepth = 0;
+
+ProfileFrame gCurrent;
+std::vector<ProfileFrame> gHistory;
+uint64_t gFramesCompleted = 0;
+
+std::vector<ZoneHistory> gZones;
+std::unordered_map<std::string_view, int> gZoneIndex;
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int ZoneIndexFor(const char* name) {
+  auto it = gZoneIndex.find(std::string_view(name));
+  if (it != gZoneIndex.end()) return it->second;
+  const int index = static_cast<int>(gZones.size());
+  gZones.emplace_back();
+  gZones.back().name = name;
+  gZoneIndex.emplace(std::string_view(name), index);
+  return index;
+}
+
+void AccumulateStats(const ProfileFrame& frame) {
+  const char* parents[kMaxZoneDepth] = {};
+  std::vector<std::pair<int, double>> totals;
+  for (const ProfileEvent& event : frame.events) {
+    const int depth = std::clamp(event.depth, 0, kMaxZoneDepth - 1);
+    parents[depth] = event.name;
+    const int zoneIndex = ZoneIndexFor(event.name);
+    ZoneHistory& zone = gZones[static_cast<size_t>(zoneIndex)];
+    zone.depth = depth;
+    zone.parent = (depth > 0 && parents[depth - 1]) ? parents[depth - 1] : "";
+    const double ms = static_cast<double>(event.endNs - event.startNs) * 1e-6;
+    auto it = std::find_if(totals.begin(), totals.end(),
+                           [&](const auto& entry) { return entry.first == zoneIndex; });
+    if (it == totals.end()) {
+      totals.emplace_back(zoneIndex, ms);
+      zone.callsLastFrame = 1;
+    } else {
+      it->second += ms;
+      zone.callsLastFrame++;
+    }
+  }
+  for (const auto& [zoneIndex, ms] : totals) {
+    ZoneHistory& zone = gZones[static_cast<size_t>(zoneIndex)];
+    zone.lastMs = ms;
+    zone.lastFrame = frame.index;
+    zone.samples[zone.head] = static_cast<float>(ms);
+    zone.head = (zone.head + 1) % kProfilerStatSamples;
+    zone.count = std::min(zone.count + 1, kProfilerStatSamples);
+  }
+}
+
+double Percentile(std::vector<float>& values, double q) {
+  if (values.empty()) return 0.0;
+  const size_t k = static_cast<size_t>(q * static_cast<double>(values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(k), values.end());
+  return values[k];
+}
+
+void AppendJsonString(std::string& out, const char* text) {
+  out.push_back('"');
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') out.push_back('\\');
+    out.push_back(*c);
+  }
+  out.push_back('"');
+}
+
+void AppendTraceEvent(std::string& out, const char* name, int64_t startNs, int64_t endNs,
+                      int64_t originNs, bool& first) {
+  char buffer[96];
+  if (!first) out += ",\n";
+  first = false;
+  out += "{\"name\":";
+  AppendJsonString(out, name);
+  std::snprintf(buffer, sizeof(buffer), ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                static_cast<double>(startNs - originNs) * 1e-3,
+                static_cast<double>(std::max<int64_t>(0, endNs - startNs)) * 1e-3);
+  out += buffer;
+}
+}  // namespace
+
+void ProfilerSetEnabled(bool enabled) {
+  gEnabled = enabled;
+}
+
+bool ProfilerEnabled() {
+  return gEnabled;
+}
+
+void ProfilerBeginFrame() {
+  tRecording = gEnabled;
+  tDepth = 0;
+  gCurrent.events.clear();
+  gCurrent.index = gFramesCompleted + 1;
+  gCurrent.startNs = NowNs();
+  gCurrent.endNs = 0;
+}
+
+void ProfilerEndFrame() {
+  if (!tRecording) return;
+  tRecording = false;
+  gCurrent.endNs = NowNs();
+  for (ProfileEvent& event : gCurrent.events) {
+    if (event.endNs < event.startNs) event.endNs = gCurrent.endNs;
+  }
+  if (gHistory.empty()) gHistory.resize(kProfilerHistoryFrames);
+  ProfileFrame& slot = gHistory[static_cast<size_t>(gFramesCompleted % kProfilerHistoryFrames)];
+  std::swap(slot, gCurrent);
+  gFramesCompleted++;
+  AccumulateStats(slot);
+}
+
+int ProfilerBeginZone(const char* name) {
+  if (!tRecording) return -1;
+  ProfileEvent event;
+  event.name = name;
+  event.startNs = NowNs();
+  event.depth = tDepth++;
+  gCurrent.events.push_back(event);
+  return static_cast<int>(gCurrent.events.size()) - 1;
+}
+
+void ProfilerEndZone(int eventIndex) {
+  if (!tRecording || eventIndex < 0 ||
+      eventIndex >= static_cast<int>(gCurrent.events.size())) {
+    return;
+  }
+  gCurrent.events[static_cast<size_t>(eventIndex)].endNs = NowNs();
+  tDepth = std::max(0, tDepth - 1);
+}
+
+const ProfileFrame* ProfilerFrame(int age) {
+  if (age < 0 || age >= ProfilerFrameCount()) return nullptr;
+  const uint64_t index = gFramesCompleted - 1 - static_cast<uint64_t>(age);
+  return &gHistory[static_cast<size_t>(index % kProfilerHistoryFrames)];
+}
+
+int ProfilerFrameCount() {
+  return static_cast<int>(std::min<uint64_t>(gFramesCompleted, kProfilerHistoryFrames));
+}
+
+int ProfilerWorstFrameAge(int window) {
+  int worstAge = -1;
+  int64_t worst = -1;
+  const int count = std::min(window, ProfilerFrameCount());
+  for (int age = 0; age < count; ++age) {
+    const ProfileFrame* frame = ProfilerFrame(age);
+    const int64_t duration = frame->endNs - frame->startNs;
+    if (duration > worst) {
+      worst = duration;
+      worstAge = age;
+    }
+  }
+  return worstAge;
+}
+
+std::vector<ProfileZoneStats> ProfilerZoneStats() {
+  std::vector<ProfileZoneStats> out;
+  out.reserve(gZones.size());
+  std::vector<float> scratch;
+  std::vector<bool> emitted(gZones.size(), false);
+
+  auto emit = [&](auto&& self, int zoneIndex) -> void {
+    if (emitted[static_cast<size_t>(zoneIndex)]) return;
+    emitted[static_cast<size_t>(zoneIndex)] = true;
+    const ZoneHistory& zone = gZones[static_cast<size_t>(zoneIndex)];
+    scratch.assign(zone.samples, zone.samples + zone.count);
+    ProfileZoneStats stats;
+    stats.name = zone.name;
+    stats.depth = zone.depth;
+    stats.callsLastFrame = (zone.lastFrame == gFramesCompleted) ? zone.callsLastFrame : 0;
+    stats.lastMs = zone.lastMs;
+    stats.p50Ms = Percentile(scratch, 0.50);
+    stats.p95Ms = Percentile(scratch, 0.95);
+    stats.p99Ms = Percentile(scratch, 0.99);
+    stats.maxMs = scratch.empty() ? 0.0 : *std::max_element(scratch.begin(), scratch.end());
+    out.push_back(stats);
+    for (int child = 0; child < static_cast<int>(gZones.size()); ++child) {
+      if (gZones[static_cast<size_t>(child)].parent == zone.name) self(self, child);
+    }
+  };
+  for (int i = 0; i < static_cast<int>(gZones.size()); ++i) {
+    if (gZones[static_cast<size_t>(i)].parent.empty()) emit(emit, i);
+  }
+  for (int i = 0; i < static_cast<int>(gZones.size()); ++i) emit(emit, i);
+  return out;
+}
+
+void ProfilerFrameTimesMs(std::vector<float>& out, int maxFrames) {
+  out.clear();
+  const int count = std::min(maxFrames, ProfilerFrameCount());
+  for (int age = count - 1; age >= 0; --age) {
+    const ProfileFrame* frame = ProfilerFrame(age);
+    out.push_back(static_cast<float>(frame->endNs - frame->startNs) * 1e-6f);
+  }
+}
+
+bool ProfilerWriteChromeTrace(const std::string& path, int maxFrames) {
+  const int count = std::min(maxFrames, ProfilerFrameCount());
+  if (count <= 0) return false;
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) return false;
+
+  const int64_t originNs = ProfilerFrame(count - 1)->startNs;
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for (int age = count - 1; age >= 0; --age) {
+    const ProfileFrame* frame = ProfilerFrame(age);
+    AppendTraceEvent(out, "Frame", frame->startNs, frame->endNs, originNs, first);
+    for (const ProfileEvent& event : frame->events) {
+      AppendTraceEvent(out, event.name, event.startNs, event.endNs, originNs, first);
+    }
+    if (out.size() > (1u << 20)) {
+      std::fwrite(out.data(), 1, out.size(), file);
+      out.clear();
+    }
+  }
+  out += "\n]}\n";
+  std::fwrite(out.data(), 1, out.size(), file);
+  return std::fclose(file) == 0;
+}
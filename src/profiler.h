@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped timing zones, recorded only on the thread that opened the current frame. Zone names
+// must be string literals (they are stored by pointer). Build with FUNSIM_PROFILER=0 to compile
+// every zone out.
+#ifndef FUNSIM_PROFILER
+#define FUNSIM_PROFILER 1
+#endif
+
+struct ProfileEvent {
+  const char* name = nullptr;
+  int64_t startNs = 0;
+  int64_t endNs = 0;
+  int depth = 0;
+};
+
+struct ProfileFrame {
+  uint64_t index = 0;
+  int64_t startNs = 0;
+  int64_t endNs = 0;
+  std::vector<ProfileEvent> events;
+};
+
+struct ProfileZoneStats {
+  const char* name = nullptr;
+  int depth = 0;
+  int callsLastFrame = 0;
+  double lastMs = 0.0;
+  double p50Ms = 0.0;
+  double p95Ms = 0.0;
+  double p99Ms = 0.0;
+  double maxMs = 0.0;
+};
+
+constexpr int kProfilerHistoryFrames = 600;
+constexpr int kProfilerStatSamples = 240;
+
+void ProfilerSetEnabled(bool enabled);
+bool ProfilerEnabled();
+void ProfilerBeginFrame();
+void ProfilerEndFrame();
+int ProfilerBeginZone(const char* name);
+void ProfilerEndZone(int eventIndex);
+
+// Completed frames, newest first (age 0). Returns nullptr past the retained history.
+const ProfileFrame* ProfilerFrame(int age);
+int ProfilerFrameCount();
+int ProfilerWorstFrameAge(int window);
+// Per-zone rolling stats over the frames in which each zone ran, in call-tree order.
+std::vector<ProfileZoneStats> ProfilerZoneStats();
+void ProfilerFrameTimesMs(std::vector<float>& out, int maxFrames);
+// Writes the last maxFrames frames as chrome://tracing / Perfetto "traceEvents" JSON.
+bool ProfilerWriteChromeTrace(const std::string& path, int maxFrames);
+
+class ProfileZone {
+ public:
+  explicit ProfileZone(const char* name) : index_(ProfilerBeginZone(name)) {}
+  ~ProfileZone() {
+    if (index_ >= 0) ProfilerEndZone(index_);
+  }
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+ private:
+  int index_;
+};
+
+// Back-to-back child zones inside one function: Next() closes the previous phase.
+class ProfilePhases {
+ public:
+  ProfilePhases() = default;
+  ~ProfilePhases() { End(); }
+  ProfilePhases(const ProfilePhases&) = delete;
+  ProfilePhases& operator=(const ProfilePhases&) = delete;
+
+  void Next(const char* name) {
+    End();
+    index_ = ProfilerBeginZone(name);
+  }
+  void End() {
+    if (index_ >= 0) ProfilerEndZone(index_);
+    index_ = -1;
+  }
+
+ private:
+  int index_ = -1;
+};
+
+#define FUNSIM_PROFILE_CONCAT_INNER(a, b) a##b
+#define FUNSIM_PROFILE_CONCAT(a, b) FUNSIM_PROFILE_CONCAT_INNER(a, b)
+
+#if FUNSIM_PROFILER
+#define FUNSIM_PROFILE_ZONE(name) ProfileZone FUNSIM_PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#define FUNSIM_PROFILE_PHASES(var) ProfilePhases var
+#define FUNSIM_PROFILE_NEXT(var, name) (var).Next(name)
+#else
+#define FUNSIM_PROFILE_ZONE(name) ((void)0)
+#define FUNSIM_PROFILE_PHASES(var) ((void)0)
+#define FUNSIM_PROFILE_NEXT(var, name) ((void)0)
+#endif
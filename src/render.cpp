@@ -11,6 +11,7 @@
 #include <limits>
 
 #include "factions.h"
+#include "profiler.h"
 #include "settlements.h"
 
 namespace {
@@ -832,6 +833,7 @@ void Renderer::Render(SDL_Renderer* renderer, World& world, const HumanManager&
                       const std::vector<VillageMarker>& villageMarkers, int hoverTileX,
                       int hoverTileY, bool hoverValid, int brushSize, OverlayMode overlayMode,
                       const RenderOverlayConfig& config) {
+  FUNSIM_PROFILE_ZONE("Renderer::Render");
   const float tileSize = static_cast<float>(kTilePx);
   const float invZoom = 1.0f / camera.zoom;
 
@@ -8,6 +8,7 @@
 
 #include "humans.h"
 #include "overlays.h"
+#include "settlements.h"
 #include "world.h"
 
 class FactionManager;
@@ -21,12 +22,6 @@ struct Camera {
   float zoom = 1.0f;
 };
 
-struct VillageMarker {
-  int x = 0;
-  int y = 0;
-  int ttlDays = 0;
-};
-
 struct RenderOverlayConfig {
   int territoryAlpha = 90;          // Used for FactionTerritory/SettlementInfluence fills.
   float territoryDarken = 0.65f;    // Multiplies faction RGB to reduce saturation.
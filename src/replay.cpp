@@ -0,0 +1,360 @@
+#include "replay.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "factions.h"
+#include "humans.h"
+#include "settlements.h"
+#include "sim_harness.h"
+#include "world.h"
+
+namespace {
+constexpr const char* kReplayMagic = "funsim-replay";
+constexpr const char* kMapSuffix = ".fmap";
+
+struct EventName {
+  ReplayEventType type;
+  const char* name;
+};
+
+constexpr EventName kEventNames[] = {
+    {ReplayEventType::Populate, "populate"},     {ReplayEventType::Tool, "tool"},
+    {ReplayEventType::Toggles, "toggles"},       {ReplayEventType::Speed, "speed"},
+    {ReplayEventType::Ticks, "ticks"},           {ReplayEventType::StepDay, "step_day"},
+    {ReplayEventType::MacroDays, "macro"},       {ReplayEventType::EnterMacro, "enter_macro"},
+    {ReplayEventType::ExitMacro, "exit_macro"},  {ReplayEventType::Rehydrate, "rehydrate"},
+    {ReplayEventType::ArmyOrders, "army_orders"}, {ReplayEventType::DayHash, "hash"},
+};
+
+const char* EventName(ReplayEventType type) {
+  for (const auto& entry : kEventNames) {
+    if (entry.type == type) return entry.name;
+  }
+  return "unknown";
+}
+
+bool ParseEvent(const std::string& line, ReplayEvent& event) {
+  char name[32] = {};
+  if (std::sscanf(line.c_str(), "%31s", name) != 1) return false;
+  bool known = false;
+  for (const auto& entry : kEventNames) {
+    if (std::strcmp(entry.name, name) == 0) {
+      event.type = entry.type;
+      known = true;
+      break;
+    }
+  }
+  if (!known) return false;
+
+  const char* args = line.c_str() + std::strlen(name);
+  switch (event.type) {
+    case ReplayEventType::Tool: {
+      int tool = 0;
+      int erase = 0;
+      if (std::sscanf(args, "%d %d %d %d %d", &tool, &event.x, &event.y, &event.brushSize,
+                      &erase) != 5) {
+        return false;
+      }
+      event.tool = static_cast<ToolType>(tool);
+      event.erase = (erase != 0);
+      return true;
+    }
+    case ReplayEventType::Toggles: {
+      int war = 0;
+      int rebellions = 0;
+      int starvation = 0;
+      if (std::sscanf(args, "%d %d %d", &war, &rebellions, &starvation) != 3) return false;
+      event.warEnabled = (war != 0);
+      event.rebellionsEnabled = (rebellions != 0);
+      event.starvationDeathEnabled = (starvation != 0);
+      return true;
+    }
+    case ReplayEventType::EnterMacro:
+    case ReplayEventType::ExitMacro:
+    case ReplayEventType::ArmyOrders:
+      return true;
+    case ReplayEventType::DayHash:
+      return std::sscanf(args, "%d %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64, &event.hash.day,
+                         &event.hash.world, &event.hash.humans, &event.hash.settlements,
+                         &event.hash.factions) == 5;
+    default:
+      return std::sscanf(args, "%d", &event.count) == 1;
+  }
+}
+
+void AppendSubsystem(std::string& out, const char* name) {
+  if (!out.empty()) out += ", ";
+  out += name;
+}
+}  // namespace
+
+SimStateHash ComputeStateHash(int day, const World& world, const HumanManager& humans,
+                              const SettlementManager& settlements,
+                              const FactionManager& factions) {
+  SimStateHash hash;
+  hash.day = day;
+  hash.world = world.StateHash();
+  hash.humans = humans.StateHash();
+  hash.settlements = settlements.StateHash();
+  hash.factions = factions.StateHash();
+  return hash;
+}
+
+bool LoadReplay(const std::string& path, Replay& out, std::string& error) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    error = "could not open " + path;
+    return false;
+  }
+
+  out = Replay{};
+  std::string line;
+  int version = 0;
+  char magic[32] = {};
+  if (!std::getline(in, line) || std::sscanf(line.c_str(), "%31s %d", magic, &version) != 2 ||
+      std::strcmp(magic, kReplayMagic) != 0) {
+    error = "not a replay file";
+    return false;
+  }
+  if (version != kReplayVersion) {
+    error = "unsupported replay version " + std::to_string(version);
+    return false;
+  }
+
+  int lineNumber = 1;
+  std::string mapName;
+  while (std::getline(in, line)) {
+    lineNumber++;
+    if (line.empty()) continue;
+    unsigned int seed = 0;
+    if (std::sscanf(line.c_str(), "seed %u", &seed) == 1) {
+      out.seed = static_cast<uint32_t>(seed);
+      continue;
+    }
+    if (line.rfind("map ", 0) == 0) {
+      mapName = line.substr(4);
+      continue;
+    }
+    if (std::sscanf(line.c_str(), "ticks_per_day %d", &out.ticksPerDay) == 1) continue;
+    if (std::sscanf(line.c_str(), "tick_seconds %f", &out.tickSeconds) == 1) continue;
+
+    ReplayEvent event;
+    if (!ParseEvent(line, event)) {
+      error = "bad replay line " + std::to_string(lineNumber) + ": " + line;
+      return false;
+    }
+    out.events.push_back(event);
+  }
+  if (mapName.empty()) {
+    error = "replay has no map";
+    return false;
+  }
+  out.mapPath = (std::filesystem::path(path).parent_path() / mapName).string();
+  return true;
+}
+
+ReplayRecorder::~ReplayRecorder() {
+  End();
+}
+
+bool ReplayRecorder::Begin(const std::string& path, uint32_t seed, World& world, int ticksPerDay,
+                           float tickSeconds) {
+  End();
+  std::filesystem::path outPath(path);
+  if (outPath.has_parent_path()) {
+    std::error_code ec;
+    std::filesystem::create_directories(outPath.parent_path(), ec);
+  }
+  const std::string mapPath = path + kMapSuffix;
+  if (!world.SaveMap(mapPath) || !world.LoadMap(mapPath)) return false;
+
+  file_ = std::fopen(path.c_str(), "w");
+  if (!file_) return false;
+  path_ = path;
+  pendingTicks_ = 0;
+  toggles_ = -1;
+  speedIndex_ = -1;
+  std::fprintf(file_, "%s %d\nseed %u\nmap %s\nticks_per_day %d\ntick_seconds %.9g\n",
+               kReplayMagic, kReplayVersion, seed,
+               std::filesystem::path(mapPath).filename().string().c_str(), ticksPerDay,
+               static_cast<double>(tickSeconds));
+  return true;
+}
+
+void ReplayRecorder::End() {
+  if (!file_) return;
+  FlushTicks();
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+void ReplayRecorder::FlushTicks() {
+  if (!file_ || pendingTicks_ <= 0) return;
+  std::fprintf(file_, "%s %d\n", EventName(ReplayEventType::Ticks), pendingTicks_);
+  pendingTicks_ = 0;
+}
+
+void ReplayRecorder::RecordPopulate(int count) {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s %d\n", EventName(ReplayEventType::Populate), count);
+}
+
+void ReplayRecorder::RecordTool(ToolType tool, int x, int y, int brushSize, bool erase) {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s %d %d %d %d %d\n", EventName(ReplayEventType::Tool),
+               static_cast<int>(tool), x, y, brushSize, erase ? 1 : 0);
+}
+
+void ReplayRecorder::RecordToggles(bool warEnabled, bool rebellionsEnabled,
+                                   bool starvationDeathEnabled) {
+  if (!file_) return;
+  const int toggles = (warEnabled ? 1 : 0) | (rebellionsEnabled ? 2 : 0) |
+                      (starvationDeathEnabled ? 4 : 0);
+  if (toggles == toggles_) return;
+  toggles_ = toggles;
+  FlushTicks();
+  std::fprintf(file_, "%s %d %d %d\n", EventName(ReplayEventType::Toggles), warEnabled ? 1 : 0,
+               rebellionsEnabled ? 1 : 0, starvationDeathEnabled ? 1 : 0);
+}
+
+void ReplayRecorder::RecordSpeed(int speedIndex) {
+  if (!file_ || speedIndex == speedIndex_) return;
+  speedIndex_ = speedIndex;
+  FlushTicks();
+  std::fprintf(file_, "%s %d\n", EventName(ReplayEventType::Speed), speedIndex);
+}
+
+void ReplayRecorder::RecordTicks(int count) {
+  if (!file_) return;
+  pendingTicks_ += count;
+}
+
+void ReplayRecorder::RecordStepDay(int dayDelta) {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s %d\n", EventName(ReplayEventType::StepDay), dayDelta);
+}
+
+void ReplayRecorder::RecordMacroDays(int days) {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s %d\n", EventName(ReplayEventType::MacroDays), days);
+}
+
+void ReplayRecorder::RecordEnterMacro() {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s\n", EventName(ReplayEventType::EnterMacro));
+}
+
+void ReplayRecorder::RecordExitMacro() {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s\n", EventName(ReplayEventType::ExitMacro));
+}
+
+void ReplayRecorder::RecordRehydrate(int maxHumans) {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s %d\n", EventName(ReplayEventType::Rehydrate), maxHumans);
+}
+
+void ReplayRecorder::RecordArmyOrders() {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s\n", EventName(ReplayEventType::ArmyOrders));
+}
+
+void ReplayRecorder::RecordDayHash(const SimStateHash& hash) {
+  if (!file_) return;
+  FlushTicks();
+  std::fprintf(file_, "%s %d %016" PRIx64 " %016" PRIx64 " %016" PRIx64 " %016" PRIx64 "\n",
+               EventName(ReplayEventType::DayHash), hash.day, hash.world, hash.humans,
+               hash.settlements, hash.factions);
+}
+
+bool RunReplay(const Replay& replay, SimHarness& sim, ReplayResult& result, std::string& error) {
+  result = ReplayResult{};
+  if (!sim.world.LoadMap(replay.mapPath)) {
+    error = "could not load map " + replay.mapPath;
+    return false;
+  }
+  sim.world.RecomputeScentFields();
+  CrashContextSetWorld(sim.world.width(), sim.world.height());
+  sim.rng = Random(replay.seed);
+  sim.ticksPerDay = std::max(1, replay.ticksPerDay);
+  sim.tickSeconds = replay.tickSeconds;
+
+  for (const ReplayEvent& event : replay.events) {
+    switch (event.type) {
+      case ReplayEventType::Populate:
+        SpawnClusteredPopulation(sim.world, sim.humans, sim.rng, event.count);
+        break;
+      case ReplayEventType::Tool:
+        ApplyTool(sim.world, sim.humans, sim.rng, event.tool, event.x, event.y, event.brushSize,
+                  event.erase);
+        break;
+      case ReplayEventType::Toggles:
+        sim.factions.SetWarEnabled(event.warEnabled);
+        sim.settlements.SetRebellionsEnabled(event.rebellionsEnabled);
+        sim.humans.SetAllowStarvationDeath(event.starvationDeathEnabled);
+        break;
+      case ReplayEventType::Speed:
+        // Macro transitions are recorded as their own events; speed alone does not step.
+        break;
+      case ReplayEventType::Ticks:
+        sim.AdvanceTicks(event.count);
+        break;
+      case ReplayEventType::StepDay:
+        sim.tickCount += sim.ticksPerDay;
+        sim.StepDayCoarse(event.count);
+        break;
+      case ReplayEventType::MacroDays:
+        sim.StepMacroDays(event.count);
+        break;
+      case ReplayEventType::EnterMacro:
+        sim.humans.EnterMacro(sim.settlements);
+        break;
+      case ReplayEventType::ExitMacro:
+        sim.humans.BeginExitMacro(sim.settlements, sim.rng);
+        break;
+      case ReplayEventType::Rehydrate:
+        sim.humans.StepExitMacro(sim.settlements, event.count);
+        break;
+      case ReplayEventType::ArmyOrders:
+        sim.settlements.UpdateArmyOrders(sim.world, sim.humans, sim.rng, sim.dayCount, 1,
+                                         sim.factions);
+        break;
+      case ReplayEventType::DayHash: {
+        const SimStateHash actual =
+            ComputeStateHash(sim.dayCount, sim.world, sim.humans, sim.settlements, sim.factions);
+        const SimStateHash& expected = event.hash;
+        std::string subsystems;
+        if (actual.day != expected.day) AppendSubsystem(subsystems, "Calendar");
+        if (actual.world != expected.world) AppendSubsystem(subsystems, "World");
+        if (actual.humans != expected.humans) AppendSubsystem(subsystems, "HumanManager");
+        if (actual.settlements != expected.settlements) {
+          AppendSubsystem(subsystems, "SettlementManager");
+        }
+        if (actual.factions != expected.factions) AppendSubsystem(subsystems, "FactionManager");
+        if (!subsystems.empty()) {
+          result.diverged = true;
+          result.expected = expected;
+          result.actual = actual;
+          result.subsystems = subsystems;
+          return true;
+        }
+        result.daysChecked++;
+        result.lastMatchedDay = actual.day;
+        break;
+      }
+    }
+  }
+  return true;
+}
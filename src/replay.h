@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tools.h"
+
+class FactionManager;
+class HumanManager;
+class SettlementManager;
+class SimHarness;
+class World;
+
+// Replays are line-oriented text: a header (seed, map file, tick length) followed by every
+// sim-affecting input in the order it was applied, with a state hash line after each day step.
+// A step is one coarse day in micro mode and one batch in macro mode. With --macro-batch N (the
+// GUI batches by default), cohorts move N days in one update and there is no per-day state
+// to hash. A divergence is then located only to within that batch; record with a batch of 1
+// for day-exact hashes. The map is saved next to the replay and referenced by file name.
+constexpr int kReplayVersion = 1;
+
+struct SimStateHash {
+  int day = 0;
+  uint64_t world = 0;
+  uint64_t humans = 0;
+  uint64_t settlements = 0;
+  uint64_t factions = 0;
+};
+
+SimStateHash ComputeStateHash(int day, const World& world, const HumanManager& humans,
+                              const SettlementManager& settlements,
+                              const FactionManager& factions);
+
+enum class ReplayEventType : uint8_t {
+  Populate,
+  Tool,
+  Toggles,
+  Speed,
+  Ticks,
+  StepDay,
+  MacroDays,
+  EnterMacro,
+  ExitMacro,
+  Rehydrate,
+  ArmyOrders,
+  DayHash,
+};
+
+struct ReplayEvent {
+  ReplayEventType type = ReplayEventType::Ticks;
+  // Populate: humans; Speed: speed index; Ticks: ticks; StepDay: day delta; MacroDays: days
+  // advanced as one (batched) macro step;
+  // Rehydrate: humans rebuilt by that step (0 = all remaining).
+  int count = 0;
+  ToolType tool = ToolType::PlaceLand;
+  int x = 0;
+  int y = 0;
+  int brushSize = 1;
+  bool erase = false;
+  bool warEnabled = true;
+  bool rebellionsEnabled = true;
+  bool starvationDeathEnabled = true;
+  SimStateHash hash;
+};
+
+struct Replay {
+  uint32_t seed = 0;
+  std::string mapPath;
+  int ticksPerDay = 50;
+  float tickSeconds = 0.1f;
+  std::vector<ReplayEvent> events;
+};
+
+bool LoadReplay(const std::string& path, Replay& out, std::string& error);
+
+class ReplayRecorder {
+ public:
+  ReplayRecorder() = default;
+  ~ReplayRecorder();
+  ReplayRecorder(const ReplayRecorder&) = delete;
+  ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+  // Saves world's terrain beside the replay and reloads world from it, so the recording starts
+  // from exactly the state playback will load. Callers reset the other managers and seed their
+  // Random with seed afterwards.
+  bool Begin(const std::string& path, uint32_t seed, World& world, int ticksPerDay,
+             float tickSeconds);
+  void End();
+  bool Active() const { return file_ != nullptr; }
+  const std::string& Path() const { return path_; }
+
+  void RecordPopulate(int count);
+  void RecordTool(ToolType tool, int x, int y, int brushSize, bool erase);
+  // Toggles and speed are only written when they change.
+  void RecordToggles(bool warEnabled, bool rebellionsEnabled, bool starvationDeathEnabled);
+  void RecordSpeed(int speedIndex);
+  // Consecutive ticks are merged into one line.
+  void RecordTicks(int count);
+  void RecordStepDay(int dayDelta);
+  void RecordMacroDays(int days);
+  void RecordEnterMacro();
+  void RecordExitMacro();
+  void RecordRehydrate(int maxHumans);
+  void RecordArmyOrders();
+  void RecordDayHash(const SimStateHash& hash);
+
+ private:
+  void FlushTicks();
+
+  FILE* file_ = nullptr;
+  std::string path_;
+  int pendingTicks_ = 0;
+  int toggles_ = -1;
+  int speedIndex_ = -1;
+};
+
+struct ReplayResult {
+  int daysChecked = 0;
+  // Calendar day of the last hash that matched; the divergence lies in (lastMatchedDay,
+  // expected.day].
+  int lastMatchedDay = 0;
+  bool diverged = false;
+  SimStateHash expected;
+  SimStateHash actual;
+  // Subsystems whose hash differs on the first divergent day, in step order.
+  std::string subsystems;
+};
+
+// Loads the replay's map into a fresh sim and applies every event, stopping at the first day
+// whose state hash differs from the recording. Returns false if the replay cannot be run.
+bool RunReplay(const Replay& replay, SimHarness& sim, ReplayResult& result, std::string& error);
@@ -1,16 +1,30 @@
 #include "settlements.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <limits>
+#include <thread>
 #include <unordered_map>
 
 #include "factions.h"
 #include "humans.h"
+#include "profiler.h"
 #include "util.h"
 #include "world.h"
 
+// Debug builds cross-check the event-driven building counters against a full rescan after every
+// update and log any settlement that drifted.
+#ifndef FUNSIM_VERIFY_BUILDING_STATS
+#ifdef NDEBUG
+#define FUNSIM_VERIFY_BUILDING_STATS 0
+#else
+#define FUNSIM_VERIFY_BUILDING_STATS 1
+#endif
+#endif
+
 namespace {
 constexpr int kZonePopThreshold = 10;
 constexpr int kZoneRequiredDays = 3;
@@ -46,6 +60,10 @@ constexpr int kHouseBuildRadius = 16;
 constexpr int kFarmBuildRadius = 12;
 constexpr int kFarmWorkRadius = 14;
 constexpr int kGranaryDropRadius = 4;
+constexpr size_t kInitialTaskKeySlots = 32;
+// Queued tasks left unclaimed for this many generation rounds are dropped; producers re-sample
+// the tiles that still need work.
+constexpr int kTaskMaxAgeRounds = 2;
 constexpr int kGranaryBuildRadius = 4;
 constexpr int kFarGatherRadius = 24;
 constexpr int kHousingBuffer = 10;
@@ -53,6 +71,8 @@ constexpr int kDesiredFoodPerPop = 60;
 constexpr int kDesiredWoodPerPop = 4;
 constexpr int kFarmsPerPop = 3;
 constexpr int kWaterSearchRadius = 28;
+constexpr int kSettlementsPerWorker = 16;
+constexpr int kSettlementMaxThreads = 8;
 constexpr int kFactionLinkRadiusTiles = 96;
 constexpr int kEmergencyFoodPerPop = 12;
 constexpr int kEmergencyFarmerPct = 60;
@@ -150,6 +170,405 @@ int FarmsPerPopForTier(int tier) {
   return value;
 }
 
+void TaskStore::SetOrigin(int centerX, int centerY) {
+  originX_ = centerX - (kBucketSize * kBucketsPerSide) / 2;
+  originY_ = centerY - (kBucketSize * kBucketsPerSide) / 2;
+}
+
+uint64_t TaskStore::KeyOf(TaskType type, int x, int y) {
+  // type + 1 keeps every key non-zero, so 0 can mark empty slots.
+  return ((static_cast<uint64_t>(type) + 1) << 48) |
+         (static_cast<uint64_t>(static_cast<uint32_t>(x) & 0xFFFFFFu) << 24) |
+         static_cast<uint64_t>(static_cast<uint32_t>(y) & 0xFFFFFFu);
+}
+
+int TaskStore::BucketCoord(int value, int origin) const {
+  const int offset = value - origin;
+  if (offset < 0) return 0;
+  return std::min(offset / kBucketSize, kBucketsPerSide - 1);
+}
+
+size_t TaskStore::KeySlot(uint64_t key) const {
+  return static_cast<size_t>(RngMix(key)) & (keys_.size() - 1);
+}
+
+bool TaskStore::Contains(TaskType type, int x, int y) const {
+  if (entries_.empty()) return false;
+  const uint64_t key = KeyOf(type, x, y);
+  const size_t mask = keys_.size() - 1;
+  for (size_t slot = KeySlot(key); keys_[slot] != 0; slot = (slot + 1) & mask) {
+    if (keys_[slot] == key) return true;
+  }
+  return false;
+}
+
+void TaskStore::InsertKey(uint64_t key) {
+  if ((entries_.size() + 1) * 2 > keys_.size()) {
+    std::vector<uint64_t> old;
+    old.swap(keys_);
+    keys_.assign(std::max(kInitialTaskKeySlots, old.size() * 2), 0);
+    for (uint64_t oldKey : old) {
+      if (oldKey != 0) InsertKey(oldKey);
+    }
+  }
+  const size_t mask = keys_.size() - 1;
+  size_t slot = KeySlot(key);
+  while (keys_[slot] != 0) slot = (slot + 1) & mask;
+  keys_[slot] = key;
+}
+
+void TaskStore::EraseKey(uint64_t key) {
+  const size_t mask = keys_.size() - 1;
+  size_t hole = KeySlot(key);
+  while (keys_[hole] != key) hole = (hole + 1) & mask;
+  keys_[hole] = 0;
+  // Backward-shift deletion: pull later keys of the probe run into the hole unless their home
+  // slot lies cyclically in (hole, slot].
+  for (size_t slot = (hole + 1) & mask; keys_[slot] != 0; slot = (slot + 1) & mask) {
+    const size_t home = KeySlot(keys_[slot]);
+    const bool stays = hole <= slot ? (home > hole && home <= slot)
+                                    : (home > hole || home <= slot);
+    if (stays) continue;
+    keys_[hole] = keys_[slot];
+    keys_[slot] = 0;
+    hole = slot;
+  }
+}
+
+bool TaskStore::Push(const Task& task) {
+  if (Contains(task.type, task.x, task.y)) return true;
+  if (Count() >= kMaxTasks) return false;
+  InsertKey(KeyOf(task.type, task.x, task.y));
+  const int index = Count();
+  Entry entry;
+  entry.task = task;
+  entry.seq = nextSeq_++;
+  entry.round = round_;
+  entry.bucket = BucketCoord(task.y, originY_) * kBucketsPerSide + BucketCoord(task.x, originX_);
+  entry.next = bucketHead_[static_cast<size_t>(entry.bucket)];
+  if (entry.next != -1) entries_[static_cast<size_t>(entry.next)].prev = index;
+  bucketHead_[static_cast<size_t>(entry.bucket)] = index;
+  entries_.push_back(entry);
+  typeCounts_[static_cast<size_t>(task.type)]++;
+  if (task.type == TaskType::BuildStructure) {
+    planned_.push_back(PlannedBuild{task.x, task.y, task.buildType});
+  }
+  return true;
+}
+
+void TaskStore::Remove(int index) {
+  const Entry removed = entries_[static_cast<size_t>(index)];
+  if (removed.prev != -1) {
+    entries_[static_cast<size_t>(removed.prev)].next = removed.next;
+  } else {
+    bucketHead_[static_cast<size_t>(removed.bucket)] = removed.next;
+  }
+  if (removed.next != -1) entries_[static_cast<size_t>(removed.next)].prev = removed.prev;
+  EraseKey(KeyOf(removed.task.type, removed.task.x, removed.task.y));
+  typeCounts_[static_cast<size_t>(removed.task.type)]--;
+  if (removed.task.type == TaskType::BuildStructure) {
+    for (size_t i = 0; i < planned_.size(); ++i) {
+      const PlannedBuild& build = planned_[i];
+      if (build.x == removed.task.x && build.y == removed.task.y &&
+          build.type == removed.task.buildType) {
+        planned_[i] = planned_.back();
+        planned_.pop_back();
+        break;
+      }
+    }
+  }
+
+  const int last = Count() - 1;
+  if (index != last) {
+    const Entry& moved = entries_[static_cast<size_t>(last)];
+    if (moved.prev != -1) {
+      entries_[static_cast<size_t>(moved.prev)].next = index;
+    } else {
+      bucketHead_[static_cast<size_t>(moved.bucket)] = index;
+    }
+    if (moved.next != -1) entries_[static_cast<size_t>(moved.next)].prev = index;
+    entries_[static_cast<size_t>(index)] = moved;
+  }
+  entries_.pop_back();
+}
+
+bool TaskStore::ClaimNearest(int x, int y, uint32_t typeMask, Task& out) {
+  bool anyMatch = false;
+  for (size_t type = 0; type < typeCounts_.size(); ++type) {
+    if (typeCounts_[type] > 0 && (typeMask & (1u << type)) != 0) anyMatch = true;
+  }
+  if (!anyMatch) return false;
+  const int cellX = BucketCoord(x, originX_);
+  const int cellY = BucketCoord(y, originY_);
+  int best = -1;
+  int bestDist = 0;
+  uint32_t bestSeq = 0;
+  auto scanCell = [&](int bx, int by) {
+    if (bx < 0 || by < 0 || bx >= kBucketsPerSide || by >= kBucketsPerSide) return;
+    for (int i = bucketHead_[static_cast<size_t>(by * kBucketsPerSide + bx)]; i != -1;
+         i = entries_[static_cast<size_t>(i)].next) {
+      const Entry& entry = entries_[static_cast<size_t>(i)];
+      if ((typeMask & TypeBit(entry.task.type)) == 0) continue;
+      const int dist = std::abs(entry.task.x - x) + std::abs(entry.task.y - y);
+      if (best == -1 || dist < bestDist || (dist == bestDist && entry.seq < bestSeq)) {
+        best = i;
+        bestDist = dist;
+        bestSeq = entry.seq;
+      }
+    }
+  };
+  // Every tile in ring r > 0 of cells is at least (r - 1) * kBucketSize + 1 away on some axis,
+  // also for clamped tasks and claimants, so the search stops once no ring can beat the best.
+  for (int ring = 0; ring < kBucketsPerSide; ++ring) {
+    if (best != -1 && bestDist <= (ring - 1) * kBucketSize) break;
+    if (ring == 0) {
+      scanCell(cellX, cellY);
+      continue;
+    }
+    for (int d = -ring; d <= ring; ++d) {
+      scanCell(cellX + d, cellY - ring);
+      scanCell(cellX + d, cellY + ring);
+    }
+    for (int d = -ring + 1; d <= ring - 1; ++d) {
+      scanCell(cellX - ring, cellY + d);
+      scanCell(cellX + ring, cellY + d);
+    }
+  }
+  if (best == -1) return false;
+  out = entries_[static_cast<size_t>(best)].task;
+  Remove(best);
+  return true;
+}
+
+void TaskStore::Clear() {
+  entries_.clear();
+  bucketHead_.fill(-1);
+  typeCounts_.fill(0);
+  std::fill(keys_.begin(), keys_.end(), 0);
+  planned_.clear();
+}
+
+int TaskStore::PlannedCount(BuildingType type) const {
+  int count = 0;
+  for (const PlannedBuild& build : planned_) {
+    if (build.type == type) count++;
+  }
+  return count;
+}
+
+bool TaskStore::HasPlannedNear(BuildingType type, int x, int y, int radius) const {
+  for (const PlannedBuild& build : planned_) {
+    if (build.type != type) continue;
+    if (std::abs(build.x - x) + std::abs(build.y - y) <= radius) return true;
+  }
+  return false;
+}
+
+const std::vector<uint64_t>* BuildingRegistry::ListFor(BuildingType type) const {
+  switch (type) {
+    case BuildingType::House:
+      return &houses;
+    case BuildingType::Farm:
+      return &farms;
+    case BuildingType::Granary:
+      return &granaries;
+    case BuildingType::Well:
+      return &wells;
+    default:
+      return nullptr;
+  }
+}
+
+std::vector<uint64_t>* BuildingRegistry::MutableListFor(BuildingType type) {
+  switch (type) {
+    case BuildingType::House:
+      return &houses;
+    case BuildingType::Farm:
+      return &farms;
+    case BuildingType::Granary:
+      return &granaries;
+    case BuildingType::Well:
+      return &wells;
+    default:
+      return nullptr;
+  }
+}
+
+void BuildingRegistry::Add(BuildingType type, int x, int y) {
+  std::vector<uint64_t>* list = MutableListFor(type);
+  if (!list) return;
+  const uint64_t key = Pack(x, y);
+  list->insert(std::lower_bound(list->begin(), list->end(), key), key);
+}
+
+void BuildingRegistry::Remove(BuildingType type, int x, int y) {
+  std::vector<uint64_t>* list = MutableListFor(type);
+  if (!list) return;
+  const uint64_t key = Pack(x, y);
+  auto it = std::lower_bound(list->begin(), list->end(), key);
+  if (it != list->end() && *it == key) list->erase(it);
+}
+
+void BuildingRegistry::Clear() {
+  houses.clear();
+  farms.clear();
+  granaries.clear();
+  wells.clear();
+}
+
+void SettlementIndex::Reset(int worldWidth, int worldHeight) {
+  cellsX_ = std::max(1, (worldWidth + kCellSize - 1) / kCellSize);
+  cellsY_ = std::max(1, (worldHeight + kCellSize - 1) / kCellSize);
+  cells_.assign(static_cast<size_t>(cellsX_ * cellsY_), {});
+  centers_.clear();
+  factionMembers_.clear();
+}
+
+void SettlementIndex::Insert(int index, int x, int y, int factionId) {
+  if (index >= static_cast<int>(centers_.size())) centers_.resize(static_cast<size_t>(index) + 1);
+  centers_[static_cast<size_t>(index)] = Center{x, y, 0};
+  cells_[static_cast<size_t>(CellCoord(y, cellsY_) * cellsX_ + CellCoord(x, cellsX_))].push_back(
+      index);
+  SetFaction(index, factionId);
+}
+
+void SettlementIndex::SetFaction(int index, int factionId) {
+  Center& center = centers_[static_cast<size_t>(index)];
+  if (center.factionId > 0 && center.factionId < static_cast<int>(factionMembers_.size())) {
+    std::vector<int>& members = factionMembers_[static_cast<size_t>(center.factionId)];
+    auto it = std::find(members.begin(), members.end(), index);
+    if (it != members.end()) {
+      *it = members.back();
+      members.pop_back();
+    }
+  }
+  center.factionId = factionId;
+  if (factionId <= 0) return;
+  if (factionId >= static_cast<int>(factionMembers_.size())) {
+    factionMembers_.resize(static_cast<size_t>(factionId) + 1);
+  }
+  factionMembers_[static_cast<size_t>(factionId)].push_back(index);
+}
+
+const std::vector<int>& SettlementIndex::FactionMembers(int factionId) const {
+  static const std::vector<int> kEmpty;
+  if (factionId <= 0 || factionId >= static_cast<int>(factionMembers_.size())) return kEmpty;
+  return factionMembers_[static_cast<size_t>(factionId)];
+}
+
+bool SettlementIndex::AnyWithinRadius(int x, int y, int radius, DistanceMetric metric) const {
+  if (cells_.empty() || radius < 0) return false;
+  const int limit = Distance(metric, radius, 0);
+  const int minCx = CellCoord(x - radius, cellsX_);
+  const int maxCx = CellCoord(x + radius, cellsX_);
+  const int minCy = CellCoord(y - radius, cellsY_);
+  const int maxCy = CellCoord(y + radius, cellsY_);
+  for (int cy = minCy; cy <= maxCy; ++cy) {
+    for (int cx = minCx; cx <= maxCx; ++cx) {
+      for (int index : Cell(cx, cy)) {
+        const Center& center = centers_[static_cast<size_t>(index)];
+        if (Distance(metric, center.x - x, center.y - y) <= limit) return true;
+      }
+    }
+  }
+  return false;
+}
+
+void SettlementIndex::WithinRadius(int x, int y, int radius, DistanceMetric metric,
+                                   std::vector<int>& out) const {
+  if (cells_.empty() || radius < 0) return;
+  const size_t first = out.size();
+  const int limit = Distance(metric, radius, 0);
+  const int minCx = CellCoord(x - radius, cellsX_);
+  const int maxCx = CellCoord(x + radius, cellsX_);
+  const int minCy = CellCoord(y - radius, cellsY_);
+  const int maxCy = CellCoord(y + radius, cellsY_);
+  for (int cy = minCy; cy <= maxCy; ++cy) {
+    for (int cx = minCx; cx <= maxCx; ++cx) {
+      for (int index : Cell(cx, cy)) {
+        const Center& center = centers_[static_cast<size_t>(index)];
+        if (Distance(metric, center.x - x, center.y - y) <= limit) out.push_back(index);
+      }
+    }
+  }
+  std::sort(out.begin() + static_cast<std::ptrdiff_t>(first), out.end());
+}
+
+const TaskStore& SettlementManager::Tasks(const Settlement& settlement) const {
+  static const TaskStore kEmpty;
+  if (settlement.taskStore < 0) return kEmpty;
+  return taskStores_[static_cast<size_t>(settlement.taskStore)];
+}
+
+const BuildingRegistry& SettlementManager::Buildings(const Settlement& settlement) const {
+  static const BuildingRegistry kEmpty;
+  const ptrdiff_t index = &settlement - settlements_.data();
+  if (index < 0 || index >= static_cast<ptrdiff_t>(buildingRegistries_.size())) return kEmpty;
+  return buildingRegistries_[static_cast<size_t>(index)];
+}
+
+int SettlementManager::MacroTotal(const Settlement& settlement) const {
+  const ptrdiff_t index = &settlement - settlements_.data();
+  if (index < 0 || index >= macroPools_.Size()) return 0;
+  return macroPools_.Total(static_cast<int>(index));
+}
+
+void SettlementManager::ClearMacroPools(const Settlement& settlement) {
+  const ptrdiff_t index = &settlement - settlements_.data();
+  if (index < 0 || index >= macroPools_.Size()) return;
+  macroPools_.Clear(static_cast<int>(index));
+}
+
+TaskStore& SettlementManager::AcquireTasks(Settlement& settlement) {
+  if (settlement.taskStore < 0) {
+    settlement.taskStore = static_cast<int>(taskStores_.size());
+    taskStores_.emplace_back().SetOrigin(settlement.centerX, settlement.centerY);
+  }
+  return taskStores_[static_cast<size_t>(settlement.taskStore)];
+}
+
+bool SettlementManager::PushTask(Settlement& settlement, const Task& task) {
+  return AcquireTasks(settlement).Push(task);
+}
+
+// Runs fn(index) once per settlement. Workers pull indices from a shared counter, so fn must only
+// touch its own settlement (plus that settlement's members, task queue and command buffer) and
+// read everything else; the result is then the same for any thread count.
+template <typename Fn>
+void SettlementManager::ParallelForSettlements(Fn&& fn) {
+  const int count = static_cast<int>(settlements_.size());
+  int threadCount = workerThreads_;
+  if (threadCount <= 0) {
+    threadCount = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1,
+                             kSettlementMaxThreads);
+  }
+  threadCount = std::min(threadCount, count / kSettlementsPerWorker);
+  if (threadCount <= 1) {
+    for (int i = 0; i < count; ++i) fn(i);
+    return;
+  }
+  std::atomic<int> next{0};
+  auto worker = [&]() {
+    for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) fn(i);
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(static_cast<size_t>(threadCount - 1));
+  for (int t = 1; t < threadCount; ++t) workers.emplace_back(worker);
+  worker();
+  for (auto& thread : workers) thread.join();
+}
+
+bool SettlementManager::ClaimNearestTask(Settlement& settlement, int x, int y, uint32_t typeMask,
+                                         Task& out) {
+  if (settlement.taskStore < 0) return false;
+  return taskStores_[static_cast<size_t>(settlement.taskStore)].ClaimNearest(x, y, typeMask, out);
+}
+
+void SettlementManager::ClearTasks(Settlement& settlement) {
+  if (settlement.taskStore < 0) return;
+  taskStores_[static_cast<size_t>(settlement.taskStore)].Clear();
+}
+
 bool SettlementManager::HasSettlement(int settlementId) const {
   for (const auto& settlement : settlements_) {
     if (settlement.id == settlementId) return true;
@@ -195,10 +614,8 @@ int SettlementManager::ZoneOwnerAt(int zx, int zy) const {
   if (zonesX_ == 0 || zonesY_ == 0) return -1;
   if (zx < 0 || zy < 0 || zx >= zonesX_ || zy >= zonesY_) return -1;
   int idx = zy * zonesX_ + zx;
-  if (idx < 0 || idx >= static_cast<int>(zoneOwnerStampByIndex_.size())) return -1;
-  return (zoneOwnerStampByIndex_[static_cast<size_t>(idx)] == zoneOwnerGeneration_)
-             ? zoneOwnerByIndex_[static_cast<size_t>(idx)]
-             : -1;
+  if (idx < 0 || idx >= static_cast<int>(zoneOwnerByIndex_.size())) return -1;
+  return zoneOwnerByIndex_[static_cast<size_t>(idx)];
 }
 
 int SettlementManager::ZonePopAt(int zx, int zy) const {
@@ -248,13 +665,28 @@ void SettlementManager::EnsureZoneBuffers(const World& world) {
   zoneOwnerGeneration_ = 1;
   zoneOwnerStampByIndex_.assign(static_cast<size_t>(totalZones), 0u);
   zoneOwnerByIndex_.assign(static_cast<size_t>(totalZones), -1);
-  zoneOwnerBestDistSqByIndex_.assign(static_cast<size_t>(totalZones), 0);
+  ownedZoneSlotByIndex_.assign(static_cast<size_t>(totalZones), -1);
+  zoneClaims_.assign(static_cast<size_t>(totalZones), {});
   ownedZoneIndices_.clear();
+  appliedClaimSources_.clear();
+  claimSourcesDirty_ = true;
 
   zoneConflictGeneration_ = 1;
   zoneConflictStampByIndex_.assign(static_cast<size_t>(totalZones), 0u);
   zoneConflictByIndex_.assign(static_cast<size_t>(totalZones), 0);
   conflictZoneIndices_.clear();
+
+  index_.Reset(world.width(), world.height());
+  for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
+    const Settlement& settlement = settlements_[static_cast<size_t>(i)];
+    index_.Insert(i, settlement.centerX, settlement.centerY, settlement.factionId);
+  }
+}
+
+void SettlementManager::SetSettlementFaction(Settlement& settlement, int factionId) {
+  settlement.factionId = factionId;
+  const int index = static_cast<int>(&settlement - settlements_.data());
+  if (index >= 0 && index < index_.Size()) index_.SetFaction(index, factionId);
 }
 
 void SettlementManager::RecomputeZonePop(const World& world, const HumanManager& humans, int dayDelta) {
@@ -364,8 +796,6 @@ void SettlementManager::RecomputeZonePopMacro() {
 void SettlementManager::TryFoundNewSettlements(World& world, Random& rng, int dayCount,
                                                std::vector<VillageMarker>& markers,
                                                FactionManager& factions) {
-  const int minDistSq = kMinVillageDistTiles * kMinVillageDistTiles;
-
   for (size_t denseIndex = 0; denseIndex < denseZoneIndices_.size();) {
     int zoneIndex = denseZoneIndices_[denseIndex];
     if (zoneIndex < 0 || zoneIndex >= zonesX_ * zonesY_) {
@@ -380,26 +810,18 @@ void SettlementManager::TryFoundNewSettlements(World& world, Random& rng, int da
     int endX = std::min(world.width(), startX + zoneSize_);
     int endY = std::min(world.height(), startY + zoneSize_);
 
-    bool tooClose = false;
-    int nearestId = -1;
-    int nearestDistSq = std::numeric_limits<int>::max();
-    for (const auto& settlement : settlements_) {
-      int dx = settlement.centerX - (startX + zoneSize_ / 2);
-      int dy = settlement.centerY - (startY + zoneSize_ / 2);
-      int distSq = dx * dx + dy * dy;
-      if (distSq < nearestDistSq) {
-        nearestDistSq = distSq;
-        nearestId = settlement.id;
-      }
-      if (distSq <= minDistSq) {
-        tooClose = true;
-        break;
-      }
-    }
-    if (tooClose) {
+    const int zoneCenterX = startX + zoneSize_ / 2;
+    const int zoneCenterY = startY + zoneSize_ / 2;
+    if (index_.AnyWithinRadius(zoneCenterX, zoneCenterY, kMinVillageDistTiles,
+                               DistanceMetric::EuclideanSq)) {
       denseIndex++;
       continue;
     }
+    int nearestId = -1;
+    int nearestDistSq = std::numeric_limits<int>::max();
+    const int nearestIndex =
+        index_.Nearest(zoneCenterX, zoneCenterY, DistanceMetric::EuclideanSq, nearestDistSq);
+    if (nearestIndex >= 0) nearestId = settlements_[static_cast<size_t>(nearestIndex)].id;
 
     int zonePop = ZonePopAt(zx, zy);
     int sourceFactionId = 0;
@@ -504,6 +926,9 @@ void SettlementManager::TryFoundNewSettlements(World& world, Random& rng, int da
     }
     settlement.factionId = factionId;
     settlements_.push_back(settlement);
+    macroPools_.Resize(Count());
+    index_.Insert(static_cast<int>(settlements_.size()) - 1, settlement.centerX,
+                  settlement.centerY, factionId);
     homeFieldDirty_ = true;
 
     markers.push_back(VillageMarker{bestX, bestY, 25});
@@ -515,54 +940,132 @@ void SettlementManager::TryFoundNewSettlements(World& world, Random& rng, int da
   (void)dayCount;
 }
 
-void SettlementManager::RecomputeZoneOwners(const World& world) {
+void SettlementManager::ApplyClaimSource(const World& world, int settlementIndex,
+                                         const ClaimSource& source, bool add) {
+  int radius = source.radius;
+  if (radius <= 0) return;
+  int radiusSq = radius * radius;
+
+  int minZoneX = std::max(0, (source.x - radius) / zoneSize_);
+  int maxZoneX = std::min(zonesX_ - 1, (source.x + radius) / zoneSize_);
+  int minZoneY = std::max(0, (source.y - radius) / zoneSize_);
+  int maxZoneY = std::min(zonesY_ - 1, (source.y + radius) / zoneSize_);
+
+  for (int zy = minZoneY; zy <= maxZoneY; ++zy) {
+    int centerY = std::min(world.height() - 1, zy * zoneSize_ + zoneSize_ / 2);
+    for (int zx = minZoneX; zx <= maxZoneX; ++zx) {
+      int centerX = std::min(world.width() - 1, zx * zoneSize_ + zoneSize_ / 2);
+      int dx = source.x - centerX;
+      int dy = source.y - centerY;
+      int dist = dx * dx + dy * dy;
+      if (dist > radiusSq) continue;
+      int idx = zy * zonesX_ + zx;
+      if (idx < 0 || idx >= static_cast<int>(zoneClaims_.size())) continue;
+      std::vector<ZoneClaim>& claims = zoneClaims_[static_cast<size_t>(idx)];
+      if (add) {
+        claims.push_back(ZoneClaim{settlementIndex, dist});
+      } else {
+        auto it = std::find_if(claims.begin(), claims.end(), [&](const ZoneClaim& claim) {
+          return claim.settlementIndex == settlementIndex && claim.distSq == dist;
+        });
+        if (it == claims.end()) continue;
+        *it = claims.back();
+        claims.pop_back();
+      }
+      if (zoneOwnerStampByIndex_[static_cast<size_t>(idx)] != zoneOwnerGeneration_) {
+        zoneOwnerStampByIndex_[static_cast<size_t>(idx)] = zoneOwnerGeneration_;
+        touchedZoneIndices_.push_back(idx);
+      }
+    }
+  }
+}
+
+void SettlementManager::ResetZoneClaims() {
+  for (auto& claims : zoneClaims_) claims.clear();
+  std::fill(zoneOwnerByIndex_.begin(), zoneOwnerByIndex_.end(), -1);
+  std::fill(ownedZoneSlotByIndex_.begin(), ownedZoneSlotByIndex_.end(), -1);
   ownedZoneIndices_.clear();
+  appliedClaimSources_.clear();
+  claimSourcesDirty_ = true;
+}
+
+void SettlementManager::UpdateZoneOwners(const World& world) {
+  if (!claimSourcesDirty_) return;
+  claimSourcesDirty_ = false;
+  if (zonesX_ <= 0 || zonesY_ <= 0) return;
+
+  touchedZoneIndices_.clear();
   zoneOwnerGeneration_++;
   if (zoneOwnerGeneration_ == 0) {
     std::fill(zoneOwnerStampByIndex_.begin(), zoneOwnerStampByIndex_.end(), 0u);
     zoneOwnerGeneration_ = 1;
   }
-  if (settlements_.empty()) {
-    return;
+
+  // Diff each settlement's current sources against the ones already rasterized. Building tiles
+  // are unique, so sorted position order gives a clean merge.
+  auto sourceLess = [](const ClaimSource& a, const ClaimSource& b) {
+    if (a.y != b.y) return a.y < b.y;
+    if (a.x != b.x) return a.x < b.x;
+    return a.radius < b.radius;
+  };
+  const int settlementCount = std::max(static_cast<int>(claimSources_.size()),
+                                       static_cast<int>(appliedClaimSources_.size()));
+  if (static_cast<int>(appliedClaimSources_.size()) < settlementCount) {
+    appliedClaimSources_.resize(static_cast<size_t>(settlementCount));
+  }
+  static const std::vector<ClaimSource> kNoSources;
+  for (int i = 0; i < settlementCount; ++i) {
+    std::vector<ClaimSource>& applied = appliedClaimSources_[static_cast<size_t>(i)];
+    if (i < static_cast<int>(claimSources_.size())) {
+      std::sort(claimSources_[static_cast<size_t>(i)].begin(),
+                claimSources_[static_cast<size_t>(i)].end(), sourceLess);
+    }
+    const std::vector<ClaimSource>& current =
+        (i < static_cast<int>(claimSources_.size())) ? claimSources_[static_cast<size_t>(i)]
+                                                     : kNoSources;
+    size_t a = 0;
+    size_t c = 0;
+    while (a < applied.size() || c < current.size()) {
+      if (c >= current.size() || (a < applied.size() && sourceLess(applied[a], current[c]))) {
+        ApplyClaimSource(world, i, applied[a++], false);
+      } else if (a >= applied.size() || sourceLess(current[c], applied[a])) {
+        ApplyClaimSource(world, i, current[c++], true);
+      } else {
+        a++;
+        c++;
+      }
+    }
+    applied = current;
   }
-  if (zonesX_ <= 0 || zonesY_ <= 0) return;
 
-  for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
-    const Settlement& settlement = settlements_[i];
-    if (i >= static_cast<int>(claimSources_.size())) continue;
-    const auto& sources = claimSources_[i];
-    if (sources.empty()) continue;
-
-    for (const auto& source : sources) {
-      int radius = source.radius;
-      if (radius <= 0) continue;
-      int radiusSq = radius * radius;
-
-      int minZoneX = std::max(0, (source.x - radius) / zoneSize_);
-      int maxZoneX = std::min(zonesX_ - 1, (source.x + radius) / zoneSize_);
-      int minZoneY = std::max(0, (source.y - radius) / zoneSize_);
-      int maxZoneY = std::min(zonesY_ - 1, (source.y + radius) / zoneSize_);
-
-      for (int zy = minZoneY; zy <= maxZoneY; ++zy) {
-        int centerY = std::min(world.height() - 1, zy * zoneSize_ + zoneSize_ / 2);
-        for (int zx = minZoneX; zx <= maxZoneX; ++zx) {
-          int centerX = std::min(world.width() - 1, zx * zoneSize_ + zoneSize_ / 2);
-          int dx = source.x - centerX;
-          int dy = source.y - centerY;
-          int dist = dx * dx + dy * dy;
-          if (dist > radiusSq) continue;
-          int idx = zy * zonesX_ + zx;
-          if (idx < 0 || idx >= static_cast<int>(zoneOwnerStampByIndex_.size())) continue;
-          if (zoneOwnerStampByIndex_[static_cast<size_t>(idx)] != zoneOwnerGeneration_) {
-            zoneOwnerStampByIndex_[static_cast<size_t>(idx)] = zoneOwnerGeneration_;
-            zoneOwnerBestDistSqByIndex_[static_cast<size_t>(idx)] = dist;
-            zoneOwnerByIndex_[static_cast<size_t>(idx)] = settlement.id;
-            ownedZoneIndices_.push_back(idx);
-          } else if (dist < zoneOwnerBestDistSqByIndex_[static_cast<size_t>(idx)]) {
-            zoneOwnerBestDistSqByIndex_[static_cast<size_t>(idx)] = dist;
-            zoneOwnerByIndex_[static_cast<size_t>(idx)] = settlement.id;
-          }
-        }
+  // Nearest source wins; equal distances go to the lowest settlement index, as the old full
+  // rasterization in settlement order did.
+  for (int idx : touchedZoneIndices_) {
+    const std::vector<ZoneClaim>& claims = zoneClaims_[static_cast<size_t>(idx)];
+    int bestIndex = -1;
+    int bestDist = 0;
+    for (const ZoneClaim& claim : claims) {
+      if (bestIndex < 0 || claim.distSq < bestDist ||
+          (claim.distSq == bestDist && claim.settlementIndex < bestIndex)) {
+        bestIndex = claim.settlementIndex;
+        bestDist = claim.distSq;
+      }
+    }
+    int& slot = ownedZoneSlotByIndex_[static_cast<size_t>(idx)];
+    if (bestIndex >= 0 && bestIndex < static_cast<int>(settlements_.size())) {
+      zoneOwnerByIndex_[static_cast<size_t>(idx)] = settlements_[static_cast<size_t>(bestIndex)].id;
+      if (slot < 0) {
+        slot = static_cast<int>(ownedZoneIndices_.size());
+        ownedZoneIndices_.push_back(idx);
+      }
+    } else {
+      zoneOwnerByIndex_[static_cast<size_t>(idx)] = -1;
+      if (slot >= 0) {
+        const int moved = ownedZoneIndices_.back();
+        ownedZoneIndices_[static_cast<size_t>(slot)] = moved;
+        ownedZoneSlotByIndex_[static_cast<size_t>(moved)] = slot;
+        ownedZoneIndices_.pop_back();
+        slot = -1;
       }
     }
   }
@@ -651,17 +1154,16 @@ void SettlementManager::EnsureSettlementFactions(FactionManager& factions, Rando
 
     int nearestFactionId = 0;
     int nearestDistSq = std::numeric_limits<int>::max();
-    for (size_t j = 0; j < settlements_.size(); ++j) {
-      if (i == j) continue;
-      const Settlement& other = settlements_[j];
-      if (other.factionId <= 0 || !factions.Get(other.factionId)) continue;
-      int dx = other.centerX - settlement.centerX;
-      int dy = other.centerY - settlement.centerY;
-      int distSq = dx * dx + dy * dy;
-      if (distSq < nearestDistSq) {
-        nearestDistSq = distSq;
-        nearestFactionId = other.factionId;
-      }
+    const int nearestIndex = index_.Nearest(
+        settlement.centerX, settlement.centerY, DistanceMetric::EuclideanSq,
+        [&](int j) {
+          if (j == static_cast<int>(i)) return false;
+          const Settlement& other = settlements_[static_cast<size_t>(j)];
+          return other.factionId > 0 && factions.Get(other.factionId) != nullptr;
+        },
+        nearestDistSq);
+    if (nearestIndex >= 0) {
+      nearestFactionId = settlements_[static_cast<size_t>(nearestIndex)].factionId;
     }
 
     int assigned = 0;
@@ -679,17 +1181,22 @@ void SettlementManager::EnsureSettlementFactions(FactionManager& factions, Rando
     if (assigned == 0) {
       assigned = factions.CreateFaction(rng);
     }
-    settlement.factionId = assigned;
+    SetSettlementFaction(settlement, assigned);
   }
 }
 
-void SettlementManager::AssignHumansToSettlements(HumanManager& humans) {
+void SettlementManager::AssignHumansToSettlements(const World& world, HumanManager& humans) {
   idToIndex_.assign(nextId_, -1);
   for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
     idToIndex_[settlements_[i].id] = i;
   }
+  memberCounts_.assign(settlements_.size(), 0);
+  auto& humanList = humans.HumansMutable();
+  memberSlotByHuman_.assign(humanList.size(), -1);
+  humans.BeginDailyCensus(world.width(), world.height());
 
-  for (auto& human : humans.HumansMutable()) {
+  for (size_t i = 0; i < humanList.size(); ++i) {
+    Human& human = humanList[i];
     if (!human.alive) continue;
     int idx = (human.settlementId >= 0 && human.settlementId < static_cast<int>(idToIndex_.size()))
                   ? idToIndex_[human.settlementId]
@@ -707,16 +1214,22 @@ void SettlementManager::AssignHumansToSettlements(HumanManager& humans) {
 
     if (idx < 0) {
       human.role = Role::Idle;
-      continue;
+    } else {
+      human.homeX = settlements_[idx].centerX;
+      human.homeY = settlements_[idx].centerY;
+      memberSlotByHuman_[i] = idx;
+      memberCounts_[static_cast<size_t>(idx)]++;
     }
-    human.homeX = settlements_[idx].centerX;
-    human.homeY = settlements_[idx].centerY;
+    humans.CountForDailyCensus(human);
   }
 }
 
 void SettlementManager::RecomputeSettlementBuildings(const World& world) {
+  claimSourcesDirty_ = true;
+  buildingStatsCount_ = static_cast<int>(settlements_.size());
   if (settlements_.empty()) {
     claimSources_.clear();
+    buildingRegistries_.clear();
     return;
   }
   if (idToIndex_.size() != static_cast<size_t>(nextId_)) {
@@ -726,6 +1239,8 @@ void SettlementManager::RecomputeSettlementBuildings(const World& world) {
     }
   }
   claimSources_.assign(settlements_.size(), {});
+  buildingRegistries_.resize(settlements_.size());
+  for (BuildingRegistry& registry : buildingRegistries_) registry.Clear();
   for (auto& settlement : settlements_) {
     settlement.houses = 0;
     settlement.farms = 0;
@@ -748,6 +1263,7 @@ void SettlementManager::RecomputeSettlementBuildings(const World& world) {
     int idx = idToIndex_[ownerId];
     if (idx < 0 || idx >= static_cast<int>(settlements_.size())) continue;
     Settlement& settlement = settlements_[idx];
+    buildingRegistries_[static_cast<size_t>(idx)].Add(tile.building, x, y);
     switch (tile.building) {
       case BuildingType::House:
         settlement.houses++;
@@ -783,70 +1299,292 @@ void SettlementManager::RecomputeSettlementBuildings(const World& world) {
   UpdateSettlementCaps();
 }
 
-void SettlementManager::UpdateSettlementCaps() {
-  for (auto& settlement : settlements_) {
-    int houseCap = settlement.houses * HouseCapacityForTier(settlement.techTier);
-    int hallCap = settlement.townHalls * TownHallCapacityForTier(settlement.techTier);
-    settlement.housingCap = houseCap + hallCap;
+void SettlementManager::ApplyBuildingEvents(World& world) {
+  if (!world.ConsumeBuildingEvents(buildingEvents_) || settlements_.empty()) {
+    RecomputeSettlementBuildings(world);
+    return;
+  }
+  if (idToIndex_.size() != static_cast<size_t>(nextId_)) {
+    idToIndex_.assign(nextId_, -1);
+    for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
+      idToIndex_[settlements_[i].id] = i;
+    }
+  }
+  claimSources_.resize(settlements_.size());
+  buildingRegistries_.resize(settlements_.size());
+  influenceDirtyIndices_.clear();
+  // Settlements founded since the last update start from empty counters, as a rescan would.
+  for (int i = buildingStatsCount_; i < static_cast<int>(settlements_.size()); ++i) {
+    Settlement& settlement = settlements_[static_cast<size_t>(i)];
+    settlement.houses = 0;
+    settlement.farms = 0;
+    settlement.granaries = 0;
+    settlement.wells = 0;
+    settlement.farmsPlanted = 0;
+    settlement.farmsReady = 0;
+    settlement.townHalls = 0;
+    claimSources_[static_cast<size_t>(i)].clear();
+    buildingRegistries_[static_cast<size_t>(i)].Clear();
+    influenceDirtyIndices_.push_back(i);
+  }
+  buildingStatsCount_ = static_cast<int>(settlements_.size());
+
+  auto applyState = [&](int x, int y, const BuildingState& state, int sign) {
+    if (state.building == BuildingType::None) return;
+    if (state.ownerId < 0 || state.ownerId >= static_cast<int>(idToIndex_.size())) return;
+    int idx = idToIndex_[state.ownerId];
+    if (idx < 0 || idx >= static_cast<int>(settlements_.size())) return;
+    Settlement& settlement = settlements_[idx];
+    if (sign > 0) {
+      buildingRegistries_[static_cast<size_t>(idx)].Add(state.building, x, y);
+    } else {
+      buildingRegistries_[static_cast<size_t>(idx)].Remove(state.building, x, y);
+    }
+    switch (state.building) {
+      case BuildingType::House:
+        settlement.houses += sign;
+        break;
+      case BuildingType::Farm:
+        settlement.farms += sign;
+        if (state.farmStage > 0) settlement.farmsPlanted += sign;
+        if (state.farmStage >= Settlement::kFarmReadyStage) settlement.farmsReady += sign;
+        break;
+      case BuildingType::Granary:
+        settlement.granaries += sign;
+        break;
+      case BuildingType::Well:
+        settlement.wells += sign;
+        break;
+      case BuildingType::TownHall:
+        settlement.townHalls += sign;
+        break;
+      default:
+        break;
+    }
+    int radius = ClaimRadiusForBuilding(state.building);
+    if (radius <= 0) return;
+    std::vector<ClaimSource>& sources = claimSources_[static_cast<size_t>(idx)];
+    if (sign > 0) {
+      sources.push_back(ClaimSource{x, y, radius});
+      settlement.influenceRadius = std::max(settlement.influenceRadius, radius);
+    } else {
+      auto it = std::find_if(sources.begin(), sources.end(), [&](const ClaimSource& source) {
+        return source.x == x && source.y == y && source.radius == radius;
+      });
+      if (it == sources.end()) return;
+      *it = sources.back();
+      sources.pop_back();
+      influenceDirtyIndices_.push_back(idx);
+    }
+    claimSourcesDirty_ = true;
+  };
+
+  for (const BuildingEvent& event : buildingEvents_) {
+    applyState(event.x, event.y, event.before, -1);
+    applyState(event.x, event.y, event.after, 1);
+  }
+  for (int idx : influenceDirtyIndices_) {
+    int radius = 0;
+    for (const ClaimSource& source : claimSources_[static_cast<size_t>(idx)]) {
+      radius = std::max(radius, source.radius);
+    }
+    settlements_[static_cast<size_t>(idx)].influenceRadius = radius;
+  }
+
+#if FUNSIM_VERIFY_BUILDING_STATS
+  if (!VerifyBuildingStats(world)) {
+    RecomputeSettlementBuildings(world);
+    return;
   }
+#endif
+  UpdateSettlementCaps();
 }
 
-void SettlementManager::ComputeSettlementWaterTargets(const World& world) {
-  if (settlements_.empty()) return;
-  const int maxDistSq = kWaterSearchRadius * kWaterSearchRadius;
+bool SettlementManager::VerifyBuildingStats(const World& world) const {
+  struct Expected {
+    int houses = 0;
+    int farms = 0;
+    int granaries = 0;
+    int wells = 0;
+    int farmsPlanted = 0;
+    int farmsReady = 0;
+    int townHalls = 0;
+    int influenceRadius = 0;
+    std::vector<ClaimSource> sources;
+  };
+  std::vector<Expected> expected(settlements_.size());
+  for (uint64_t coord : world.BuildingTiles()) {
+    int x = static_cast<int>(static_cast<uint32_t>(coord >> 32));
+    int y = static_cast<int>(static_cast<uint32_t>(coord & 0xffffffffu));
+    const Tile& tile = world.At(x, y);
+    int ownerId = tile.buildingOwnerId;
+    if (ownerId < 0 || ownerId >= static_cast<int>(idToIndex_.size())) continue;
+    int idx = idToIndex_[ownerId];
+    if (idx < 0 || idx >= static_cast<int>(settlements_.size())) continue;
+    Expected& e = expected[static_cast<size_t>(idx)];
+    e.houses += (tile.building == BuildingType::House) ? 1 : 0;
+    e.farms += (tile.building == BuildingType::Farm) ? 1 : 0;
+    e.farmsPlanted += (tile.building == BuildingType::Farm && tile.farmStage > 0) ? 1 : 0;
+    e.farmsReady += (tile.building == BuildingType::Farm &&
+                     tile.farmStage >= Settlement::kFarmReadyStage) ? 1 : 0;
+    e.granaries += (tile.building == BuildingType::Granary) ? 1 : 0;
+    e.wells += (tile.building == BuildingType::Well) ? 1 : 0;
+    e.townHalls += (tile.building == BuildingType::TownHall) ? 1 : 0;
+    int radius = ClaimRadiusForBuilding(tile.building);
+    if (radius > 0) {
+      e.sources.push_back(ClaimSource{x, y, radius});
+      e.influenceRadius = std::max(e.influenceRadius, radius);
+    }
+  }
 
-  for (auto& settlement : settlements_) {
-    int bestX = -1;
-    int bestY = -1;
-    int bestDistSq = maxDistSq + 1;
-    for (int dy = -kWaterSearchRadius; dy <= kWaterSearchRadius; ++dy) {
-      int y = settlement.centerY + dy;
-      if (y < 0 || y >= world.height()) continue;
-      for (int dx = -kWaterSearchRadius; dx <= kWaterSearchRadius; ++dx) {
-        int x = settlement.centerX + dx;
-        if (x < 0 || x >= world.width()) continue;
-        const Tile& tile = world.At(x, y);
-        if (tile.type != TileType::FreshWater && world.WellRadiusAt(x, y) == 0) continue;
-        int distSq = dx * dx + dy * dy;
-        if (distSq < bestDistSq) {
-          bestDistSq = distSq;
-          bestX = x;
-          bestY = y;
+  auto sourceLess = [](const ClaimSource& a, const ClaimSource& b) {
+    if (a.y != b.y) return a.y < b.y;
+    if (a.x != b.x) return a.x < b.x;
+    return a.radius < b.radius;
+  };
+  bool ok = true;
+  for (size_t i = 0; i < settlements_.size(); ++i) {
+    const Settlement& s = settlements_[i];
+    Expected& e = expected[i];
+    std::vector<ClaimSource> actual =
+        (i < claimSources_.size()) ? claimSources_[i] : std::vector<ClaimSource>{};
+    std::sort(e.sources.begin(), e.sources.end(), sourceLess);
+    std::sort(actual.begin(), actual.end(), sourceLess);
+    bool sameSources = actual.size() == e.sources.size();
+    for (size_t k = 0; sameSources && k < actual.size(); ++k) {
+      sameSources = actual[k].x == e.sources[k].x && actual[k].y == e.sources[k].y &&
+                    actual[k].radius == e.sources[k].radius;
+    }
+    bool sameRegistry = i < buildingRegistries_.size();
+    if (sameRegistry) {
+      const BuildingRegistry& registry = buildingRegistries_[i];
+      sameRegistry = registry.houses.size() == static_cast<size_t>(e.houses) &&
+                     registry.farms.size() == static_cast<size_t>(e.farms) &&
+                     registry.granaries.size() == static_cast<size_t>(e.granaries) &&
+                     registry.wells.size() == static_cast<size_t>(e.wells);
+      for (BuildingType type : {BuildingType::House, BuildingType::Farm, BuildingType::Granary,
+                                BuildingType::Well}) {
+        for (uint64_t key : *registry.ListFor(type)) {
+          int x = 0;
+          int y = 0;
+          BuildingRegistry::Unpack(key, x, y);
+          const Tile& tile = world.At(x, y);
+          if (tile.building != type || tile.buildingOwnerId != s.id) sameRegistry = false;
         }
       }
     }
-    if (bestX != -1) {
-      settlement.hasWaterTarget = true;
-      settlement.waterTargetX = bestX;
-      settlement.waterTargetY = bestY;
-    } else {
-      settlement.hasWaterTarget = false;
-      settlement.waterTargetX = settlement.centerX;
-      settlement.waterTargetY = settlement.centerY;
+    if (s.houses != e.houses || s.farms != e.farms || s.granaries != e.granaries ||
+        s.wells != e.wells || s.farmsPlanted != e.farmsPlanted || s.farmsReady != e.farmsReady ||
+        s.townHalls != e.townHalls || s.influenceRadius != e.influenceRadius || !sameSources ||
+        !sameRegistry) {
+      std::fprintf(stderr,
+                   "building stats mismatch for settlement %d: houses %d/%d farms %d/%d "
+                   "planted %d/%d ready %d/%d granaries %d/%d wells %d/%d halls %d/%d "
+                   "influence %d/%d sources %zu/%zu registry %s\n",
+                   s.id, s.houses, e.houses, s.farms, e.farms, s.farmsPlanted, e.farmsPlanted,
+                   s.farmsReady, e.farmsReady, s.granaries, e.granaries, s.wells, e.wells,
+                   s.townHalls, e.townHalls, s.influenceRadius, e.influenceRadius,
+                   actual.size(), e.sources.size(), sameRegistry ? "ok" : "stale");
+      ok = false;
     }
   }
+  return ok;
 }
 
-void SettlementManager::RecomputeSettlementPopAndRoles(World& world, Random& rng, int dayCount,
-                                                       int dayDelta, HumanManager& humans,
-                                                       const FactionManager& factions) {
-  if (settlements_.empty()) return;
+void SettlementManager::UpdateSettlementCaps() {
+  for (auto& settlement : settlements_) {
+    int houseCap = settlement.houses * HouseCapacityForTier(settlement.techTier);
+    int hallCap = settlement.townHalls * TownHallCapacityForTier(settlement.techTier);
+    settlement.housingCap = houseCap + hallCap;
+  }
+}
 
-  if (memberCounts_.size() != settlements_.size()) {
-    memberCounts_.assign(settlements_.size(), 0);
+void SettlementManager::RebuildWaterRow(const World& world, int y) {
+  int* row = waterRowNearestX_.data() + static_cast<size_t>(y) * waterRowsWidth_;
+  int last = -1;
+  for (int x = 0; x < waterRowsWidth_; ++x) {
+    if (world.IsWaterSourceAt(x, y)) last = x;
+    row[x] = last;
+  }
+  int next = -1;
+  for (int x = waterRowsWidth_ - 1; x >= 0; --x) {
+    if (row[x] == x) next = x;
+    if (next != -1 && (row[x] == -1 || next - x < x - row[x])) row[x] = next;
+  }
+}
+
+void SettlementManager::ComputeSettlementWaterTargets(World& world) {
+  const bool incremental = world.ConsumeWaterSourceEvents(waterEvents_);
+  if (settlements_.empty()) {
+    waterRowsWidth_ = 0;
+    return;
+  }
+  const int maxDistSq = kWaterSearchRadius * kWaterSearchRadius;
+
+  if (!incremental || waterRowsWidth_ != world.width() || waterRowsHeight_ != world.height()) {
+    waterRowsWidth_ = world.width();
+    waterRowsHeight_ = world.height();
+    waterRowNearestX_.assign(static_cast<size_t>(waterRowsWidth_) * waterRowsHeight_, -1);
+    waterRowDirty_.assign(static_cast<size_t>(waterRowsHeight_), 0);
+    for (int y = 0; y < waterRowsHeight_; ++y) RebuildWaterRow(world, y);
+    waterTargetValid_.assign(settlements_.size(), 0);
   } else {
-    std::fill(memberCounts_.begin(), memberCounts_.end(), 0);
+    waterTargetValid_.resize(settlements_.size(), 0);
+    for (const WaterSourceEvent& event : waterEvents_) {
+      waterRowDirty_[static_cast<size_t>(event.y)] = 1;
+      waterDirtySettlements_.clear();
+      index_.WithinRadius(event.x, event.y, kWaterSearchRadius, DistanceMetric::EuclideanSq,
+                          waterDirtySettlements_);
+      for (int idx : waterDirtySettlements_) waterTargetValid_[static_cast<size_t>(idx)] = 0;
+    }
+    for (const WaterSourceEvent& event : waterEvents_) {
+      if (!waterRowDirty_[static_cast<size_t>(event.y)]) continue;
+      waterRowDirty_[static_cast<size_t>(event.y)] = 0;
+      RebuildWaterRow(world, event.y);
+    }
   }
 
-  for (const auto& human : humans.Humans()) {
-    if (!human.alive) continue;
-    if (human.settlementId == -1) continue;
-    int idx = (human.settlementId < static_cast<int>(idToIndex_.size()))
-                  ? idToIndex_[human.settlementId]
-                  : -1;
-    if (idx < 0) continue;
-    memberCounts_[idx]++;
+  for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
+    if (waterTargetValid_[static_cast<size_t>(i)]) continue;
+    waterTargetValid_[static_cast<size_t>(i)] = 1;
+    Settlement& settlement = settlements_[static_cast<size_t>(i)];
+    // Rows are scanned top-down with a strict "<" and each row keeps its leftmost nearest
+    // source, so ties resolve exactly as a row-major scan of the search square would.
+    int bestX = -1;
+    int bestY = -1;
+    int bestDistSq = maxDistSq + 1;
+    for (int dy = -kWaterSearchRadius; dy <= kWaterSearchRadius; ++dy) {
+      int y = settlement.centerY + dy;
+      if (y < 0 || y >= waterRowsHeight_) continue;
+      const int x =
+          waterRowNearestX_[static_cast<size_t>(y) * waterRowsWidth_ + settlement.centerX];
+      if (x == -1) continue;
+      const int dx = x - settlement.centerX;
+      int distSq = dx * dx + dy * dy;
+      if (distSq < bestDistSq) {
+        bestDistSq = distSq;
+        bestX = x;
+        bestY = y;
+      }
+    }
+    if (bestX != -1) {
+      settlement.hasWaterTarget = true;
+      settlement.waterTargetX = bestX;
+      settlement.waterTargetY = bestY;
+    } else {
+      settlement.hasWaterTarget = false;
+      settlement.waterTargetX = settlement.centerX;
+      settlement.waterTargetY = settlement.centerY;
+    }
   }
+}
+
+void SettlementManager::RecomputeSettlementPopAndRoles(World& world, Random& rng, int dayCount,
+                                                       int dayDelta, HumanManager& humans,
+                                                       const FactionManager& factions) {
+  if (settlements_.empty()) return;
+  // Member counts and each human's settlement come from AssignHumansToSettlements, so the
+  // scatter below reads the compact memberSlotByHuman_ instead of the humans themselves.
 
   int totalMembers = 0;
   if (memberOffsets_.size() != settlements_.size() + 1) {
@@ -875,13 +1613,8 @@ void SettlementManager::RecomputeSettlementPopAndRoles(World& world, Random& rng
     memberCounts_[i] = 0;
   }
 
-  for (int i = 0; i < static_cast<int>(humans.Humans().size()); ++i) {
-    const auto& human = humans.Humans()[i];
-    if (!human.alive) continue;
-    if (human.settlementId == -1) continue;
-    int idx = (human.settlementId < static_cast<int>(idToIndex_.size()))
-                  ? idToIndex_[human.settlementId]
-                  : -1;
+  for (int i = 0; i < static_cast<int>(memberSlotByHuman_.size()); ++i) {
+    const int idx = memberSlotByHuman_[static_cast<size_t>(i)];
     if (idx < 0) continue;
     int write = memberOffsets_[idx] + memberCounts_[idx]++;
     if (write >= 0 && write < static_cast<int>(memberIndices_.size())) {
@@ -889,10 +1622,14 @@ void SettlementManager::RecomputeSettlementPopAndRoles(World& world, Random& rng
     }
   }
 
-  for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
+  // Each settlement only writes its own counters and its own members' roles.
+  ParallelForSettlements([&](int i) {
     Settlement& settlement = settlements_[i];
+    // Role targeting is where soldiers are raised and stood down, so the army roster is rebuilt
+    // here; between passes it only gains war-start mobilizations and drops the dead lazily.
+    settlement.armyRoster.clear();
     int pop = settlement.population;
-    if (pop <= 0) continue;
+    if (pop <= 0) return;
 
     int warId = factions.ActiveWarIdForFaction(settlement.factionId);
     const bool isAtWar = (warId > 0);
@@ -1084,7 +1821,7 @@ void SettlementManager::RecomputeSettlementPopAndRoles(World& world, Random& rng
 
     int start = memberOffsets_[i];
     int end = memberOffsets_[i + 1];
-    if (end <= start) continue;
+    if (end <= start) return;
 
     int total = end - start;
     uint32_t hash = Hash32(static_cast<uint32_t>(settlement.id), static_cast<uint32_t>(dayCount));
@@ -1093,58 +1830,53 @@ void SettlementManager::RecomputeSettlementPopAndRoles(World& world, Random& rng
     }
     int offset = static_cast<int>(hash % static_cast<uint32_t>(total));
 
-    std::vector<int> ordered;
-    ordered.reserve(total);
-    for (int local = 0; local < total; ++local) {
-      int idxInList = start + (offset + local) % total;
-      ordered.push_back(memberIndices_[idxInList]);
-    }
-
-    std::vector<int> unlocked;
-    unlocked.reserve(total);
+    // Members are visited from a rotating offset without materializing the order. At war,
+    // sitting soldiers keep their role and only the others take slots.
+    auto& humanList = humans.HumansMutable();
+    auto memberAt = [&](int local) -> Human* {
+      int humanIndex = memberIndices_[start + (offset + local) % total];
+      if (humanIndex < 0 || humanIndex >= static_cast<int>(humanList.size())) return nullptr;
+      return &humanList[humanIndex];
+    };
     int lockedCount = 0;
     if (isAtWar) {
-      for (int humanIndex : ordered) {
-        if (humanIndex < 0 || humanIndex >= static_cast<int>(humans.HumansMutable().size())) continue;
-        auto& human = humans.HumansMutable()[humanIndex];
-        if (!human.alive) continue;
-        if (human.role == Role::Soldier) {
-          human.role = Role::Soldier;
-          lockedCount++;
-        } else {
-          unlocked.push_back(humanIndex);
-        }
+      for (int local = 0; local < total; ++local) {
+        const Human* human = memberAt(local);
+        if (human && human->alive && human->role == Role::Soldier) lockedCount++;
       }
-    } else {
-      unlocked = ordered;
     }
 
     int soldiersToAssign = isAtWar ? std::max(0, soldiers - lockedCount) : soldiers;
 
-    for (int idx = 0; idx < static_cast<int>(unlocked.size()); ++idx) {
-      int humanIndex = unlocked[idx];
-      if (humanIndex < 0 || humanIndex >= static_cast<int>(humans.HumansMutable().size())) continue;
-      auto& human = humans.HumansMutable()[humanIndex];
-      if (!human.alive) continue;
+    int slot = 0;
+    for (int local = 0; local < total; ++local) {
+      Human* human = memberAt(local);
+      if (isAtWar && (!human || !human->alive || human->role == Role::Soldier)) {
+        if (human && human->alive) settlement.armyRoster.push_back(human->id);
+        continue;
+      }
+      const int idx = slot++;
+      if (!human || !human->alive) continue;
 
       if (idx < farmers) {
-        human.role = Role::Farmer;
+        human->role = Role::Farmer;
       } else if (idx < farmers + gatherers) {
-        human.role = Role::Gatherer;
+        human->role = Role::Gatherer;
       } else if (idx < farmers + gatherers + builders) {
-        human.role = Role::Builder;
+        human->role = Role::Builder;
       } else if (idx < farmers + gatherers + builders + soldiersToAssign) {
-        human.role = Role::Soldier;
+        human->role = Role::Soldier;
+        settlement.armyRoster.push_back(human->id);
       } else if (idx < farmers + gatherers + builders + soldiersToAssign + guards) {
-        human.role = Role::Guard;
+        human->role = Role::Guard;
       } else if (idx < farmers + gatherers + builders + soldiersToAssign + guards + scouts) {
-        human.role = Role::Scout;
+        human->role = Role::Scout;
       } else {
-        human.role = Role::Idle;
+        human->role = Role::Idle;
       }
     }
-
-  }
+    std::sort(settlement.armyRoster.begin(), settlement.armyRoster.end());
+  });
   (void)rng;
 }
 
@@ -1154,9 +1886,10 @@ void SettlementManager::UpdateCapitalStatus(const FactionManager& factions) {
   }
   if (settlements_.empty() || factions.Count() == 0) return;
 
-  std::vector<int> bestPop(factions.Count() + 1, -1);
-  std::vector<int> bestAge(factions.Count() + 1, -1);
-  std::vector<int> bestSettlement(factions.Count() + 1, -1);
+  const size_t slots = static_cast<size_t>(factions.Count()) + 1;
+  std::pmr::vector<int> bestPop(slots, -1, &SimFrameArena());
+  std::pmr::vector<int> bestAge(slots, -1, &SimFrameArena());
+  std::pmr::vector<int> bestSettlement(slots, -1, &SimFrameArena());
 
   for (const auto& settlement : settlements_) {
     if (settlement.factionId <= 0) continue;
@@ -1443,18 +2176,28 @@ void SettlementManager::UpdateArmiesAndSieges(World& world, HumanManager& humans
     return home ? home->factionId : -1;
   };
 
-  std::vector<std::vector<int>> soldiersByTerritory(settlements_.size());
-  for (int humanIndex = 0; humanIndex < static_cast<int>(humanList.size()); ++humanIndex) {
-    const Human& human = humanList[humanIndex];
-    if (!human.alive) continue;
-    if (human.role != Role::Soldier) continue;
-    int territorySettlementId = ZoneOwnerForTile(human.x, human.y);
-    if (territorySettlementId <= 0) continue;
-    int territoryIdx = (territorySettlementId < static_cast<int>(idToIndex_.size()))
-                           ? idToIndex_[territorySettlementId]
-                           : -1;
-    if (territoryIdx < 0 || territoryIdx >= static_cast<int>(soldiersByTerritory.size())) continue;
-    soldiersByTerritory[territoryIdx].push_back(humanIndex);
+  // Every living soldier is on its settlement's roster (rebuilt by the role pass and compacted
+  // by UpdateArmyOrders), so territories are filled from the rosters rather than all humans and
+  // then put back in human index order.
+  FrameArena& arena = SimFrameArena();
+  std::pmr::vector<std::pmr::vector<int>> soldiersByTerritory(settlements_.size(), &arena);
+  for (const Settlement& home : settlements_) {
+    for (int id : home.armyRoster) {
+      const Human* human = humans.FindById(id);
+      if (!human || human->role != Role::Soldier) continue;
+      int territorySettlementId = ZoneOwnerForTile(human->x, human->y);
+      if (territorySettlementId <= 0) continue;
+      int territoryIdx = (territorySettlementId < static_cast<int>(idToIndex_.size()))
+                             ? idToIndex_[territorySettlementId]
+                             : -1;
+      if (territoryIdx < 0 || territoryIdx >= static_cast<int>(soldiersByTerritory.size())) {
+        continue;
+      }
+      soldiersByTerritory[territoryIdx].push_back(static_cast<int>(human - humanList.data()));
+    }
+  }
+  for (auto& soldierHere : soldiersByTerritory) {
+    std::sort(soldierHere.begin(), soldierHere.end());
   }
 
   for (int si = 0; si < static_cast<int>(settlements_.size()); ++si) {
@@ -1462,11 +2205,11 @@ void SettlementManager::UpdateArmiesAndSieges(World& world, HumanManager& humans
     const int ownerFactionId = settlement.factionId;
     if (ownerFactionId <= 0) continue;
 
-    std::vector<int>& soldierHere = soldiersByTerritory[si];
+    std::pmr::vector<int>& soldierHere = soldiersByTerritory[si];
     if (soldierHere.empty() && settlement.captureProgress <= 0.0f) continue;
 
-    std::vector<int> attackers;
-    std::vector<int> defenders;
+    std::pmr::vector<int> attackers(&arena);
+    std::pmr::vector<int> defenders(&arena);
     int bestEnemyFaction = -1;
     int bestEnemyForce = 0;
     int bestEnemyCoreFaction = -1;
@@ -1475,8 +2218,8 @@ void SettlementManager::UpdateArmiesAndSieges(World& world, HumanManager& humans
     int defendersInCore = 0;
     int attackersInCore = 0;
 
-    std::unordered_map<int, int> enemyForceByFaction;
-    std::unordered_map<int, int> enemyCoreForceByFaction;
+    std::pmr::unordered_map<int, int> enemyForceByFaction(&arena);
+    std::pmr::unordered_map<int, int> enemyCoreForceByFaction(&arena);
     auto inCore = [&](const Human& h) -> bool {
       return (h.x == settlement.centerX && h.y == settlement.centerY);
     };
@@ -1623,7 +2366,7 @@ void SettlementManager::UpdateArmiesAndSieges(World& world, HumanManager& humans
 	    if (settlement.captureProgress >= 100.0f && settlement.captureLeaderFactionId > 0) {
 	      const int resolvedWarId = settlement.captureWarId;
 	      int newFactionId = settlement.captureLeaderFactionId;
-	      settlement.factionId = newFactionId;
+	      SetSettlementFaction(settlement, newFactionId);
 	      settlement.captureProgress = 0.0f;
 	      settlement.captureLeaderFactionId = -1;
 	      settlement.captureWarId = -1;
@@ -1819,6 +2562,7 @@ void SettlementManager::MobilizeForWarStart(HumanManager& humans, Random& rng, c
         if (human.role == Role::Soldier) continue;
         human.role = Role::Soldier;
         human.hasTask = false;
+        AddToArmyRoster(human);
         soldierIndices.push_back(humanIndex);
       }
     };
@@ -1839,85 +2583,112 @@ void SettlementManager::MobilizeForWarStart(HumanManager& humans, Random& rng, c
   }
 }
 
+void SettlementManager::AddToArmyRoster(const Human& human) {
+  Settlement* home = GetMutable(human.settlementId);
+  if (!home) return;
+  std::vector<int>& roster = home->armyRoster;
+  auto it = std::lower_bound(roster.begin(), roster.end(), human.id);
+  if (it == roster.end() || *it != human.id) roster.insert(it, human.id);
+}
+
 void SettlementManager::UpdateArmyOrders(World& world, HumanManager& humans, Random& rng, int dayCount,
                                          int dayDelta, FactionManager& factions) {
   if (settlements_.empty()) return;
   if (dayDelta < 1) dayDelta = 1;
 
-  auto& humanList = humans.HumansMutable();
-  for (auto& human : humanList) {
-    if (!human.alive) continue;
-    human.isGeneral = false;
-    human.armyState = ArmyState::Idle;
-    human.warId = -1;
-    human.warTargetSettlementId = -1;
-    human.formationSlot = 0;
-  }
-
-  auto anyPopulatedEnemySettlement = [&](int warId, int settlementFactionId) -> bool {
+  for (int id : armyOrderIds_) {
+    Human* human = humans.FindByIdMutable(id);
+    if (!human) continue;
+    human->isGeneral = false;
+    human->armyState = ArmyState::Idle;
+    human->warId = -1;
+    human->warTargetSettlementId = -1;
+    human->formationSlot = 0;
+  }
+  armyOrderIds_.clear();
+
+  // Populations, capitals and tech tiers only move between calls, so each war side's enemy list
+  // is built once here instead of being rescanned for every settlement and validity check.
+  warTargetListCount_ = 0;
+  auto warTargetsFor = [&](int warId, int settlementFactionId) -> const WarTargetList* {
     const War* war = factions.GetWar(warId);
-    if (!war || !war->active) return false;
+    if (!war || !war->active) return nullptr;
     const bool attacker = factions.WarIsAttacker(warId, settlementFactionId);
+    for (int i = 0; i < warTargetListCount_; ++i) {
+      const WarTargetList& list = warTargetLists_[static_cast<size_t>(i)];
+      if (list.warId == warId && list.attackerSide == attacker) return &list;
+    }
+    if (warTargetListCount_ == static_cast<int>(warTargetLists_.size())) {
+      warTargetLists_.emplace_back();
+    }
+    WarTargetList& list = warTargetLists_[static_cast<size_t>(warTargetListCount_++)];
+    list.warId = warId;
+    list.attackerSide = attacker;
+    list.preferPopulated = false;
+    list.candidates.clear();
     const std::vector<int>& enemyFactions = attacker ? war->defenders.factions : war->attackers.factions;
-    if (enemyFactions.empty()) return false;
-    for (const auto& candidate : settlements_) {
-      if (candidate.population <= 0) continue;
-      if (std::find(enemyFactions.begin(), enemyFactions.end(), candidate.factionId) == enemyFactions.end()) {
-        continue;
+    for (int enemyFactionId : enemyFactions) {
+      for (int index : index_.FactionMembers(enemyFactionId)) {
+        if (settlements_[static_cast<size_t>(index)].population > 0) list.preferPopulated = true;
+      }
+    }
+    for (int enemyFactionId : enemyFactions) {
+      for (int index : index_.FactionMembers(enemyFactionId)) {
+        const Settlement& candidate = settlements_[static_cast<size_t>(index)];
+        if (list.preferPopulated && candidate.population <= 0) continue;
+        int value = candidate.population * 3 + (candidate.isCapital ? 60 : 0) +
+                    candidate.techTier * 10;
+        list.candidates.push_back({index, value});
       }
-      return true;
     }
-    return false;
+    std::sort(list.candidates.begin(), list.candidates.end(),
+              [](const WarTargetCandidate& a, const WarTargetCandidate& b) {
+                return (a.value != b.value) ? (a.value > b.value) : (a.index < b.index);
+              });
+    return &list;
   };
 
   auto pickWarTarget = [&](const Settlement& from, int warId) -> int {
-    const War* war = factions.GetWar(warId);
-    if (!war || !war->active) return -1;
-    const bool attacker = factions.WarIsAttacker(warId, from.factionId);
-    const std::vector<int>& enemyFactions = attacker ? war->defenders.factions : war->attackers.factions;
-    if (enemyFactions.empty()) return -1;
-    const bool preferPopulated = anyPopulatedEnemySettlement(warId, from.factionId);
+    const WarTargetList* list = warTargetsFor(warId, from.factionId);
+    if (!list) return -1;
 
-    int bestTarget = -1;
+    // Ties go to the lowest settlement index, as in a front-to-back scan of settlements_.
+    int bestIndex = -1;
     int bestScore = std::numeric_limits<int>::min();
     int bestDist = std::numeric_limits<int>::max();
-    for (const auto& candidate : settlements_) {
+    for (const WarTargetCandidate& entry : list->candidates) {
+      const Settlement& candidate = settlements_[static_cast<size_t>(entry.index)];
+      if (from.borderPressure <= 0 && entry.value * 6 < bestScore) break;
       if (candidate.id == from.id) continue;
-      if (preferPopulated && candidate.population <= 0) continue;
-      if (std::find(enemyFactions.begin(), enemyFactions.end(), candidate.factionId) == enemyFactions.end()) {
-        continue;
-      }
       int dx = candidate.centerX - from.centerX;
       int dy = candidate.centerY - from.centerY;
       int dist = std::abs(dx) + std::abs(dy);
       if (from.borderPressure > 0) {
-        if (dist < bestDist) {
+        if (dist < bestDist || (dist == bestDist && entry.index < bestIndex)) {
           bestDist = dist;
-          bestTarget = candidate.id;
+          bestIndex = entry.index;
         }
         continue;
       }
-      int value = candidate.population * 3 + (candidate.isCapital ? 60 : 0) + candidate.techTier * 10;
-      int score = value * 6 - dist * 25;
-      if (score > bestScore) {
+      int score = entry.value * 6 - dist * 25;
+      if (score > bestScore || (score == bestScore && entry.index < bestIndex)) {
         bestScore = score;
-        bestTarget = candidate.id;
+        bestIndex = entry.index;
       }
     }
-    return bestTarget;
+    return (bestIndex >= 0) ? settlements_[static_cast<size_t>(bestIndex)].id : -1;
   };
 
   auto isValidWarFocusTarget = [&](int warId, int settlementFactionId, int targetSettlementId) -> bool {
     if (targetSettlementId <= 0) return false;
-    const War* war = factions.GetWar(warId);
-    if (!war || !war->active) return false;
+    const WarTargetList* list = warTargetsFor(warId, settlementFactionId);
+    if (!list) return false;
     const Settlement* target = Get(targetSettlementId);
     if (!target) return false;
-    const bool attacker = factions.WarIsAttacker(warId, settlementFactionId);
-    const std::vector<int>& enemyFactions = attacker ? war->defenders.factions : war->attackers.factions;
-    if (enemyFactions.empty()) return false;
-    const bool preferPopulated = anyPopulatedEnemySettlement(warId, settlementFactionId);
-    if (preferPopulated && target->population <= 0) return false;
+    if (list->preferPopulated && target->population <= 0) return false;
+    const War* war = factions.GetWar(warId);
+    const std::vector<int>& enemyFactions =
+        list->attackerSide ? war->defenders.factions : war->attackers.factions;
     return std::find(enemyFactions.begin(), enemyFactions.end(), target->factionId) != enemyFactions.end();
   };
 
@@ -1935,20 +2706,11 @@ void SettlementManager::UpdateArmyOrders(World& world, HumanManager& humans, Ran
   };
 
   auto isValidWarTarget = [&](const Settlement& from, int warId, int targetSettlementId) -> bool {
-    if (targetSettlementId <= 0) return false;
-    const War* war = factions.GetWar(warId);
-    if (!war || !war->active) return false;
-    const Settlement* target = Get(targetSettlementId);
-    if (!target) return false;
-    if (target->id == from.id) return false;
-    const bool attacker = factions.WarIsAttacker(warId, from.factionId);
-    const std::vector<int>& enemyFactions = attacker ? war->defenders.factions : war->attackers.factions;
-    if (enemyFactions.empty()) return false;
-    const bool preferPopulated = anyPopulatedEnemySettlement(warId, from.factionId);
-    if (preferPopulated && target->population <= 0) return false;
-    return std::find(enemyFactions.begin(), enemyFactions.end(), target->factionId) != enemyFactions.end();
+    if (targetSettlementId == from.id) return false;
+    return isValidWarFocusTarget(warId, from.factionId, targetSettlementId);
   };
 
+  bool anyAtWar = false;
   for (int si = 0; si < static_cast<int>(settlements_.size()); ++si) {
     Settlement& settlement = settlements_[si];
     int warId = factions.ActiveWarIdForFaction(settlement.factionId);
@@ -1957,82 +2719,85 @@ void SettlementManager::UpdateArmyOrders(World& world, HumanManager& humans, Ran
     if (warId <= 0) {
       settlement.warTargetSettlementId = -1;
       settlement.hasDefenseTarget = false;
-    } else {
-      const bool attacker = factions.WarIsAttacker(warId, settlement.factionId);
-      if (!attacker) {
-        settlement.warTargetSettlementId = -1;
-        settlement.hasDefenseTarget = false;
-        // Defenders rally to the current battleground (war focus target).
-        const War* war = factions.GetWar(warId);
-        if (war && war->active && war->focusTargetSettlementId > 0) {
-          const Settlement* target = Get(war->focusTargetSettlementId);
-          if (target) {
-            settlement.defenseTargetX = target->centerX;
-            settlement.defenseTargetY = target->centerY;
-            settlement.hasDefenseTarget = true;
-          }
+      continue;
+    }
+    anyAtWar = true;
+    const bool attacker = factions.WarIsAttacker(warId, settlement.factionId);
+    if (!attacker) {
+      settlement.warTargetSettlementId = -1;
+      settlement.hasDefenseTarget = false;
+      // Defenders rally to the current battleground (war focus target).
+      const War* war = factions.GetWar(warId);
+      if (war && war->active && war->focusTargetSettlementId > 0) {
+        const Settlement* target = Get(war->focusTargetSettlementId);
+        if (target) {
+          settlement.defenseTargetX = target->centerX;
+          settlement.defenseTargetY = target->centerY;
+          settlement.hasDefenseTarget = true;
         }
-      } else if (!isValidWarTarget(settlement, warId, settlement.warTargetSettlementId)) {
-        int focus = ensureWarFocusTarget(warId, settlement);
-        settlement.warTargetSettlementId = (focus > 0) ? focus : pickWarTarget(settlement, warId);
+      }
+    } else if (!isValidWarTarget(settlement, warId, settlement.warTargetSettlementId)) {
+      int focus = ensureWarFocusTarget(warId, settlement);
+      settlement.warTargetSettlementId = (focus > 0) ? focus : pickWarTarget(settlement, warId);
+      settlement.lastWarOrderDay = dayCount;
+    } else {
+      // Force attacker settlements to share a single war focus target once it's set.
+      int focus = ensureWarFocusTarget(warId, settlement);
+      if (focus > 0 && settlement.warTargetSettlementId != focus) {
+        settlement.warTargetSettlementId = focus;
         settlement.lastWarOrderDay = dayCount;
-      } else {
-        // Force attacker settlements to share a single war focus target once it's set.
-        int focus = ensureWarFocusTarget(warId, settlement);
-        if (focus > 0 && settlement.warTargetSettlementId != focus) {
-          settlement.warTargetSettlementId = focus;
-          settlement.lastWarOrderDay = dayCount;
-        }
       }
     }
+  }
 
-    std::vector<int> soldierIndices;
-    int start = (si < static_cast<int>(memberOffsets_.size())) ? memberOffsets_[si] : 0;
-    int end = (si + 1 < static_cast<int>(memberOffsets_.size())) ? memberOffsets_[si + 1] : 0;
-    for (int mi = start; mi < end; ++mi) {
-      int humanIndex = memberIndices_[mi];
-      if (humanIndex < 0 || humanIndex >= static_cast<int>(humanList.size())) continue;
-      Human& human = humanList[humanIndex];
+  // Allow soldiers to target civilians belonging to a warring settlement.
+  // (Combat uses warId to identify enemies without needing faction graph access.)
+  if (anyAtWar) {
+    for (auto& human : humans.HumansMutable()) {
       if (!human.alive) continue;
-      // Allow soldiers to target civilians belonging to a warring settlement.
-      // (Combat uses warId to identify enemies without needing faction graph access.)
-      human.warId = warId;
-      if (human.role != Role::Soldier) continue;
-      soldierIndices.push_back(humanIndex);
+      const Settlement* home = Get(human.settlementId);
+      if (!home || home->warId <= 0) continue;
+      human.warId = home->warId;
+      armyOrderIds_.push_back(human.id);
     }
+  }
 
-    std::sort(soldierIndices.begin(), soldierIndices.end(),
-              [&](int a, int b) { return humanList[a].id < humanList[b].id; });
-
-    for (int pos = 0; pos < static_cast<int>(soldierIndices.size()); ++pos) {
-      int idx = soldierIndices[pos];
-      Human& human = humanList[idx];
-      human.warId = warId;
-      human.warTargetSettlementId = settlement.warTargetSettlementId;
-      human.formationSlot = pos;
+  for (auto& settlement : settlements_) {
+    const int warId = settlement.warId;
+    const bool attacker = (warId > 0) && factions.WarIsAttacker(warId, settlement.factionId);
+    std::vector<int>& roster = settlement.armyRoster;
+    int pos = 0;
+    for (int ri = 0; ri < static_cast<int>(roster.size()); ++ri) {
+      Human* human = humans.FindByIdMutable(roster[static_cast<size_t>(ri)]);
+      if (!human || human->settlementId != settlement.id || human->role != Role::Soldier) continue;
+      roster[static_cast<size_t>(pos)] = human->id;
+      human->warId = warId;
+      human->warTargetSettlementId = settlement.warTargetSettlementId;
+      human->formationSlot = pos++;
+      armyOrderIds_.push_back(human->id);
 
       if (warId <= 0) {
-        human.armyState = ArmyState::Idle;
+        human->armyState = ArmyState::Idle;
         continue;
       }
 
-      const bool attacker = factions.WarIsAttacker(warId, settlement.factionId);
       if (attacker) {
         if (settlement.warTargetSettlementId <= 0) {
-          human.armyState = ArmyState::Defend;
+          human->armyState = ArmyState::Defend;
           continue;
         }
         int daysSinceOrder = std::max(0, dayCount - settlement.lastWarOrderDay);
         int rallyDays = (dayDelta > 1) ? 0 : 2;
-        human.armyState = (daysSinceOrder < rallyDays) ? ArmyState::Rally : ArmyState::March;
-        int owner = ZoneOwnerForTile(human.x, human.y);
+        human->armyState = (daysSinceOrder < rallyDays) ? ArmyState::Rally : ArmyState::March;
+        int owner = ZoneOwnerForTile(human->x, human->y);
         if (owner == settlement.warTargetSettlementId) {
-          human.armyState = ArmyState::Siege;
+          human->armyState = ArmyState::Siege;
         }
       } else {
-        human.armyState = ArmyState::Defend;
+        human->armyState = ArmyState::Defend;
       }
     }
+    roster.resize(static_cast<size_t>(pos));
   }
   (void)world;
   (void)rng;
@@ -2153,7 +2918,7 @@ void SettlementManager::UpdateArmiesAndSiegesMacro(World& world, Random& rng, in
     }
 
     if (target->captureProgress >= 100.0f && target->captureLeaderFactionId > 0) {
-      target->factionId = target->captureLeaderFactionId;
+      SetSettlementFaction(*target, target->captureLeaderFactionId);
       target->captureProgress = 0.0f;
       target->captureLeaderFactionId = -1;
       target->captureWarId = -1;
@@ -2192,7 +2957,7 @@ void SettlementManager::ApplyConflictImpact(World& world, HumanManager& humans,
       if (rng.Chance(chance)) {
         int parentFaction = settlement.factionId;
         int newFaction = factions.CreateFaction(rng);
-        settlement.factionId = newFaction;
+        SetSettlementFaction(settlement, newFaction);
         settlement.unrest = 0;
         settlement.stability = 60;
         factions.SetWar(parentFaction, newFaction, true, dayCount, parentFaction);
@@ -2208,7 +2973,7 @@ void SettlementManager::ApplyConflictImpactMacro(World& world, Random& rng, int
   if (settlements_.empty()) return;
 
   for (auto& settlement : settlements_) {
-    int pop = settlement.MacroTotal();
+    int pop = MacroTotal(settlement);
     if (pop <= 0) continue;
     int warPressure = settlement.warPressure;
     if (warPressure > 0) {
@@ -2219,617 +2984,670 @@ void SettlementManager::ApplyConflictImpactMacro(World& world, Random& rng, int
     if (rebellionsEnabled_ &&
         settlement.unrest >= kRebellionUnrestDays &&
         settlement.stability <= kRebellionStabilityThreshold &&
-        settlement.MacroTotal() >= kRebellionMinPop && settlement.factionId > 0) {
+        MacroTotal(settlement) >= kRebellionMinPop && settlement.factionId > 0) {
       float chance = static_cast<float>(kRebellionStabilityThreshold - settlement.stability) / 200.0f;
       if (rng.Chance(chance)) {
         int parentFaction = settlement.factionId;
         int newFaction = factions.CreateFaction(rng);
-        settlement.factionId = newFaction;
+        SetSettlementFaction(settlement, newFaction);
         settlement.unrest = 0;
         settlement.stability = 60;
         factions.SetWar(parentFaction, newFaction, true, dayCount, parentFaction);
       }
     }
-    settlement.population = settlement.MacroTotal();
+    settlement.population = MacroTotal(settlement);
   }
   (void)dayCount;
   (void)world;
 }
 
 void SettlementManager::GenerateTasks(World& world, Random& rng, const FactionManager& factions, int dayCount) {
+  (void)factions;
+  // Each settlement draws from its own stream and pushes only to its own queue, so the queued
+  // tasks do not depend on how settlements are split across workers.
+  const uint64_t high = rng.NextU32();
+  const uint64_t seed = (high << 32) | rng.NextU32();
+  world.EnsureWellRadius();
   for (auto& settlement : settlements_) {
-    int pop = settlement.population;
-    if (pop <= 0) continue;
+    if (settlement.population > 0) AcquireTasks(settlement);
+  }
+  ParallelForSettlements([&](int i) {
+    Settlement& settlement = settlements_[static_cast<size_t>(i)];
+    Random settlementRng = Random::Stream(seed, static_cast<uint64_t>(settlement.id),
+                                          static_cast<uint64_t>(dayCount), RngPurpose::Tasks);
+    GenerateSettlementTasks(settlement, world, settlementRng);
+  });
+}
 
-    int taskCount = settlement.TaskCount();
-    int available = Settlement::kTaskCap - 1 - taskCount;
-    if (available <= 0) continue;
+void SettlementManager::GenerateSettlementTasks(Settlement& settlement, const World& world,
+                                                Random& rng) {
+  int pop = settlement.population;
+  if (pop <= 0) return;
+
+  // Claims are nearest-first and emergencies keep non-food work queued, so far or outdated tasks
+  // would otherwise sit in the store until it fills and every producer stops.
+  TaskStore& store = AcquireTasks(settlement);
+  store.BeginRound();
+  store.DropStale(kTaskMaxAgeRounds, [&](const Task& task) {
+    if (!world.InBounds(task.x, task.y)) return false;
+    const Tile& tile = world.At(task.x, task.y);
+    switch (task.type) {
+      case TaskType::CollectFood:
+        return tile.food > 0 && !tile.burning;
+      case TaskType::CollectWood:
+        return tile.trees > 0 && !tile.burning;
+      case TaskType::HarvestFarm:
+        return tile.building == BuildingType::Farm && tile.buildingOwnerId == settlement.id &&
+               tile.farmStage >= Settlement::kFarmReadyStage;
+      case TaskType::PlantFarm:
+        return tile.building == BuildingType::Farm && tile.buildingOwnerId == settlement.id &&
+               tile.farmStage == 0;
+      case TaskType::BuildStructure:
+        return IsBuildableTileForSettlement(world, *this, settlement.id, task.x, task.y);
+      default:
+        return true;
+    }
+  });
+
+  int taskCount = TaskCount(settlement);
+  int available = Settlement::kTaskCap - 1 - taskCount;
+  if (available <= 0) return;
+
+  bool foodEmergency = settlement.stockFood < pop * kEmergencyFoodPerPop;
+  if (taskCount > Settlement::kTaskCap / 2 && !foodEmergency) return;
+
+  int desiredFood = pop * kDesiredFoodPerPop;
+  int desiredWood = pop * kDesiredWoodPerPop;
+  int farmsPerPop = FarmsPerPopForTier(settlement.techTier);
+  int desiredFarms = std::max(1, (pop + farmsPerPop - 1) / farmsPerPop);
+  int desiredHousing = pop + kHousingBuffer;
+
+  // Owned farms come back in row-major order, so tasks are queued as a window scan would.
+  const BuildingRegistry& buildings = Buildings(settlement);
+  // Samples skip tiles that already carry a queued task of the same type; Push would fold them
+  // into the existing task and the slot in this day's budget would be wasted.
+  const TaskStore& queued = Tasks(settlement);
+  auto canBuildAt = [&](int x, int y) {
+    return IsBuildableTileForSettlement(world, *this, settlement.id, x, y) &&
+           !queued.Contains(TaskType::BuildStructure, x, y);
+  };
+  auto inFarmWorkWindow = [&](int x, int y) {
+    return std::abs(x - settlement.centerX) <= kFarmWorkRadius &&
+           std::abs(y - settlement.centerY) <= kFarmWorkRadius;
+  };
 
-    bool foodEmergency = settlement.stockFood < pop * kEmergencyFoodPerPop;
-    if (taskCount > Settlement::kTaskCap / 2 && !foodEmergency) continue;
+  if (settlement.farms > 0 && available > 0) {
+    for (uint64_t key : buildings.farms) {
+      if (available <= 0) break;
+      int x = 0;
+      int y = 0;
+      BuildingRegistry::Unpack(key, x, y);
+      if (!inFarmWorkWindow(x, y)) continue;
+      if (world.At(x, y).farmStage < Settlement::kFarmReadyStage) continue;
+      if (queued.Contains(TaskType::HarvestFarm, x, y)) continue;
 
-    int desiredFood = pop * kDesiredFoodPerPop;
-    int desiredWood = pop * kDesiredWoodPerPop;
-    int farmsPerPop = FarmsPerPopForTier(settlement.techTier);
-    int desiredFarms = std::max(1, (pop + farmsPerPop - 1) / farmsPerPop);
-    int desiredHousing = pop + kHousingBuffer;
+      Task task;
+      task.type = TaskType::HarvestFarm;
+      task.x = x;
+      task.y = y;
+      task.amount = FarmYieldForTier(settlement.techTier);
+      task.settlementId = settlement.id;
+      if (!PushTask(settlement, task)) {
+        available = 0;
+        break;
+      }
+      available--;
+    }
+  }
 
-    if (settlement.farms > 0 && available > 0) {
-      for (int dy = -kFarmWorkRadius; dy <= kFarmWorkRadius && available > 0; ++dy) {
-        int y = settlement.centerY + dy;
-        if (y < 0 || y >= world.height()) continue;
-        for (int dx = -kFarmWorkRadius; dx <= kFarmWorkRadius && available > 0; ++dx) {
-          int x = settlement.centerX + dx;
-          if (x < 0 || x >= world.width()) continue;
-          const Tile& tile = world.At(x, y);
-          if (tile.building != BuildingType::Farm || tile.buildingOwnerId != settlement.id) continue;
-          if (tile.farmStage < Settlement::kFarmReadyStage) continue;
+  if (settlement.farms > 0 && available > 0 &&
+      settlement.stockWood >= Settlement::kGranaryWoodCost) {
+    int builderBudget = settlement.builders + 1;
+    if (foodEmergency) {
+      builderBudget = std::max(builderBudget, settlement.builders + settlement.idle / 2);
+    }
+    int tasksToPush = std::min(available, builderBudget);
 
-          Task task;
-          task.type = TaskType::HarvestFarm;
-          task.x = x;
-          task.y = y;
-          task.amount = FarmYieldForTier(settlement.techTier);
-          task.settlementId = settlement.id;
-          if (!settlement.PushTask(task)) {
-            available = 0;
-            break;
-          }
-          available--;
-        }
+    auto hasGranaryNear = [&](int cx, int cy) {
+      for (uint64_t key : buildings.granaries) {
+        int gx = 0;
+        int gy = 0;
+        BuildingRegistry::Unpack(key, gx, gy);
+        if (std::abs(gx - cx) + std::abs(gy - cy) <= kGranaryDropRadius) return true;
       }
-    }
+      return false;
+    };
 
-    if (settlement.farms > 0 && available > 0 &&
-        settlement.stockWood >= Settlement::kGranaryWoodCost) {
-      int builderBudget = settlement.builders + 1;
-      if (foodEmergency) {
-        builderBudget = std::max(builderBudget, settlement.builders + settlement.idle / 2);
+    for (uint64_t key : buildings.farms) {
+      if (available <= 0 || tasksToPush <= 0) break;
+      int x = 0;
+      int y = 0;
+      BuildingRegistry::Unpack(key, x, y);
+      if (!inFarmWorkWindow(x, y)) continue;
+      int distToTown = std::abs(x - settlement.centerX) + std::abs(y - settlement.centerY);
+      if (distToTown <= kGranaryDropRadius) continue;
+      if (hasGranaryNear(x, y) ||
+          queued.HasPlannedNear(BuildingType::Granary, x, y, kGranaryDropRadius)) {
+        continue;
       }
-      int tasksToPush = std::min(available, builderBudget);
 
-      auto hasPlannedGranaryNear = [&](int cx, int cy) {
-        for (int idx = settlement.taskHead; idx != settlement.taskTail;
-             idx = (idx + 1) % Settlement::kTaskCap) {
-          const Task& task = settlement.tasks[idx];
-          if (task.type != TaskType::BuildStructure || task.buildType != BuildingType::Granary) {
-            continue;
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
+      for (int gdy = -kGranaryBuildRadius; gdy <= kGranaryBuildRadius; ++gdy) {
+        for (int gdx = -kGranaryBuildRadius; gdx <= kGranaryBuildRadius; ++gdx) {
+          int gdist = std::abs(gdx) + std::abs(gdy);
+          if (gdist > kGranaryBuildRadius) continue;
+          int tx = x + gdx;
+          int ty = y + gdy;
+          if (!canBuildAt(tx, ty)) continue;
+          const Tile& candidate = world.At(tx, ty);
+          int score = -gdist * 20 - candidate.trees * 3 - candidate.food * 2;
+          if (score > bestScore) {
+            bestScore = score;
+            bestX = tx;
+            bestY = ty;
           }
-          int dist = std::abs(task.x - cx) + std::abs(task.y - cy);
-          if (dist <= kGranaryDropRadius) return true;
         }
-        return false;
-      };
+      }
 
-      for (int dy = -kFarmWorkRadius; dy <= kFarmWorkRadius && available > 0 && tasksToPush > 0;
-           ++dy) {
-        int y = settlement.centerY + dy;
-        if (y < 0 || y >= world.height()) continue;
-        for (int dx = -kFarmWorkRadius;
-             dx <= kFarmWorkRadius && available > 0 && tasksToPush > 0; ++dx) {
-          int x = settlement.centerX + dx;
-          if (x < 0 || x >= world.width()) continue;
-          const Tile& tile = world.At(x, y);
-          if (tile.building != BuildingType::Farm || tile.buildingOwnerId != settlement.id) continue;
-          int distToTown = std::abs(x - settlement.centerX) + std::abs(y - settlement.centerY);
-          if (distToTown <= kGranaryDropRadius) continue;
-
-          bool hasGranary = false;
-          for (int gdy = -kGranaryDropRadius; gdy <= kGranaryDropRadius && !hasGranary; ++gdy) {
-            for (int gdx = -kGranaryDropRadius; gdx <= kGranaryDropRadius; ++gdx) {
-              int gdist = std::abs(gdx) + std::abs(gdy);
-              if (gdist > kGranaryDropRadius) continue;
-              int tx = x + gdx;
-              int ty = y + gdy;
-              if (!world.InBounds(tx, ty)) continue;
-              const Tile& check = world.At(tx, ty);
-              if (check.building == BuildingType::Granary &&
-                  check.buildingOwnerId == settlement.id) {
-                hasGranary = true;
-                break;
-              }
+      if (bestX == -1 || bestY == -1) continue;
+      Task task;
+      task.type = TaskType::BuildStructure;
+      task.x = bestX;
+      task.y = bestY;
+      task.amount = 0;
+      task.settlementId = settlement.id;
+      task.buildType = BuildingType::Granary;
+      if (!PushTask(settlement, task)) {
+        available = 0;
+        break;
+      }
+      available--;
+      tasksToPush--;
+    }
+  }
+
+  if (available > 0 && settlement.stockWood >= Settlement::kWellWoodCost) {
+    bool needsWater = !settlement.hasWaterTarget ||
+                      world.WaterScentAt(settlement.centerX, settlement.centerY) <
+                          kWellWaterScentThreshold;
+    if (needsWater) {
+      int plannedWells = queued.PlannedCount(BuildingType::Well);
+      int desiredWells = std::max(1, pop / 40);
+      int wellsNeeded = desiredWells - (settlement.wells + plannedWells);
+      if (wellsNeeded > 0) {
+        int builderBudget = settlement.builders + std::max(1, settlement.idle / 4);
+        int tasksToPush = std::min(available, std::min(wellsNeeded, builderBudget));
+
+        auto hasFreshWaterWithin = [&](int cx, int cy, int radius) {
+          for (int dy = -radius; dy <= radius; ++dy) {
+            int y = cy + dy;
+            if (y < 0 || y >= world.height()) continue;
+            for (int dx = -radius; dx <= radius; ++dx) {
+              int x = cx + dx;
+              if (x < 0 || x >= world.width()) continue;
+              int dist = std::abs(dx) + std::abs(dy);
+              if (dist > radius) continue;
+              if (world.At(x, y).type == TileType::FreshWater) return true;
+            }
+          }
+          return false;
+        };
+
+        auto hasWellWithin = [&](int cx, int cy, int radius, int requiredRadius) {
+          for (int dy = -radius; dy <= radius; ++dy) {
+            int y = cy + dy;
+            if (y < 0 || y >= world.height()) continue;
+            for (int dx = -radius; dx <= radius; ++dx) {
+              int x = cx + dx;
+              if (x < 0 || x >= world.width()) continue;
+              int dist = std::abs(dx) + std::abs(dy);
+              if (dist > radius) continue;
+              if (world.WellRadiusAt(x, y) == requiredRadius) return true;
             }
           }
-          if (hasGranary || hasPlannedGranaryNear(x, y)) continue;
+          return false;
+        };
 
+        auto wellRadiusForNewWell = [&](int cx, int cy) {
+          if (hasFreshWaterWithin(cx, cy, kWellSourceRadius)) {
+            return kWellRadiusStrong;
+          }
+          if (hasWellWithin(cx, cy, kWellRadiusStrong, kWellRadiusStrong)) {
+            return kWellRadiusMedium;
+          }
+          if (hasWellWithin(cx, cy, kWellRadiusMedium, kWellRadiusMedium)) {
+            return kWellRadiusWeak;
+          }
+          if (hasWellWithin(cx, cy, kWellRadiusWeak, kWellRadiusWeak)) {
+            return kWellRadiusTiny;
+          }
+          return 0;
+        };
+
+        for (int i = 0; i < tasksToPush; ++i) {
           int bestX = -1;
           int bestY = -1;
           int bestScore = std::numeric_limits<int>::min();
-          for (int gdy = -kGranaryBuildRadius; gdy <= kGranaryBuildRadius; ++gdy) {
-            for (int gdx = -kGranaryBuildRadius; gdx <= kGranaryBuildRadius; ++gdx) {
-              int gdist = std::abs(gdx) + std::abs(gdy);
-              if (gdist > kGranaryBuildRadius) continue;
-              int tx = x + gdx;
-              int ty = y + gdy;
-              if (!IsBuildableTileForSettlement(world, *this, settlement.id, tx, ty)) continue;
-              const Tile& candidate = world.At(tx, ty);
-              int score = -gdist * 20 - candidate.trees * 3 - candidate.food * 2;
-              if (score > bestScore) {
-                bestScore = score;
-                bestX = tx;
-                bestY = ty;
-              }
+
+          for (int sample = 0; sample < 16; ++sample) {
+            int dx = rng.RangeInt(-kWaterSearchRadius, kWaterSearchRadius);
+            int dy = rng.RangeInt(-kWaterSearchRadius, kWaterSearchRadius);
+            int x = settlement.centerX + dx;
+            int y = settlement.centerY + dy;
+            if (!canBuildAt(x, y)) continue;
+            int newRadius = wellRadiusForNewWell(x, y);
+            if (newRadius == 0) continue;
+            const Tile& tile = world.At(x, y);
+            int dist = std::abs(dx) + std::abs(dy);
+            int score = newRadius * 120 - dist * 8 - tile.trees * 2 - tile.food * 2;
+            if (score > bestScore) {
+              bestScore = score;
+              bestX = x;
+              bestY = y;
             }
           }
 
-          if (bestX == -1 || bestY == -1) continue;
+          if (bestX == -1 || bestY == -1) break;
           Task task;
           task.type = TaskType::BuildStructure;
           task.x = bestX;
           task.y = bestY;
           task.amount = 0;
           task.settlementId = settlement.id;
-          task.buildType = BuildingType::Granary;
-          if (!settlement.PushTask(task)) {
-            available = 0;
-            break;
-          }
+          task.buildType = BuildingType::Well;
+          if (!PushTask(settlement, task)) break;
           available--;
-          tasksToPush--;
+          if (available <= 0) break;
         }
       }
     }
+  }
 
-    if (available > 0 && settlement.stockWood >= Settlement::kWellWoodCost) {
-      bool needsWater = !settlement.hasWaterTarget ||
-                        world.WaterScentAt(settlement.centerX, settlement.centerY) <
-                            kWellWaterScentThreshold;
-      if (needsWater) {
-        int plannedWells = 0;
-        for (int idx = settlement.taskHead; idx != settlement.taskTail;
-             idx = (idx + 1) % Settlement::kTaskCap) {
-          const Task& task = settlement.tasks[idx];
-          if (task.type == TaskType::BuildStructure && task.buildType == BuildingType::Well) {
-            plannedWells++;
-          }
-        }
-        int desiredWells = std::max(1, pop / 40);
-        int wellsNeeded = desiredWells - (settlement.wells + plannedWells);
-        if (wellsNeeded > 0) {
-          int builderBudget = settlement.builders + std::max(1, settlement.idle / 4);
-          int tasksToPush = std::min(available, std::min(wellsNeeded, builderBudget));
-
-          auto hasFreshWaterWithin = [&](int cx, int cy, int radius) {
-            for (int dy = -radius; dy <= radius; ++dy) {
-              int y = cy + dy;
-              if (y < 0 || y >= world.height()) continue;
-              for (int dx = -radius; dx <= radius; ++dx) {
-                int x = cx + dx;
-                if (x < 0 || x >= world.width()) continue;
-                int dist = std::abs(dx) + std::abs(dy);
-                if (dist > radius) continue;
-                if (world.At(x, y).type == TileType::FreshWater) return true;
-              }
-            }
-            return false;
-          };
-
-          auto hasWellWithin = [&](int cx, int cy, int radius, int requiredRadius) {
-            for (int dy = -radius; dy <= radius; ++dy) {
-              int y = cy + dy;
-              if (y < 0 || y >= world.height()) continue;
-              for (int dx = -radius; dx <= radius; ++dx) {
-                int x = cx + dx;
-                if (x < 0 || x >= world.width()) continue;
-                int dist = std::abs(dx) + std::abs(dy);
-                if (dist > radius) continue;
-                if (world.WellRadiusAt(x, y) == requiredRadius) return true;
-              }
-            }
-            return false;
-          };
+  if (available > 0) {
+    int foodNeed = std::max(0, desiredFood - settlement.stockFood);
+    int tasksToPush = std::min(available, std::max(pop * 4, foodNeed));
+    for (int i = 0; i < tasksToPush; ++i) {
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
 
-          auto wellRadiusForNewWell = [&](int cx, int cy) {
-            if (hasFreshWaterWithin(cx, cy, kWellSourceRadius)) {
-              return kWellRadiusStrong;
-            }
-            if (hasWellWithin(cx, cy, kWellRadiusStrong, kWellRadiusStrong)) {
-              return kWellRadiusMedium;
-            }
-            if (hasWellWithin(cx, cy, kWellRadiusMedium, kWellRadiusMedium)) {
-              return kWellRadiusWeak;
-            }
-            if (hasWellWithin(cx, cy, kWellRadiusWeak, kWellRadiusWeak)) {
-              return kWellRadiusTiny;
-            }
-            return 0;
-          };
-
-          for (int i = 0; i < tasksToPush; ++i) {
-            int bestX = -1;
-            int bestY = -1;
-            int bestScore = std::numeric_limits<int>::min();
-
-            for (int sample = 0; sample < 16; ++sample) {
-              int dx = rng.RangeInt(-kWaterSearchRadius, kWaterSearchRadius);
-              int dy = rng.RangeInt(-kWaterSearchRadius, kWaterSearchRadius);
-              int x = settlement.centerX + dx;
-              int y = settlement.centerY + dy;
-              if (!IsBuildableTileForSettlement(world, *this, settlement.id, x, y)) continue;
-              int newRadius = wellRadiusForNewWell(x, y);
-              if (newRadius == 0) continue;
-              const Tile& tile = world.At(x, y);
-              int dist = std::abs(dx) + std::abs(dy);
-              int score = newRadius * 120 - dist * 8 - tile.trees * 2 - tile.food * 2;
-              if (score > bestScore) {
-                bestScore = score;
-                bestX = x;
-                bestY = y;
-              }
-            }
+      for (int sample = 0; sample < 8; ++sample) {
+        int dx = rng.RangeInt(-kGatherRadius, kGatherRadius);
+        int dy = rng.RangeInt(-kGatherRadius, kGatherRadius);
+        int x = settlement.centerX + dx;
+        int y = settlement.centerY + dy;
+        if (!world.InBounds(x, y)) continue;
+        const Tile& tile = world.At(x, y);
+        if (tile.type != TileType::Land || tile.burning) continue;
+        if (tile.food <= 0) continue;
+        if (queued.Contains(TaskType::CollectFood, x, y)) continue;
 
-            if (bestX == -1 || bestY == -1) break;
-            Task task;
-            task.type = TaskType::BuildStructure;
-            task.x = bestX;
-            task.y = bestY;
-            task.amount = 0;
-            task.settlementId = settlement.id;
-            task.buildType = BuildingType::Well;
-            if (!settlement.PushTask(task)) break;
-            available--;
-            if (available <= 0) break;
-          }
+        int score = static_cast<int>(world.FoodScentAt(x, y)) + tile.food * 200;
+        if (score > bestScore) {
+          bestScore = score;
+          bestX = x;
+          bestY = y;
         }
       }
+
+      if (bestX == -1 || bestY == -1) break;
+      Task task;
+      task.type = TaskType::CollectFood;
+      task.x = bestX;
+      task.y = bestY;
+      task.amount = GatherYieldForTier(settlement.techTier);
+      task.settlementId = settlement.id;
+      if (!PushTask(settlement, task)) break;
+      available--;
+      if (available <= 0) break;
     }
+  }
 
-    if (available > 0) {
-      int foodNeed = std::max(0, desiredFood - settlement.stockFood);
-      int tasksToPush = std::min(available, std::max(pop * 4, foodNeed));
-      for (int i = 0; i < tasksToPush; ++i) {
-        int bestX = -1;
-        int bestY = -1;
-        int bestScore = std::numeric_limits<int>::min();
+  if (available > 0 && settlement.gatherers > 0) {
+    int farTasksToPush = std::min(available, std::max(1, settlement.gatherers / 2));
+    for (int i = 0; i < farTasksToPush; ++i) {
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
 
-        for (int sample = 0; sample < 8; ++sample) {
-          int dx = rng.RangeInt(-kGatherRadius, kGatherRadius);
-          int dy = rng.RangeInt(-kGatherRadius, kGatherRadius);
-          int x = settlement.centerX + dx;
-          int y = settlement.centerY + dy;
-          if (!world.InBounds(x, y)) continue;
-          const Tile& tile = world.At(x, y);
-          if (tile.type != TileType::Land || tile.burning) continue;
-          if (tile.food <= 0) continue;
+      for (int sample = 0; sample < 12; ++sample) {
+        int dx = rng.RangeInt(-kFarGatherRadius, kFarGatherRadius);
+        int dy = rng.RangeInt(-kFarGatherRadius, kFarGatherRadius);
+        int x = settlement.centerX + dx;
+        int y = settlement.centerY + dy;
+        if (!world.InBounds(x, y)) continue;
+        const Tile& tile = world.At(x, y);
+        if (tile.type != TileType::Land || tile.burning) continue;
+        if (tile.food <= 0) continue;
+        if (queued.Contains(TaskType::CollectFood, x, y)) continue;
 
-          int score = static_cast<int>(world.FoodScentAt(x, y)) + tile.food * 200;
-          if (score > bestScore) {
-            bestScore = score;
-            bestX = x;
-            bestY = y;
-          }
+        int dist = std::abs(dx) + std::abs(dy);
+        int score =
+            static_cast<int>(world.FoodScentAt(x, y)) + tile.food * 200 + dist * 10;
+        if (score > bestScore) {
+          bestScore = score;
+          bestX = x;
+          bestY = y;
         }
+      }
 
-        if (bestX == -1 || bestY == -1) break;
-        Task task;
-        task.type = TaskType::CollectFood;
-        task.x = bestX;
-        task.y = bestY;
-        task.amount = GatherYieldForTier(settlement.techTier);
-        task.settlementId = settlement.id;
-        if (!settlement.PushTask(task)) break;
-        available--;
-        if (available <= 0) break;
-      }
-    }
-
-    if (available > 0 && settlement.gatherers > 0) {
-      int farTasksToPush = std::min(available, std::max(1, settlement.gatherers / 2));
-      for (int i = 0; i < farTasksToPush; ++i) {
-        int bestX = -1;
-        int bestY = -1;
-        int bestScore = std::numeric_limits<int>::min();
-
-        for (int sample = 0; sample < 12; ++sample) {
-          int dx = rng.RangeInt(-kFarGatherRadius, kFarGatherRadius);
-          int dy = rng.RangeInt(-kFarGatherRadius, kFarGatherRadius);
-          int x = settlement.centerX + dx;
-          int y = settlement.centerY + dy;
-          if (!world.InBounds(x, y)) continue;
-          const Tile& tile = world.At(x, y);
-          if (tile.type != TileType::Land || tile.burning) continue;
-          if (tile.food <= 0) continue;
+      if (bestX == -1 || bestY == -1) break;
+      Task task;
+      task.type = TaskType::CollectFood;
+      task.x = bestX;
+      task.y = bestY;
+      task.amount = GatherYieldForTier(settlement.techTier);
+      task.settlementId = settlement.id;
+      if (!PushTask(settlement, task)) break;
+      available--;
+      if (available <= 0) break;
+    }
+  }
 
-          int dist = std::abs(dx) + std::abs(dy);
-          int score =
-              static_cast<int>(world.FoodScentAt(x, y)) + tile.food * 200 + dist * 10;
-          if (score > bestScore) {
-            bestScore = score;
-            bestX = x;
-            bestY = y;
-          }
-        }
+  if (settlement.farms > 0 && available > 0) {
+    int tasksToPush = std::min(available, std::max(2, settlement.farmers * 4));
+    for (int i = 0; i < tasksToPush; ++i) {
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
 
-        if (bestX == -1 || bestY == -1) break;
-        Task task;
-        task.type = TaskType::CollectFood;
-        task.x = bestX;
-        task.y = bestY;
-        task.amount = GatherYieldForTier(settlement.techTier);
-        task.settlementId = settlement.id;
-        if (!settlement.PushTask(task)) break;
-        available--;
-        if (available <= 0) break;
-      }
-    }
-
-    if (settlement.farms > 0 && available > 0) {
-      int tasksToPush = std::min(available, std::max(2, settlement.farmers * 4));
-      for (int i = 0; i < tasksToPush; ++i) {
-        int bestX = -1;
-        int bestY = -1;
-        int bestScore = std::numeric_limits<int>::min();
-
-        for (int sample = 0; sample < 10; ++sample) {
-          int dx = rng.RangeInt(-kFarmWorkRadius, kFarmWorkRadius);
-          int dy = rng.RangeInt(-kFarmWorkRadius, kFarmWorkRadius);
-          int x = settlement.centerX + dx;
-          int y = settlement.centerY + dy;
-          if (!world.InBounds(x, y)) continue;
-          const Tile& tile = world.At(x, y);
-          if (tile.building != BuildingType::Farm || tile.buildingOwnerId != settlement.id) continue;
-          if (tile.farmStage != 0) continue;
+      for (int sample = 0; sample < 10; ++sample) {
+        int dx = rng.RangeInt(-kFarmWorkRadius, kFarmWorkRadius);
+        int dy = rng.RangeInt(-kFarmWorkRadius, kFarmWorkRadius);
+        int x = settlement.centerX + dx;
+        int y = settlement.centerY + dy;
+        if (!world.InBounds(x, y)) continue;
+        const Tile& tile = world.At(x, y);
+        if (tile.building != BuildingType::Farm || tile.buildingOwnerId != settlement.id) continue;
+        if (tile.farmStage != 0) continue;
+        if (queued.Contains(TaskType::PlantFarm, x, y)) continue;
 
-          int score = static_cast<int>(world.WaterScentAt(x, y));
-          if (score > bestScore) {
-            bestScore = score;
-            bestX = x;
-            bestY = y;
-          }
+        int score = static_cast<int>(world.WaterScentAt(x, y));
+        if (score > bestScore) {
+          bestScore = score;
+          bestX = x;
+          bestY = y;
         }
+      }
 
-        if (bestX == -1 || bestY == -1) break;
-        Task task;
-        task.type = TaskType::PlantFarm;
-        task.x = bestX;
-        task.y = bestY;
-        task.amount = 0;
-        task.settlementId = settlement.id;
-        if (!settlement.PushTask(task)) break;
-        available--;
-        if (available <= 0) break;
-      }
-    }
-
-    if (settlement.stockWood < desiredWood && available > 0) {
-      int need = desiredWood - settlement.stockWood;
-      int tasksToPush = std::min(need, std::min(available, pop));
-      for (int i = 0; i < tasksToPush; ++i) {
-        int bestX = -1;
-        int bestY = -1;
-        int bestScore = std::numeric_limits<int>::min();
-
-        for (int sample = 0; sample < 8; ++sample) {
-          int dx = rng.RangeInt(-kWoodRadius, kWoodRadius);
-          int dy = rng.RangeInt(-kWoodRadius, kWoodRadius);
-          int x = settlement.centerX + dx;
-          int y = settlement.centerY + dy;
-          if (!world.InBounds(x, y)) continue;
-          const Tile& tile = world.At(x, y);
-          if (tile.type != TileType::Land || tile.burning) continue;
-          if (tile.trees <= 0) continue;
+      if (bestX == -1 || bestY == -1) break;
+      Task task;
+      task.type = TaskType::PlantFarm;
+      task.x = bestX;
+      task.y = bestY;
+      task.amount = 0;
+      task.settlementId = settlement.id;
+      if (!PushTask(settlement, task)) break;
+      available--;
+      if (available <= 0) break;
+    }
+  }
 
-          int score = tile.trees * 150;
-          if (score > bestScore) {
-            bestScore = score;
-            bestX = x;
-            bestY = y;
-          }
-        }
+  if (settlement.stockWood < desiredWood && available > 0) {
+    int need = desiredWood - settlement.stockWood;
+    int tasksToPush = std::min(need, std::min(available, pop));
+    for (int i = 0; i < tasksToPush; ++i) {
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
 
-        if (bestX == -1 || bestY == -1) break;
-        Task task;
-        task.type = TaskType::CollectWood;
-        task.x = bestX;
-        task.y = bestY;
-        task.amount = GatherYieldForTier(settlement.techTier);
-        task.settlementId = settlement.id;
-        if (!settlement.PushTask(task)) break;
-        available--;
-        if (available <= 0) break;
-      }
-    }
-
-    if (settlement.farms < desiredFarms && available > 0 &&
-        settlement.stockWood >= Settlement::kFarmWoodCost) {
-      int farmsNeeded = desiredFarms - settlement.farms;
-      int builderBudget = settlement.builders + 1;
-      if (foodEmergency) {
-        builderBudget = std::max(builderBudget, settlement.builders + settlement.idle / 2);
-      }
-      int tasksToPush = std::min(farmsNeeded, std::min(available, builderBudget));
-      for (int i = 0; i < tasksToPush; ++i) {
-        int bestX = -1;
-        int bestY = -1;
-        int bestScore = std::numeric_limits<int>::min();
-
-        for (int sample = 0; sample < 12; ++sample) {
-          int dx = rng.RangeInt(-kFarmBuildRadius, kFarmBuildRadius);
-          int dy = rng.RangeInt(-kFarmBuildRadius, kFarmBuildRadius);
-          int x = settlement.centerX + dx;
-          int y = settlement.centerY + dy;
-          if (!IsBuildableTileForSettlement(world, *this, settlement.id, x, y)) continue;
-          const Tile& tile = world.At(x, y);
-          int score = static_cast<int>(world.WaterScentAt(x, y)) - tile.trees * 4;
-          if (score > bestScore) {
-            bestScore = score;
-            bestX = x;
-            bestY = y;
-          }
-        }
+      for (int sample = 0; sample < 8; ++sample) {
+        int dx = rng.RangeInt(-kWoodRadius, kWoodRadius);
+        int dy = rng.RangeInt(-kWoodRadius, kWoodRadius);
+        int x = settlement.centerX + dx;
+        int y = settlement.centerY + dy;
+        if (!world.InBounds(x, y)) continue;
+        const Tile& tile = world.At(x, y);
+        if (tile.type != TileType::Land || tile.burning) continue;
+        if (tile.trees <= 0) continue;
+        if (queued.Contains(TaskType::CollectWood, x, y)) continue;
 
-        if (bestX == -1 || bestY == -1) break;
-        Task task;
-        task.type = TaskType::BuildStructure;
-        task.x = bestX;
-        task.y = bestY;
-        task.amount = 0;
-        task.settlementId = settlement.id;
-        task.buildType = BuildingType::Farm;
-        if (!settlement.PushTask(task)) break;
-        available--;
-        if (available <= 0) break;
-      }
-    }
-
-    if (settlement.housingCap < desiredHousing && available > 0 &&
-        settlement.stockWood >= Settlement::kHouseWoodCost) {
-      int needed = desiredHousing - settlement.housingCap;
-      int housesNeeded = (needed + Settlement::kHouseCapacity - 1) / Settlement::kHouseCapacity;
-      int builderBudget = settlement.builders + std::max(1, settlement.idle / 2);
-      if (settlement.housingCap < pop) {
-        builderBudget = std::max(builderBudget, settlement.builders + settlement.idle);
-      }
-      int tasksToPush = std::min(housesNeeded, std::min(available, builderBudget));
-      for (int i = 0; i < tasksToPush; ++i) {
-        int bestX = -1;
-        int bestY = -1;
-        int bestScore = std::numeric_limits<int>::min();
-
-        for (int sample = 0; sample < 12; ++sample) {
-          int dx = rng.RangeInt(-kHouseBuildRadius, kHouseBuildRadius);
-          int dy = rng.RangeInt(-kHouseBuildRadius, kHouseBuildRadius);
-          int x = settlement.centerX + dx;
-          int y = settlement.centerY + dy;
-          if (!IsBuildableTileForSettlement(world, *this, settlement.id, x, y)) continue;
-          const Tile& tile = world.At(x, y);
-          int dist = std::abs(dx) + std::abs(dy);
-          int score = -dist * 10 - tile.trees * 3 - tile.food * 2;
-          if (score > bestScore) {
-            bestScore = score;
-            bestX = x;
-            bestY = y;
-          }
+        int score = tile.trees * 150;
+        if (score > bestScore) {
+          bestScore = score;
+          bestX = x;
+          bestY = y;
         }
+      }
+
+      if (bestX == -1 || bestY == -1) break;
+      Task task;
+      task.type = TaskType::CollectWood;
+      task.x = bestX;
+      task.y = bestY;
+      task.amount = GatherYieldForTier(settlement.techTier);
+      task.settlementId = settlement.id;
+      if (!PushTask(settlement, task)) break;
+      available--;
+      if (available <= 0) break;
+    }
+  }
 
-        if (bestX == -1 || bestY == -1) break;
-        Task task;
-        task.type = TaskType::BuildStructure;
-        task.x = bestX;
-        task.y = bestY;
-        task.amount = 0;
-        task.settlementId = settlement.id;
-        task.buildType = BuildingType::House;
-        if (!settlement.PushTask(task)) break;
-        available--;
-        if (available <= 0) break;
-      }
-    }
-
-    int patrols = std::min(settlement.guards + settlement.soldiers, available);
-    for (int i = 0; i < patrols; ++i) {
-      int bestX = settlement.centerX;
-      int bestY = settlement.centerY;
-      for (int attempt = 0; attempt < 6; ++attempt) {
-        int dx = rng.RangeInt(-kClaimRadiusTownHall / 2, kClaimRadiusTownHall / 2);
-        int dy = rng.RangeInt(-kClaimRadiusTownHall / 2, kClaimRadiusTownHall / 2);
+  if (settlement.farms < desiredFarms && available > 0 &&
+      settlement.stockWood >= Settlement::kFarmWoodCost) {
+    int farmsNeeded = desiredFarms - settlement.farms;
+    int builderBudget = settlement.builders + 1;
+    if (foodEmergency) {
+      builderBudget = std::max(builderBudget, settlement.builders + settlement.idle / 2);
+    }
+    int tasksToPush = std::min(farmsNeeded, std::min(available, builderBudget));
+    for (int i = 0; i < tasksToPush; ++i) {
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
+
+      for (int sample = 0; sample < 12; ++sample) {
+        int dx = rng.RangeInt(-kFarmBuildRadius, kFarmBuildRadius);
+        int dy = rng.RangeInt(-kFarmBuildRadius, kFarmBuildRadius);
         int x = settlement.centerX + dx;
         int y = settlement.centerY + dy;
-        if (!world.InBounds(x, y)) continue;
-        if (world.At(x, y).type == TileType::Ocean) continue;
-        bestX = x;
-        bestY = y;
-        break;
+        if (!canBuildAt(x, y)) continue;
+        const Tile& tile = world.At(x, y);
+        int score = static_cast<int>(world.WaterScentAt(x, y)) - tile.trees * 4;
+        if (score > bestScore) {
+          bestScore = score;
+          bestX = x;
+          bestY = y;
+        }
       }
 
+      if (bestX == -1 || bestY == -1) break;
       Task task;
-      task.type = TaskType::PatrolEdge;
+      task.type = TaskType::BuildStructure;
       task.x = bestX;
       task.y = bestY;
       task.amount = 0;
       task.settlementId = settlement.id;
-      if (!settlement.PushTask(task)) break;
+      task.buildType = BuildingType::Farm;
+      if (!PushTask(settlement, task)) break;
       available--;
       if (available <= 0) break;
     }
   }
-}
 
-void SettlementManager::RunSettlementEconomy(World& world, Random& rng) {
-  for (auto& settlement : settlements_) {
-    int pop = settlement.population;
-    if (pop <= 0) continue;
+  if (settlement.housingCap < desiredHousing && available > 0 &&
+      settlement.stockWood >= Settlement::kHouseWoodCost) {
+    int needed = desiredHousing - settlement.housingCap;
+    int housesNeeded = (needed + Settlement::kHouseCapacity - 1) / Settlement::kHouseCapacity;
+    int builderBudget = settlement.builders + std::max(1, settlement.idle / 2);
+    if (settlement.housingCap < pop) {
+      builderBudget = std::max(builderBudget, settlement.builders + settlement.idle);
+    }
+    int tasksToPush = std::min(housesNeeded, std::min(available, builderBudget));
+    for (int i = 0; i < tasksToPush; ++i) {
+      int bestX = -1;
+      int bestY = -1;
+      int bestScore = std::numeric_limits<int>::min();
 
-    int desiredWood = pop * kDesiredWoodPerPop;
-    if (settlement.stockFood > pop * 4 && settlement.stockWood < desiredWood) {
-      int plantAttempts = std::min(settlement.builders + settlement.idle / 2, 60);
-      for (int i = 0; i < plantAttempts; ++i) {
+      for (int sample = 0; sample < 12; ++sample) {
         int dx = rng.RangeInt(-kHouseBuildRadius, kHouseBuildRadius);
         int dy = rng.RangeInt(-kHouseBuildRadius, kHouseBuildRadius);
         int x = settlement.centerX + dx;
         int y = settlement.centerY + dy;
-        if (!world.InBounds(x, y)) continue;
+        if (!canBuildAt(x, y)) continue;
         const Tile& tile = world.At(x, y);
-        if (tile.type != TileType::Land || tile.burning) continue;
-        if (tile.building != BuildingType::None) continue;
-        if (tile.trees >= 12) continue;
-        if (rng.Chance(0.25f)) {
-          world.EditTile(x, y, [&](Tile& t) {
-            int trees = static_cast<int>(t.trees);
-            trees = std::min(255, trees + 1);
-            t.trees = static_cast<uint8_t>(trees);
-          });
+        int dist = std::abs(dx) + std::abs(dy);
+        int score = -dist * 10 - tile.trees * 3 - tile.food * 2;
+        if (score > bestScore) {
+          bestScore = score;
+          bestX = x;
+          bestY = y;
         }
       }
+
+      if (bestX == -1 || bestY == -1) break;
+      Task task;
+      task.type = TaskType::BuildStructure;
+      task.x = bestX;
+      task.y = bestY;
+      task.amount = 0;
+      task.settlementId = settlement.id;
+      task.buildType = BuildingType::House;
+      if (!PushTask(settlement, task)) break;
+      available--;
+      if (available <= 0) break;
     }
   }
+
+  int patrols = std::min(settlement.guards + settlement.soldiers, available);
+  for (int i = 0; i < patrols; ++i) {
+    int bestX = settlement.centerX;
+    int bestY = settlement.centerY;
+    for (int attempt = 0; attempt < 6; ++attempt) {
+      int dx = rng.RangeInt(-kClaimRadiusTownHall / 2, kClaimRadiusTownHall / 2);
+      int dy = rng.RangeInt(-kClaimRadiusTownHall / 2, kClaimRadiusTownHall / 2);
+      int x = settlement.centerX + dx;
+      int y = settlement.centerY + dy;
+      if (!world.InBounds(x, y)) continue;
+      if (world.At(x, y).type == TileType::Ocean) continue;
+      bestX = x;
+      bestY = y;
+      break;
+    }
+
+    Task task;
+    task.type = TaskType::PatrolEdge;
+    task.x = bestX;
+    task.y = bestY;
+    task.amount = 0;
+    task.settlementId = settlement.id;
+    if (!PushTask(settlement, task)) break;
+    available--;
+    if (available <= 0) break;
+  }
+}
+
+void SettlementManager::RunSettlementEconomy(World& world, Random& rng, int dayCount) {
+  const uint64_t high = rng.NextU32();
+  const uint64_t seed = (high << 32) | rng.NextU32();
+  worldCommands_.resize(settlements_.size());
+  ParallelForSettlements([&](int i) {
+    const Settlement& settlement = settlements_[static_cast<size_t>(i)];
+    Random settlementRng = Random::Stream(seed, static_cast<uint64_t>(settlement.id),
+                                          static_cast<uint64_t>(dayCount), RngPurpose::Economy);
+    PlanSettlementEconomy(settlement, world, settlementRng,
+                          worldCommands_[static_cast<size_t>(i)]);
+  });
+  for (WorldCommandBuffer& commands : worldCommands_) commands.ApplyTo(world);
+}
+
+void SettlementManager::PlanSettlementEconomy(const Settlement& settlement, const World& world,
+                                              Random& rng, WorldCommandBuffer& commands) const {
+  int pop = settlement.population;
+  if (pop <= 0) return;
+
+  int desiredWood = pop * kDesiredWoodPerPop;
+  if (settlement.stockFood <= pop * 4 || settlement.stockWood >= desiredWood) return;
+  int plantAttempts = std::min(settlement.builders + settlement.idle / 2, 60);
+  for (int i = 0; i < plantAttempts; ++i) {
+    int dx = rng.RangeInt(-kHouseBuildRadius, kHouseBuildRadius);
+    int dy = rng.RangeInt(-kHouseBuildRadius, kHouseBuildRadius);
+    int x = settlement.centerX + dx;
+    int y = settlement.centerY + dy;
+    if (!world.InBounds(x, y)) continue;
+    const Tile& tile = world.At(x, y);
+    if (tile.type != TileType::Land || tile.burning) continue;
+    if (tile.building != BuildingType::None) continue;
+    if (tile.trees >= 12) continue;
+    if (rng.Chance(0.25f)) commands.AddTrees(x, y, 1);
+  }
 }
 
 void SettlementManager::UpdateDaily(World& world, HumanManager& humans, Random& rng, int dayCount,
                                     int dayDelta,
                                     std::vector<VillageMarker>& markers, FactionManager& factions) {
   CrashContextSetStage("Settlements::UpdateDaily");
+  FUNSIM_PROFILE_ZONE("Settlements::UpdateDaily");
+  FUNSIM_PROFILE_PHASES(phase);
   if (dayDelta < 1) dayDelta = 1;
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:Setup");
   EnsureZoneBuffers(world);
   EnsureSettlementFactions(factions, rng);
   if (world.ConsumeBuildingDirty()) {
-    RecomputeSettlementBuildings(world);
+    ApplyBuildingEvents(world);
   } else {
     UpdateSettlementCaps();
   }
-  RecomputeZoneOwners(world);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:ZoneOwners");
+  UpdateZoneOwners(world);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:ZonePop");
   RecomputeZonePop(world, humans, dayDelta);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:Founding");
   TryFoundNewSettlements(world, rng, dayCount, markers, factions);
   if (world.ConsumeBuildingDirty()) {
-    RecomputeSettlementBuildings(world);
+    ApplyBuildingEvents(world);
   } else {
     UpdateSettlementCaps();
   }
-  RecomputeZoneOwners(world);
-  AssignHumansToSettlements(humans);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:ZoneOwners");
+  UpdateZoneOwners(world);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:AssignHumans");
+  AssignHumansToSettlements(world, humans);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:WaterTargets");
   ComputeSettlementWaterTargets(world);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:BorderPressure");
   UpdateBorderPressure(factions);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:PopAndRoles");
   RecomputeSettlementPopAndRoles(world, rng, dayCount, dayDelta, humans, factions);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:ArmiesAndSieges");
   UpdateArmiesAndSieges(world, humans, rng, dayCount, dayDelta, factions);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:Evolution");
   UpdateSettlementEvolution(factions, rng);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:ConflictImpact");
   ApplyConflictImpact(world, humans, rng, dayCount, factions);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:GenerateTasks");
   GenerateTasks(world, rng, factions, dayCount);
-  RunSettlementEconomy(world, rng);
+  FUNSIM_PROFILE_NEXT(phase, "Settlements:Economy");
+  RunSettlementEconomy(world, rng, dayCount);
   if (homeFieldDirty_) {
+    FUNSIM_PROFILE_NEXT(phase, "Settlements:HomeField");
     world.RecomputeHomeField(*this);
     homeFieldDirty_ = false;
   }
 }
 
-void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount,
+void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount, int dayDelta,
                                     std::vector<VillageMarker>& markers, FactionManager& factions) {
   CrashContextSetStage("Settlements::UpdateMacro");
+  FUNSIM_PROFILE_ZONE("Settlements::UpdateMacro");
   EnsureZoneBuffers(world);
   EnsureSettlementFactions(factions, rng);
   if (world.ConsumeBuildingDirty()) {
-    RecomputeSettlementBuildings(world);
+    ApplyBuildingEvents(world);
   } else {
     UpdateSettlementCaps();
   }
-  RecomputeZoneOwners(world);
+  UpdateZoneOwners(world);
   RecomputeZonePopMacro();
   TryFoundNewSettlements(world, rng, dayCount, markers, factions);
   if (world.ConsumeBuildingDirty()) {
-    RecomputeSettlementBuildings(world);
+    ApplyBuildingEvents(world);
   } else {
     UpdateSettlementCaps();
   }
-  RecomputeZoneOwners(world);
+  UpdateZoneOwners(world);
   idToIndex_.assign(nextId_, -1);
   for (int i = 0; i < static_cast<int>(settlements_.size()); ++i) {
     idToIndex_[settlements_[i].id] = i;
@@ -2839,7 +3657,7 @@ void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount,
   UpdateSettlementEvolution(factions, rng);
   ApplyConflictImpactMacro(world, rng, dayCount, factions);
   UpdateSettlementRoleStatsMacro(world, factions, dayCount);
-  UpdateArmiesAndSiegesMacro(world, rng, dayCount, 1, factions);
+  UpdateArmiesAndSiegesMacro(world, rng, dayCount, dayDelta, factions);
 
   auto placeBuilding = [&](Settlement& settlement, BuildingType type, int radius) {
     int bestX = -1;
@@ -2882,7 +3700,8 @@ void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount,
       }
     }
 
-    int houseBudget = 6;
+    // Placement runs once per call, so a batched step gets the budget of all its days.
+    int houseBudget = 6 * dayDelta;
     while (houseBudget > 0 && settlement.housingCap < desiredHousing &&
            settlement.stockWood >= Settlement::kHouseWoodCost) {
       if (!placeBuilding(settlement, BuildingType::House, kHouseBuildRadius)) break;
@@ -2891,12 +3710,14 @@ void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount,
       houseBudget--;
     }
 
-    int farmBudget = 2;
-    while (farmBudget > 0 && settlement.farms < desiredFarms &&
+    // Counters catch up when the placement events are applied below.
+    int farmBudget = 2 * dayDelta;
+    int farms = settlement.farms;
+    while (farmBudget > 0 && farms < desiredFarms &&
            settlement.stockWood >= Settlement::kFarmWoodCost) {
       if (!placeBuilding(settlement, BuildingType::Farm, kFarmBuildRadius)) break;
       settlement.stockWood = std::max(0, settlement.stockWood - Settlement::kFarmWoodCost);
-      settlement.farms++;
+      farms++;
       farmBudget--;
     }
   }
@@ -2911,7 +3732,7 @@ void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount,
   }
 
   if (world.ConsumeBuildingDirty()) {
-    RecomputeSettlementBuildings(world);
+    ApplyBuildingEvents(world);
   } else {
     UpdateSettlementCaps();
   }
@@ -2920,3 +3741,76 @@ void SettlementManager::UpdateMacro(World& world, Random& rng, int dayCount,
     homeFieldDirty_ = false;
   }
 }
+
+uint64_t SettlementManager::StateHash() const {
+  StateHasher hasher;
+  hasher.Add(nextId_);
+  hasher.Add(warDeathsPending_);
+  hasher.Add(settlements_.size());
+  for (const Settlement& s : settlements_) {
+    hasher.Add(s.id);
+    hasher.Add(s.centerX);
+    hasher.Add(s.centerY);
+    hasher.Add(s.factionId);
+    hasher.Add(s.stockFood);
+    hasher.Add(s.stockWood);
+    hasher.Add(s.population);
+    hasher.Add(s.gatherers);
+    hasher.Add(s.farmers);
+    hasher.Add(s.builders);
+    hasher.Add(s.guards);
+    hasher.Add(s.soldiers);
+    hasher.Add(s.scouts);
+    hasher.Add(s.idle);
+    hasher.Add(s.ageDays);
+    hasher.Add(s.houses);
+    hasher.Add(s.farms);
+    hasher.Add(s.granaries);
+    hasher.Add(s.wells);
+    hasher.Add(s.farmsPlanted);
+    hasher.Add(s.farmsReady);
+    hasher.Add(s.townHalls);
+    hasher.Add(s.housingCap);
+    hasher.Add(s.tier);
+    hasher.Add(s.techTier);
+    hasher.Add(s.techProgress);
+    hasher.Add(s.stability);
+    hasher.Add(s.unrest);
+    hasher.Add(s.borderPressure);
+    hasher.Add(s.warPressure);
+    hasher.Add(s.influenceRadius);
+    hasher.Add(s.isCapital);
+    hasher.Add(s.waterTargetX);
+    hasher.Add(s.waterTargetY);
+    hasher.Add(s.hasWaterTarget);
+    hasher.Add(s.generalHumanId);
+    hasher.Add(s.warId);
+    hasher.Add(s.warTargetSettlementId);
+    hasher.Add(s.lastWarOrderDay);
+    hasher.Add(s.defenseTargetX);
+    hasher.Add(s.defenseTargetY);
+    hasher.Add(s.hasDefenseTarget);
+    hasher.Add(s.captureProgress);
+    hasher.Add(s.captureLeaderFactionId);
+    hasher.Add(s.captureWarId);
+    hasher.Add(s.lastCaptureUpdateDay);
+    hasher.Add(s.siegeDays);
+    hasher.Add(s.occupationDays);
+    hasher.Add(s.macroArmyTargetSettlementId);
+    hasher.Add(s.macroArmyEtaDays);
+    hasher.Add(s.macroArmySieging);
+    macroPools_.Hash(hasher, static_cast<int>(&s - settlements_.data()));
+    const TaskStore& queue = Tasks(s);
+    hasher.Add(queue.Count());
+    for (int i = 0; i < queue.Count(); ++i) {
+      const Task& task = queue.At(i);
+      hasher.Add(task.type);
+      hasher.Add(task.x);
+      hasher.Add(task.y);
+      hasher.Add(task.amount);
+      hasher.Add(task.settlementId);
+      hasher.Add(task.buildType);
+    }
+  }
+  return hasher.Digest();
+}
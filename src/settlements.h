@@ -1,15 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <vector>
 
-#include "render.h"
+#include "macro_cohorts.h"
+#include "world.h"
 
 class HumanManager;
+struct Human;
 class FactionManager;
 class Random;
 class World;
 
+struct VillageMarker {
+  int x = 0;
+  int y = 0;
+  int ttlDays = 0;
+};
+
 enum class TaskType : uint8_t {
   CollectFood,
   CollectWood,
@@ -32,8 +42,214 @@ struct Task {
   BuildingType buildType = BuildingType::None;
 };
 
+// Pending tasks for one settlement. Tasks are stored densely (a removal moves the last task into
+// the hole), indexed by a (type, x, y) set so a tile is queued at most once per task type, and
+// threaded through coarse spatial buckets around the settlement center so a worker claims the
+// nearest matching task without scanning the store. Storage is kept across Clear().
+class TaskStore {
+ public:
+  static constexpr int kMaxTasks = 2047;
+  // kBucketsPerSide^2 cells of kBucketSize tiles centred on the settlement; tasks and claimants
+  // outside the grid fall into its border cells.
+  static constexpr int kBucketSize = 4;
+  static constexpr int kBucketsPerSide = 16;
+  static constexpr uint32_t kAnyType = ~0u;
+
+  static constexpr uint32_t TypeBit(TaskType type) { return 1u << static_cast<uint32_t>(type); }
+
+  TaskStore() { bucketHead_.fill(-1); }
+
+  void SetOrigin(int centerX, int centerY);
+  int Count() const { return static_cast<int>(entries_.size()); }
+  // i-th stored task, 0 <= i < Count(); the order is deterministic but not FIFO.
+  const Task& At(int i) const { return entries_[static_cast<size_t>(i)].task; }
+  bool Contains(TaskType type, int x, int y) const;
+  // Returns false only when the store is full. A task whose (type, x, y) is already queued is
+  // accepted without storing a second copy.
+  bool Push(const Task& task);
+  // Removes the task with a type in typeMask nearest to (x, y) by Manhattan distance (the older
+  // task on ties) into out. Tasks of other types stay queued.
+  bool ClaimNearest(int x, int y, uint32_t typeMask, Task& out);
+  // Starts a task generation round; tasks pushed from now on are stamped with it.
+  void BeginRound() { round_++; }
+  // Drops every task queued more than maxAgeRounds rounds ago or rejected by keep(task).
+  template <typename Keep>
+  void DropStale(int maxAgeRounds, Keep&& keep);
+  void Clear();
+
+  // Queued BuildStructure tasks are mirrored here so "already planned?" checks skip the store.
+  int PlannedCount(BuildingType type) const;
+  bool HasPlannedNear(BuildingType type, int x, int y, int radius) const;
+
+ private:
+  static constexpr int kBucketCount = kBucketsPerSide * kBucketsPerSide;
+  static constexpr int kTypeCount = static_cast<int>(TaskType::PatrolEdge) + 1;
+
+  struct Entry {
+    Task task;
+    uint32_t seq = 0;
+    uint32_t round = 0;
+    int bucket = 0;
+    int prev = -1;
+    int next = -1;
+  };
+  struct PlannedBuild {
+    int x = 0;
+    int y = 0;
+    BuildingType type = BuildingType::None;
+  };
+
+  static uint64_t KeyOf(TaskType type, int x, int y);
+  int BucketCoord(int value, int origin) const;
+  size_t KeySlot(uint64_t key) const;
+  void InsertKey(uint64_t key);
+  void EraseKey(uint64_t key);
+  void Remove(int index);
+
+  std::vector<Entry> entries_;
+  std::array<int, kBucketCount> bucketHead_{};
+  // Queued tasks per TaskType, so a claim for absent types returns without a search.
+  std::array<int, kTypeCount> typeCounts_{};
+  // Open-addressed (type, x, y) keys, 0 = empty slot; size is a power of two.
+  std::vector<uint64_t> keys_;
+  int originX_ = 0;
+  int originY_ = 0;
+  uint32_t nextSeq_ = 0;
+  uint32_t round_ = 0;
+  std::vector<PlannedBuild> planned_;
+};
+
+template <typename Keep>
+void TaskStore::DropStale(int maxAgeRounds, Keep&& keep) {
+  // Walk backwards: Remove() fills the hole with the last entry, which was already visited.
+  for (int i = Count() - 1; i >= 0; --i) {
+    const Entry& entry = entries_[static_cast<size_t>(i)];
+    if (round_ - entry.round > static_cast<uint32_t>(maxAgeRounds) || !keep(entry.task)) {
+      Remove(i);
+    }
+  }
+}
+
+// Building tiles owned by one settlement, packed with y in the high word so each list stays in
+// row-major order (the order a window scan around the town visits them).
+struct BuildingRegistry {
+  static uint64_t Pack(int x, int y) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) |
+           static_cast<uint64_t>(static_cast<uint32_t>(x));
+  }
+  static void Unpack(uint64_t key, int& x, int& y) {
+    x = static_cast<int>(static_cast<uint32_t>(key & 0xffffffffu));
+    y = static_cast<int>(static_cast<uint32_t>(key >> 32));
+  }
+
+  // nullptr for building types that are not tracked (town halls).
+  const std::vector<uint64_t>* ListFor(BuildingType type) const;
+  void Add(BuildingType type, int x, int y);
+  void Remove(BuildingType type, int x, int y);
+  void Clear();
+
+  std::vector<uint64_t> houses;
+  std::vector<uint64_t> farms;
+  std::vector<uint64_t> granaries;
+  std::vector<uint64_t> wells;
+
+ private:
+  std::vector<uint64_t>* MutableListFor(BuildingType type);
+};
+
+enum class DistanceMetric : uint8_t { EuclideanSq, Manhattan };
+
+// Uniform grid over settlement centers plus per-faction member lists, keyed by index into
+// SettlementManager's settlement vector (settlements are never removed). Queries break distance
+// ties towards the lowest index, matching a front-to-back linear scan with a strict "<".
+class SettlementIndex {
+ public:
+  static constexpr int kCellSize = 32;
+
+  void Reset(int worldWidth, int worldHeight);
+  void Insert(int index, int x, int y, int factionId);
+  void SetFaction(int index, int factionId);
+  int Size() const { return static_cast<int>(centers_.size()); }
+  const std::vector<int>& FactionMembers(int factionId) const;
+
+  // Nearest entry accepted by accept(index), or -1. outDist is in the metric's units (squared
+  // tiles for EuclideanSq).
+  template <typename Accept>
+  int Nearest(int x, int y, DistanceMetric metric, Accept&& accept, int& outDist) const;
+  int Nearest(int x, int y, DistanceMetric metric, int& outDist) const {
+    return Nearest(x, y, metric, [](int) { return true; }, outDist);
+  }
+  // True if any entry lies within radius tiles (inclusive).
+  bool AnyWithinRadius(int x, int y, int radius, DistanceMetric metric) const;
+  // Appends every entry within radius tiles, in ascending index order.
+  void WithinRadius(int x, int y, int radius, DistanceMetric metric, std::vector<int>& out) const;
+
+ private:
+  struct Center {
+    int x = 0;
+    int y = 0;
+    int factionId = 0;
+  };
+
+  static int Distance(DistanceMetric metric, int dx, int dy) {
+    if (metric == DistanceMetric::Manhattan) return (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+    return dx * dx + dy * dy;
+  }
+  int CellCoord(int v, int cells) const {
+    const int c = v / kCellSize;
+    return (v < 0) ? 0 : (c >= cells ? cells - 1 : c);
+  }
+  const std::vector<int>& Cell(int cx, int cy) const {
+    return cells_[static_cast<size_t>(cy * cellsX_ + cx)];
+  }
+
+  int cellsX_ = 0;
+  int cellsY_ = 0;
+  std::vector<std::vector<int>> cells_;
+  std::vector<Center> centers_;
+  std::vector<std::vector<int>> factionMembers_;
+};
+
+template <typename Accept>
+int SettlementIndex::Nearest(int x, int y, DistanceMetric metric, Accept&& accept,
+                             int& outDist) const {
+  int bestIndex = -1;
+  int bestDist = 0;
+  if (cells_.empty()) return -1;
+  const int cx = CellCoord(x, cellsX_);
+  const int cy = CellCoord(y, cellsY_);
+  const int maxRing = std::max(std::max(cx, cellsX_ - 1 - cx), std::max(cy, cellsY_ - 1 - cy));
+  for (int ring = 0; ring <= maxRing; ++ring) {
+    if (ring > 0 && bestIndex >= 0) {
+      // Anything in this ring is at least (ring - 1) whole cells plus one tile away on one axis.
+      const int gap = (ring - 1) * kCellSize + 1;
+      if (Distance(metric, gap, 0) > bestDist) break;
+    }
+    for (int gy = cy - ring; gy <= cy + ring; ++gy) {
+      if (gy < 0 || gy >= cellsY_) continue;
+      const bool edgeRow = (gy == cy - ring || gy == cy + ring);
+      const int step = edgeRow ? 1 : 2 * ring;
+      for (int gx = cx - ring; gx <= cx + ring; gx += (step > 0 ? step : 1)) {
+        if (gx < 0 || gx >= cellsX_) continue;
+        for (int index : Cell(gx, gy)) {
+          const Center& center = centers_[static_cast<size_t>(index)];
+          const int dist = Distance(metric, center.x - x, center.y - y);
+          if (bestIndex >= 0 && (dist > bestDist || (dist == bestDist && index > bestIndex))) {
+            continue;
+          }
+          if (!accept(index)) continue;
+          bestIndex = index;
+          bestDist = dist;
+        }
+      }
+    }
+  }
+  if (bestIndex >= 0) outDist = bestDist;
+  return bestIndex;
+}
+
 struct Settlement {
-  static constexpr int kTaskCap = 2048;
+  static constexpr int kTaskCap = TaskStore::kMaxTasks + 1;
   static constexpr int kHouseCapacity = 10;
   static constexpr int kTownHallCapacity = 8;
   static constexpr int kHouseWoodCost = 6;
@@ -87,6 +303,9 @@ struct Settlement {
   int defenseTargetX = 0;
   int defenseTargetY = 0;
   bool hasDefenseTarget = false;
+  // Ids of member soldiers, ascending; formation slots follow this order. Rebuilt by role
+  // targeting, extended by war-start mobilization, and pruned of the dead by UpdateArmyOrders.
+  std::vector<int> armyRoster;
 
   // Debug: role allocation snapshot for the last UpdateDaily.
   bool debugFoodEmergency = false;
@@ -114,70 +333,27 @@ struct Settlement {
   int macroArmyEtaDays = 0;
   bool macroArmySieging = false;
 
-  int macroPopM[6] = {};
-  int macroPopF[6] = {};
-  float macroBirthAccum = 0.0f;
-  float macroFarmFoodAccum = 0.0f;
-  float macroFoodNeedAccum = 0.0f;
-
-  Task tasks[kTaskCap];
-  int taskHead = 0;
-  int taskTail = 0;
-
-  bool PushTask(const Task& task) {
-    int next = (taskTail + 1) % kTaskCap;
-    if (next == taskHead) return false;
-    tasks[taskTail] = task;
-    taskTail = next;
-    return true;
-  }
-
-  bool PopTask(Task& out) {
-    if (taskHead == taskTail) return false;
-    out = tasks[taskHead];
-    taskHead = (taskHead + 1) % kTaskCap;
-    return true;
-  }
-
-  int TaskCount() const {
-    int count = taskTail - taskHead;
-    if (count < 0) count += kTaskCap;
-    return count;
-  }
-
-  void ClearMacroPools() {
-    for (int i = 0; i < 6; ++i) {
-      macroPopM[i] = 0;
-      macroPopF[i] = 0;
-    }
-    macroBirthAccum = 0.0f;
-    macroFarmFoodAccum = 0.0f;
-    macroFoodNeedAccum = 0.0f;
-    taskHead = 0;
-    taskTail = 0;
-  }
-
-  int MacroTotal() const {
-    int total = 0;
-    for (int i = 0; i < 6; ++i) {
-      total += macroPopM[i] + macroPopF[i];
-    }
-    return total;
-  }
+  // Handle into SettlementManager's task store arena; -1 until tasks are first generated.
+  int taskStore = -1;
 };
 
 class SettlementManager {
  public:
   void SetRebellionsEnabled(bool enabled) { rebellionsEnabled_ = enabled; }
+  // Threads for the per-settlement daily phases; 0 picks a count from the hardware.
+  void SetWorkerThreads(int count) { workerThreads_ = (count > 0) ? count : 0; }
+  int WorkerThreads() const { return workerThreads_; }
   void UpdateDaily(World& world, HumanManager& humans, Random& rng, int dayCount, int dayDelta,
                    std::vector<VillageMarker>& markers, FactionManager& factions);
-  void UpdateMacro(World& world, Random& rng, int dayCount, std::vector<VillageMarker>& markers,
-                   FactionManager& factions);
+  // Spatial passes (zone owners, founding, water targets, building placement) run once per call
+  // whatever dayDelta is, so batched macro steps pay for them once per batch.
+  void UpdateMacro(World& world, Random& rng, int dayCount, int dayDelta,
+                   std::vector<VillageMarker>& markers, FactionManager& factions);
   void UpdateArmyOrders(World& world, HumanManager& humans, Random& rng, int dayCount, int dayDelta,
                         FactionManager& factions);
   void MobilizeForWarStart(HumanManager& humans, Random& rng, const FactionManager& factions,
                            const std::vector<int>& warIdsStarted);
-  void RefreshBuildingStats(const World& world) { RecomputeSettlementBuildings(world); }
+  void RefreshBuildingStats(World& world) { ApplyBuildingEvents(world); }
   int ConsumeWarDeaths();
   void AddWarDeaths(int count) {
     if (count > 0) warDeathsPending_ += count;
@@ -187,6 +363,20 @@ class SettlementManager {
   const std::vector<Settlement>& Settlements() const { return settlements_; }
   std::vector<Settlement>& SettlementsMutable() { return settlements_; }
 
+  const TaskStore& Tasks(const Settlement& settlement) const;
+  bool PushTask(Settlement& settlement, const Task& task);
+  // Claims the settlement's nearest queued task to (x, y) whose type is in typeMask.
+  bool ClaimNearestTask(Settlement& settlement, int x, int y, uint32_t typeMask, Task& out);
+  int TaskCount(const Settlement& settlement) const { return Tasks(settlement).Count(); }
+  void ClearTasks(Settlement& settlement);
+  const SettlementIndex& Index() const { return index_; }
+  const BuildingRegistry& Buildings(const Settlement& settlement) const;
+  // Macro-mode age cohorts, one slot per settlement in Settlements() order.
+  const MacroCohorts& MacroPools() const { return macroPools_; }
+  MacroCohorts& MacroPoolsMutable() { return macroPools_; }
+  int MacroTotal(const Settlement& settlement) const;
+  void ClearMacroPools(const Settlement& settlement);
+
   bool HasSettlement(int settlementId) const;
   const Settlement* Get(int settlementId) const;
   Settlement* GetMutable(int settlementId);
@@ -195,10 +385,14 @@ class SettlementManager {
   int ZonePopAt(int zx, int zy) const;
   int ZoneConflictAt(int zx, int zy) const;
   int ZoneSize() const { return zoneSize_; }
+  // Hash of every settlement including queued tasks; zone caches are derived and left out.
+  uint64_t StateHash() const;
   int ZonesX() const { return zonesX_; }
   int ZonesY() const { return zonesY_; }
 
  private:
+  friend struct BenchAccess;
+
   static uint64_t PackZone(int zx, int zy) {
     return (static_cast<uint64_t>(static_cast<uint32_t>(zx)) << 32) |
            static_cast<uint64_t>(static_cast<uint32_t>(zy));
@@ -213,12 +407,17 @@ class SettlementManager {
   void RecomputeZonePopMacro();
   void TryFoundNewSettlements(World& world, Random& rng, int dayCount,
                               std::vector<VillageMarker>& markers, FactionManager& factions);
-  void RecomputeZoneOwners(const World& world);
+  void UpdateZoneOwners(const World& world);
   void UpdateZoneConflict(const FactionManager& factions);
-  void AssignHumansToSettlements(HumanManager& humans);
+  // The day's main human sweep: assigns homes, counts members into memberCounts_ and
+  // memberSlotByHuman_, and takes HumanManager's daily crowd census along the way.
+  void AssignHumansToSettlements(const World& world, HumanManager& humans);
   void RecomputeSettlementBuildings(const World& world);
+  void ApplyBuildingEvents(World& world);
+  bool VerifyBuildingStats(const World& world) const;
   void UpdateSettlementCaps();
-  void ComputeSettlementWaterTargets(const World& world);
+  void ComputeSettlementWaterTargets(World& world);
+  void RebuildWaterRow(const World& world, int y);
   void RecomputeSettlementPopAndRoles(World& world, Random& rng, int dayCount, int dayDelta,
                                       HumanManager& humans, const FactionManager& factions);
   void UpdateSettlementRoleStatsMacro(World& world, const FactionManager& factions, int dayCount);
@@ -236,17 +435,49 @@ class SettlementManager {
                                 FactionManager& factions);
   void UpdateBorderPressure(const FactionManager& factions);
   void GenerateTasks(World& world, Random& rng, const FactionManager& factions, int dayCount);
-  void RunSettlementEconomy(World& world, Random& rng);
+  void GenerateSettlementTasks(Settlement& settlement, const World& world, Random& rng);
+  void RunSettlementEconomy(World& world, Random& rng, int dayCount);
+  void PlanSettlementEconomy(const Settlement& settlement, const World& world, Random& rng,
+                             WorldCommandBuffer& commands) const;
+  TaskStore& AcquireTasks(Settlement& settlement);
+  template <typename Fn>
+  void ParallelForSettlements(Fn&& fn);
   void EnsureSettlementFactions(FactionManager& factions, Random& rng);
+  void SetSettlementFaction(Settlement& settlement, int factionId);
+  void AddToArmyRoster(const Human& human);
+
+  // Enemy settlements as seen from one side of a war, highest strategic value first (ties by
+  // settlement index), so target scoring can stop once distance can no longer be outweighed.
+  struct WarTargetCandidate {
+    int index = 0;
+    int value = 0;
+  };
+  struct WarTargetList {
+    int warId = -1;
+    bool attackerSide = false;
+    bool preferPopulated = false;
+    std::vector<WarTargetCandidate> candidates;
+  };
 
   struct ClaimSource {
     int x = 0;
     int y = 0;
     int radius = 0;
   };
+  struct ZoneClaim {
+    int settlementIndex = 0;
+    int distSq = 0;
+  };
+
+  void ApplyClaimSource(const World& world, int settlementIndex, const ClaimSource& source,
+                        bool add);
+  void ResetZoneClaims();
 
   int nextId_ = 1;
   std::vector<Settlement> settlements_;
+  // Task stores live out of line so Settlement stays small; indexed by Settlement::taskStore.
+  std::vector<TaskStore> taskStores_;
+  SettlementIndex index_;
 
   int zoneSize_ = 8;
   int zonesX_ = 0;
@@ -261,11 +492,16 @@ class SettlementManager {
   std::vector<int> zoneDenseDaysByIndex_;
   std::vector<int> denseZoneIndices_;
 
+  // Zone ownership is kept incrementally: every zone holds one claim per source disc covering it,
+  // and only zones under added or removed sources are re-evaluated. The stamp marks zones
+  // touched by the current update.
   uint32_t zoneOwnerGeneration_ = 1;
   std::vector<uint32_t> zoneOwnerStampByIndex_;
   std::vector<int> zoneOwnerByIndex_;
-  std::vector<int> zoneOwnerBestDistSqByIndex_;
+  std::vector<int> ownedZoneSlotByIndex_;
   std::vector<int> ownedZoneIndices_;
+  std::vector<int> touchedZoneIndices_;
+  std::vector<std::vector<ZoneClaim>> zoneClaims_;
 
   uint32_t zoneConflictGeneration_ = 1;
   std::vector<uint32_t> zoneConflictStampByIndex_;
@@ -274,8 +510,38 @@ class SettlementManager {
   std::vector<int> memberCounts_;
   std::vector<int> memberOffsets_;
   std::vector<int> memberIndices_;
+  // Settlement index of each human from the assignment sweep, -1 for the dead and unassigned.
+  std::vector<int> memberSlotByHuman_;
   std::vector<int> idToIndex_;
   std::vector<std::vector<ClaimSource>> claimSources_;
+  std::vector<BuildingRegistry> buildingRegistries_;
+  MacroCohorts macroPools_;
+  // Sources currently rasterized into zoneClaims_, sorted per settlement.
+  std::vector<std::vector<ClaimSource>> appliedClaimSources_;
+  bool claimSourcesDirty_ = true;
+  // Settlements whose building counters are maintained by ApplyBuildingEvents.
+  int buildingStatsCount_ = 0;
+  std::vector<BuildingEvent> buildingEvents_;
+  std::vector<int> influenceDirtyIndices_;
+  // Row pass of a multi-source distance transform over fresh water and supplied wells: the x of
+  // the nearest source in the same row (ties to the left), or -1. Rows and cached water targets
+  // are only redone around tiles reported by World::ConsumeWaterSourceEvents.
+  int waterRowsWidth_ = 0;
+  int waterRowsHeight_ = 0;
+  std::vector<int> waterRowNearestX_;
+  std::vector<uint8_t> waterRowDirty_;
+  std::vector<uint8_t> waterTargetValid_;
+  std::vector<WaterSourceEvent> waterEvents_;
+  std::vector<int> waterDirtySettlements_;
+  // One buffer per settlement index, filled by parallel phases and applied in index order.
+  std::vector<WorldCommandBuffer> worldCommands_;
+  // Built on demand per UpdateArmyOrders call; the first warTargetListCount_ entries are live.
+  std::vector<WarTargetList> warTargetLists_;
+  int warTargetListCount_ = 0;
+  // Humans given army orders by the last UpdateArmyOrders; only they can hold non-default army
+  // fields, so only they are reset before new orders go out.
+  std::vector<int> armyOrderIds_;
+  int workerThreads_ = 0;
   int warDeathsPending_ = 0;
   bool homeFieldDirty_ = true;
   bool rebellionsEnabled_ = true;
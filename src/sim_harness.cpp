@@ -0,0 +1,201 @@
+#include "sim_harness.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+namespace {
+constexpr int kNoiseCell = 16;
+constexpr int kOceanBorder = 4;
+constexpr int kSpawnClusterSize = 40;
+constexpr int kSpawnRadius = 6;
+
+void AgeVillageMarkers(std::vector<VillageMarker>& markers, int days) {
+  for (auto& marker : markers) marker.ttlDays = std::max(0, marker.ttlDays - days);
+  markers.erase(std::remove_if(markers.begin(), markers.end(),
+                               [](const VillageMarker& marker) { return marker.ttlDays <= 0; }),
+                markers.end());
+}
+}  // namespace
+
+void SimStepTick(const SimSystems& sim, int tickCount, float tickSeconds, int ticksPerDay) {
+  FUNSIM_PROFILE_ZONE("StepTick");
+  SimFrameArena().Reset();
+  CrashContextSetTick(tickCount);
+  CrashContextSetStage("StepTick:Humans");
+  sim.humans.UpdateTick(sim.world, sim.settlements, sim.rng, tickCount, tickSeconds, ticksPerDay);
+}
+
+SimStepCounts SimStepDayCoarse(const SimSystems& sim, int& dayCount, int dayDelta) {
+  FUNSIM_PROFILE_ZONE("StepDayCoarse");
+  FUNSIM_PROFILE_PHASES(phase);
+  if (dayDelta < 1) dayDelta = 1;
+  SimStepCounts counts;
+  dayCount += dayDelta;
+  CrashContextSetDay(dayCount);
+  SimFrameArena().Reset();
+  std::pmr::vector<int> warsBefore(&SimFrameArena());
+  for (const auto& war : sim.factions.Wars()) {
+    if (war.active) warsBefore.push_back(war.id);
+  }
+  FUNSIM_PROFILE_NEXT(phase, "StepDay:World");
+  CrashContextSetStage("StepDay:World");
+  sim.world.UpdateDaily(sim.rng, dayDelta);
+  FUNSIM_PROFILE_NEXT(phase, "StepDay:Settlements");
+  CrashContextSetStage("StepDay:Settlements");
+  sim.settlements.UpdateDaily(sim.world, sim.humans, sim.rng, dayCount, dayDelta, sim.markers,
+                              sim.factions);
+  const int warDeaths = sim.settlements.ConsumeWarDeaths();
+  FUNSIM_PROFILE_NEXT(phase, "StepDay:Humans");
+  CrashContextSetStage("StepDay:Humans");
+  sim.humans.UpdateDailyCoarse(sim.world, sim.settlements, sim.rng, dayCount, dayDelta,
+                               counts.births, counts.deaths);
+  counts.deaths += warDeaths;
+  AgeVillageMarkers(sim.markers, dayDelta);
+  FUNSIM_PROFILE_NEXT(phase, "StepDay:Factions");
+  CrashContextSetStage("StepDay:Factions");
+  sim.factions.UpdateStats(sim.settlements);
+  sim.factions.UpdateLeaders(sim.humans);
+  sim.factions.UpdateDiplomacy(sim.settlements, sim.rng, dayCount);
+  std::vector<int> warsStarted;
+  for (const auto& war : sim.factions.Wars()) {
+    if (!war.active) continue;
+    if (std::find(warsBefore.begin(), warsBefore.end(), war.id) != warsBefore.end()) continue;
+    warsStarted.push_back(war.id);
+  }
+  if (!warsStarted.empty()) {
+    sim.settlements.MobilizeForWarStart(sim.humans, sim.rng, sim.factions, warsStarted);
+  }
+  FUNSIM_PROFILE_NEXT(phase, "StepDay:ArmyOrders");
+  CrashContextSetStage("StepDay:ArmyOrders");
+  sim.settlements.UpdateArmyOrders(sim.world, sim.humans, sim.rng, dayCount, dayDelta,
+                                   sim.factions);
+  CrashContextSetStage("StepDay:Done");
+  return counts;
+}
+
+SimStepCounts SimStepMacroDays(const SimSystems& sim, int& dayCount, int days) {
+  SimStepCounts counts;
+  if (days <= 0) return counts;
+  FUNSIM_PROFILE_ZONE("AdvanceMacro");
+  const int weeksBefore = dayCount / 7;
+  dayCount += days;
+  CrashContextSetDay(dayCount);
+  SimFrameArena().Reset();
+  // World upkeep runs weekly; a batch spanning several weeks applies them as one delta.
+  const int weeks = dayCount / 7 - weeksBefore;
+  if (weeks > 0) sim.world.UpdateDaily(sim.rng, weeks);
+  sim.humans.AdvanceMacro(sim.world, sim.settlements, sim.rng, days, counts.births,
+                          counts.deaths);
+  sim.settlements.UpdateMacro(sim.world, sim.rng, dayCount, days, sim.markers, sim.factions);
+  const int warDeaths = sim.settlements.ConsumeWarDeaths();
+  sim.humans.RecordWarDeaths(warDeaths);
+  counts.deaths += warDeaths;
+  AgeVillageMarkers(sim.markers, days);
+  sim.factions.UpdateStats(sim.settlements);
+  sim.factions.UpdateDiplomacy(sim.settlements, sim.rng, dayCount);
+  return counts;
+}
+
+void SimHarness::StepTick() {
+  SimStepTick(Systems(), tickCount, tickSeconds, ticksPerDay);
+  tickCount++;
+}
+
+void SimHarness::StepDayCoarse(int dayDelta) {
+  const SimStepCounts counts = SimStepDayCoarse(Systems(), dayCount, dayDelta);
+  births += counts.births;
+  deaths += counts.deaths;
+}
+
+void SimHarness::AdvanceTicks(int count) {
+  for (int t = 0; t < count; ++t) {
+    StepTick();
+    if ((tickCount % ticksPerDay) == 0) StepDayCoarse(kCalendarDaysPerCoarseDay);
+  }
+}
+
+void SimHarness::StepDayMicro() {
+  AdvanceTicks(ticksPerDay);
+}
+
+void SimHarness::StepMacroDays(int days) {
+  const SimStepCounts counts = SimStepMacroDays(Systems(), dayCount, days);
+  births += counts.births;
+  deaths += counts.deaths;
+}
+
+int64_t SimHarness::Population() const {
+  if (humans.MacroActive() || humans.MacroExitPending()) {
+    return humans.MacroPopulation(settlements);
+  }
+  return humans.CountAlive();
+}
+
+void GenerateIslandTerrain(World& world, uint32_t seed) {
+  const int w = world.width();
+  const int h = world.height();
+  const int latticeW = w / kNoiseCell + 2;
+  const int latticeH = h / kNoiseCell + 2;
+  const uint64_t key = RngKey(seed, 0, 0, RngPurpose::General);
+  std::vector<float> lattice(static_cast<size_t>(latticeW) * static_cast<size_t>(latticeH));
+  for (size_t i = 0; i < lattice.size(); ++i) lattice[i] = RngFloat01(RngAt(key, i));
+
+  auto latticeAt = [&](int lx, int ly) {
+    return lattice[static_cast<size_t>(ly * latticeW + lx)];
+  };
+
+  Random rng(seed ^ 0x9e3779b9u);
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      const float fx = static_cast<float>(x) / kNoiseCell;
+      const float fy = static_cast<float>(y) / kNoiseCell;
+      const int lx = static_cast<int>(fx);
+      const int ly = static_cast<int>(fy);
+      const float tx = fx - static_cast<float>(lx);
+      const float ty = fy - static_cast<float>(ly);
+      const float top = latticeAt(lx, ly) + (latticeAt(lx + 1, ly) - latticeAt(lx, ly)) * tx;
+      const float bottom =
+          latticeAt(lx, ly + 1) + (latticeAt(lx + 1, ly + 1) - latticeAt(lx, ly + 1)) * tx;
+      const float noise = top + (bottom - top) * ty;
+      const int edge = std::min(std::min(x, y), std::min(w - 1 - x, h - 1 - y));
+
+      world.EditTile(x, y, [&](Tile& tile) {
+        if (edge < kOceanBorder) {
+          tile.type = TileType::Ocean;
+        } else if (noise < 0.14f) {
+          tile.type = TileType::FreshWater;
+        } else {
+          tile.type = TileType::Land;
+          if (noise > 0.6f) tile.trees = static_cast<uint8_t>(rng.RangeInt(1, 6));
+          if (rng.Chance(0.08f)) tile.food = static_cast<uint8_t>(rng.RangeInt(1, 5));
+        }
+      });
+    }
+  }
+}
+
+int SpawnClusteredPopulation(const World& world, HumanManager& humans, Random& rng,
+                             int population) {
+  const int w = world.width();
+  const int h = world.height();
+  if (w <= kOceanBorder * 2 || h <= kOceanBorder * 2) return 0;
+  int spawned = 0;
+  int attempts = 0;
+  while (spawned < population && attempts < population * 100 + 1000) {
+    const int cx = rng.RangeInt(kOceanBorder, w - 1 - kOceanBorder);
+    const int cy = rng.RangeInt(kOceanBorder, h - 1 - kOceanBorder);
+    attempts++;
+    if (world.At(cx, cy).type != TileType::Land) continue;
+    const int cluster = std::min(kSpawnClusterSize, population - spawned);
+    for (int i = 0; i < cluster * 4 && spawned < population; ++i) {
+      const int x = cx + rng.RangeInt(-kSpawnRadius, kSpawnRadius);
+      const int y = cy + rng.RangeInt(-kSpawnRadius, kSpawnRadius);
+      if (!world.InBounds(x, y) || world.At(x, y).type != TileType::Land) continue;
+      humans.Spawn(x, y, (spawned % 2) == 1, rng);
+      spawned++;
+      if (spawned % kSpawnClusterSize == 0) break;
+    }
+  }
+  return spawned;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "factions.h"
+#include "humans.h"
+#include "settlements.h"
+#include "util.h"
+#include "world.h"
+
+// The systems one simulation step touches. App and SimHarness both step through the SimStep*
+// functions below, so the GUI, headless runs and replays share a single step order.
+struct SimSystems {
+  World& world;
+  HumanManager& humans;
+  SettlementManager& settlements;
+  FactionManager& factions;
+  Random& rng;
+  std::vector<VillageMarker>& markers;
+};
+
+struct SimStepCounts {
+  int births = 0;
+  // Includes war deaths.
+  int deaths = 0;
+};
+
+void SimStepTick(const SimSystems& sim, int tickCount, float tickSeconds, int ticksPerDay);
+// Advances dayCount by dayDelta and runs the daily world, settlement, human, faction and army
+// passes.
+SimStepCounts SimStepDayCoarse(const SimSystems& sim, int& dayCount, int dayDelta);
+// Advances dayCount by days as one macro step. Past one day, cohorts move in a single batched
+// update and the spatial settlement passes run once for the whole batch.
+SimStepCounts SimStepMacroDays(const SimSystems& sim, int& dayCount, int days);
+
+// Display-free driver shared by funsim_headless, funsim_bench and replay playback; App steps
+// through the same SimStep* functions and adds the UI-only bookkeeping.
+class SimHarness {
+ public:
+  static constexpr int kCalendarDaysPerCoarseDay = 30;
+
+  World world{0, 0};
+  HumanManager humans;
+  SettlementManager settlements;
+  FactionManager factions;
+  Random rng;
+  std::vector<VillageMarker> markers;
+  int tickCount = 0;
+  int dayCount = 0;
+  int ticksPerDay = 50;
+  float tickSeconds = 0.1f;
+  int64_t births = 0;
+  int64_t deaths = 0;
+
+  void StepTick();
+  // Steps count ticks on the app's cadence: a coarse day runs whenever tickCount reaches a
+  // multiple of ticksPerDay.
+  void AdvanceTicks(int count);
+  void StepDayCoarse(int dayDelta);
+  // One coarse day: ticksPerDay ticks followed by StepDayCoarse(kCalendarDaysPerCoarseDay).
+  void StepDayMicro();
+  // Advances days calendar days as one macro step; see SimStepMacroDays.
+  void StepMacroDays(int days);
+  void StepDayMacro() { StepMacroDays(1); }
+  int64_t Population() const;
+  SimSystems Systems() { return {world, humans, settlements, factions, rng, markers}; }
+};
+
+// Seeded value-noise island: ocean rim, lakes in the low spots and forest on the highs.
+void GenerateIslandTerrain(World& world, uint32_t seed);
+// Spawns humans in small clusters on random land tiles; returns how many were placed.
+int SpawnClusteredPopulation(const World& world, HumanManager& humans, Random& rng,
+                             int population);
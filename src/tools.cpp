@@ -1,5 +1,11 @@
 #include "tools.h"
 
+#include <algorithm>
+
+#include "humans.h"
+#include "util.h"
+#include "world.h"
+
 const char* ToolName(ToolType tool) {
   switch (tool) {
     case ToolType::SelectKingdom:
@@ -26,3 +32,97 @@ const char* ToolName(ToolType tool) {
       return "Unknown";
   }
 }
+
+bool ApplyTool(World& world, HumanManager& humans, Random& rng, ToolType tool, int tileX,
+               int tileY, int brushSize, bool erase) {
+  int radius = brushSize / 2;
+  bool spawned = false;
+
+  for (int dy = -radius; dy <= radius; ++dy) {
+    for (int dx = -radius; dx <= radius; ++dx) {
+      int x = tileX + dx;
+      int y = tileY + dy;
+      if (!world.InBounds(x, y)) continue;
+
+      if (erase) {
+        world.EraseAt(x, y);
+      } else {
+        switch (tool) {
+          case ToolType::SelectKingdom:
+            break;
+          case ToolType::PlaceLand:
+            world.SetTileType(x, y, TileType::Land);
+            break;
+          case ToolType::PlaceFreshWater:
+            world.EditTile(x, y, [&](Tile& tile) {
+              tile.type = TileType::FreshWater;
+              tile.trees = 0;
+              tile.food = 0;
+              tile.burning = false;
+              tile.burnDaysRemaining = 0;
+              tile.building = BuildingType::None;
+              tile.farmStage = 0;
+              tile.buildingOwnerId = -1;
+            });
+            world.MarkBuildingDirty();
+            break;
+          case ToolType::AddTrees:
+            world.EditTile(x, y, [&](Tile& tile) {
+              if (tile.type != TileType::Land) return;
+              int trees = static_cast<int>(tile.trees);
+              trees = std::min(20, trees + 5);
+              tile.trees = static_cast<uint8_t>(trees);
+            });
+            break;
+          case ToolType::AddFood:
+            world.EditTile(x, y, [&](Tile& tile) {
+              if (tile.type != TileType::Land) return;
+              int food = static_cast<int>(tile.food);
+              food = std::min(50, food + 10);
+              tile.food = static_cast<uint8_t>(food);
+            });
+            break;
+          case ToolType::SpawnMale:
+            if (world.At(x, y).type != TileType::Ocean) {
+              humans.Spawn(x, y, false, rng);
+              CrashContextSetNote("ApplyToolAt: SpawnMale");
+              spawned = true;
+            }
+            break;
+          case ToolType::SpawnFemale:
+            if (world.At(x, y).type != TileType::Ocean) {
+              humans.Spawn(x, y, true, rng);
+              CrashContextSetNote("ApplyToolAt: SpawnFemale");
+              spawned = true;
+            }
+            break;
+          case ToolType::Fire:
+            if (world.At(x, y).type == TileType::Land && world.At(x, y).trees > 0) {
+              world.SetBurning(x, y, true, 4);
+            }
+            break;
+          case ToolType::Meteor:
+            world.EditTile(x, y, [&](Tile& tile) {
+              tile.type = TileType::Ocean;
+              tile.trees = 0;
+              tile.food = 0;
+              tile.burning = false;
+              tile.burnDaysRemaining = 0;
+              tile.building = BuildingType::None;
+              tile.farmStage = 0;
+              tile.buildingOwnerId = -1;
+            });
+            world.MarkBuildingDirty();
+            break;
+          case ToolType::GiftFood:
+            world.EditTile(x, y, [&](Tile& tile) {
+              if (tile.type != TileType::Land) return;
+              tile.food = 50;
+            });
+            break;
+        }
+      }
+    }
+  }
+  return spawned;
+}
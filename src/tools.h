@@ -1,5 +1,9 @@
 #pragma once
 
+class HumanManager;
+class Random;
+class World;
+
 enum class ToolType {
   SelectKingdom,
   PlaceLand,
@@ -14,3 +18,7 @@ enum class ToolType {
 };
 
 const char* ToolName(ToolType tool);
+// Applies a brush of brushSize tiles centred on (tileX, tileY); erase clears instead. Returns
+// true if any human was spawned.
+bool ApplyTool(World& world, HumanManager& humans, Random& rng, ToolType tool, int tileX,
+               int tileY, int brushSize, bool erase);
@@ -3,11 +3,13 @@
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
+#include <vector>
 
 #include <imgui.h>
 
 #include "factions.h"
 #include "humans.h"
+#include "profiler.h"
 #include "settlements.h"
 
 namespace {
@@ -24,14 +26,107 @@ void CopyToBuf(char* dst, size_t dstSize, const std::string& src) {
   dst[dstSize - 1] = '\0';
 }
 
-const Human* FindHumanById(const HumanManager& humans, int id) {
-  if (id <= 0) return nullptr;
-  for (const auto& human : humans.Humans()) {
-    if (!human.alive) continue;
-    if (human.id == id) return &human;
+float HueForName(const char* name) {
+  uint32_t hash = 2166136261u;
+  for (const char* c = name; *c; ++c) hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+  return static_cast<float>(hash % 360u) / 360.0f;
+}
+
+void DrawFlameGraph(const ProfileFrame& frame) {
+  constexpr float kRowHeight = 18.0f;
+  const double spanNs = static_cast<double>(frame.endNs - frame.startNs);
+  if (spanNs <= 0.0) return;
+  int maxDepth = 0;
+  for (const ProfileEvent& event : frame.events) maxDepth = std::max(maxDepth, event.depth);
+
+  const ImVec2 origin = ImGui::GetCursorScreenPos();
+  const float width = std::max(1.0f, ImGui::GetContentRegionAvail().x);
+  const float height = static_cast<float>(maxDepth + 1) * kRowHeight;
+  ImGui::InvisibleButton("##flame", ImVec2(width, height));
+  ImDrawList* draw = ImGui::GetWindowDrawList();
+  for (const ProfileEvent& event : frame.events) {
+    const float t0 = static_cast<float>((event.startNs - frame.startNs) / spanNs);
+    const float t1 = static_cast<float>((event.endNs - frame.startNs) / spanNs);
+    const float x0 = origin.x + t0 * width;
+    const float x1 = std::max(x0 + 1.0f, origin.x + t1 * width);
+    const float y0 = origin.y + static_cast<float>(event.depth) * kRowHeight;
+    const ImVec2 min(x0, y0);
+    const ImVec2 max(x1, y0 + kRowHeight - 1.0f);
+    draw->AddRectFilled(min, max, ImColor::HSV(HueForName(event.name), 0.55f, 0.75f));
+    if (x1 - x0 > 40.0f) {
+      draw->PushClipRect(min, max, true);
+      draw->AddText(ImVec2(x0 + 3.0f, y0 + 2.0f), IM_COL32_WHITE, event.name);
+      draw->PopClipRect();
+    }
+    if (ImGui::IsMouseHoveringRect(min, max)) {
+      ImGui::SetTooltip("%s: %.3f ms", event.name,
+                        static_cast<double>(event.endNs - event.startNs) * 1e-6);
+    }
+  }
+}
+
+void DrawProfilerWindow(UIState& state) {
+  bool open = true;
+  ImGui::Begin("Profiler", &open);
+  bool enabled = ProfilerEnabled();
+  if (ImGui::Checkbox("Record", &enabled)) ProfilerSetEnabled(enabled);
+  ImGui::SameLine();
+  if (ImGui::Button("Dump Chrome Trace (F9)")) state.profilerDumpTrace = true;
+  ImGui::SameLine();
+  ImGui::Checkbox("Show Worst Frame", &state.profilerShowWorstFrame);
+
+  static std::vector<float> frameTimes;
+  ProfilerFrameTimesMs(frameTimes, kProfilerStatSamples);
+  if (!frameTimes.empty()) {
+    const float maxMs = *std::max_element(frameTimes.begin(), frameTimes.end());
+    ImGui::PlotLines("Frame ms", frameTimes.data(), static_cast<int>(frameTimes.size()), 0,
+                     nullptr, 0.0f, std::max(maxMs, 16.7f), ImVec2(0.0f, 60.0f));
+  }
+
+  const int age = state.profilerShowWorstFrame ? ProfilerWorstFrameAge(kProfilerStatSamples) : 0;
+  const ProfileFrame* frame = ProfilerFrame(age);
+  if (frame) {
+    ImGui::Text("%s frame #%llu: %.2f ms", state.profilerShowWorstFrame ? "Worst" : "Latest",
+                static_cast<unsigned long long>(frame->index),
+                static_cast<double>(frame->endNs - frame->startNs) * 1e-6);
+    DrawFlameGraph(*frame);
+  }
+
+  const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                                ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY;
+  if (ImGui::BeginTable("ProfilerZones", 7, flags, ImVec2(0.0f, 320.0f))) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Zone", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableSetupColumn("Last ms");
+    ImGui::TableSetupColumn("p50");
+    ImGui::TableSetupColumn("p95");
+    ImGui::TableSetupColumn("p99");
+    ImGui::TableSetupColumn("Max");
+    ImGui::TableHeadersRow();
+    for (const ProfileZoneStats& zone : ProfilerZoneStats()) {
+      ImGui::TableNextRow();
+      ImGui::TableSetColumnIndex(0);
+      ImGui::Text("%*s%s", zone.depth * 2, "", zone.name);
+      ImGui::TableSetColumnIndex(1);
+      ImGui::Text("%d", zone.callsLastFrame);
+      ImGui::TableSetColumnIndex(2);
+      ImGui::Text("%.3f", zone.lastMs);
+      ImGui::TableSetColumnIndex(3);
+      ImGui::Text("%.3f", zone.p50Ms);
+      ImGui::TableSetColumnIndex(4);
+      ImGui::Text("%.3f", zone.p95Ms);
+      ImGui::TableSetColumnIndex(5);
+      ImGui::Text("%.3f", zone.p99Ms);
+      ImGui::TableSetColumnIndex(6);
+      ImGui::Text("%.3f", zone.maxMs);
+    }
+    ImGui::EndTable();
   }
-  return nullptr;
+  ImGui::End();
+  if (!open) state.profilerOpen = false;
 }
+
 }  // namespace
 
 void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
@@ -40,6 +135,8 @@ void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
   state.saveMap = false;
   state.loadMap = false;
   state.newWorld = false;
+  state.startReplayRecording = false;
+  state.stopReplayRecording = false;
   state.requestArmyOrdersRefresh = false;
 
   ImGui::Begin("Tools");
@@ -47,6 +144,7 @@ void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
   ImGui::Separator();
   ImGui::Text("Debug");
   ImGui::Checkbox("War Debug Window", &state.warDebugOpen);
+  ImGui::Checkbox("Profiler Window", &state.profilerOpen);
   ImGui::Separator();
   for (ToolType tool : kToolOrder) {
     bool selected = (state.tool == tool);
@@ -95,6 +193,23 @@ void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
     state.newWorld = true;
   }
 
+  ImGui::Separator();
+  ImGui::Text("Replay");
+  ImGui::InputText("Replay Path", state.replayPath, sizeof(state.replayPath));
+  if (state.replayRecording) {
+    if (ImGui::Button("Stop Recording")) {
+      state.stopReplayRecording = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextColored(ImVec4(1.0f, 0.35f, 0.35f, 1.0f), "REC");
+  } else if (ImGui::Button("Record Replay")) {
+    state.startReplayRecording = true;
+  }
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip("Restarts the simulation on the current terrain and records inputs plus\n"
+                      "daily state hashes. Verify with funsim_headless --replay PATH.");
+  }
+
   ImGui::Separator();
   if (ImGui::Button(state.paused ? "Play" : "Pause")) {
     state.paused = !state.paused;
@@ -476,7 +591,7 @@ void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
           ImGui::Text("Defense target (%d,%d)", settlement->defenseTargetX, settlement->defenseTargetY);
         }
 
-        const Human* general = FindHumanById(humans, settlement->generalHumanId);
+        const Human* general = humans.FindById(settlement->generalHumanId);
         if (general) {
           ImGui::Text("General #%d pos (%d,%d) state %s", general->id, general->x, general->y,
                       ArmyStateName(general->armyState));
@@ -566,6 +681,10 @@ void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
     if (!open) state.warDebugOpen = false;
   }
 
+  if (state.profilerOpen) {
+    DrawProfilerWindow(state);
+  }
+
   ImGui::Begin("Settlement Economy");
   if (settlements.Count() == 0) {
     ImGui::Text("No settlements yet.");
@@ -601,9 +720,9 @@ void DrawUI(UIState& state, const SimStats& stats, FactionManager& factions,
     int harvestTasks = 0;
     int haulDistanceSum = 0;
     int haulDistanceCount = 0;
-    for (int idx = settlement.taskHead; idx != settlement.taskTail;
-         idx = (idx + 1) % Settlement::kTaskCap) {
-      const Task& task = settlement.tasks[idx];
+    const TaskStore& queue = settlements.Tasks(settlement);
+    for (int i = 0; i < queue.Count(); ++i) {
+      const Task& task = queue.At(i);
       if (task.type == TaskType::HarvestFarm) {
         harvestTasks++;
       }
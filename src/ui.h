@@ -72,6 +72,10 @@ struct UIState {
   bool saveMap = false;
   bool loadMap = false;
   char mapPath[256] = "maps/map.fmap";
+  char replayPath[256] = "replays/replay.frep";
+  bool startReplayRecording = false;
+  bool stopReplayRecording = false;
+  bool replayRecording = false;
 
   int selectedFactionId = -1;
   bool factionEditorOpen = false;
@@ -81,6 +85,10 @@ struct UIState {
   char factionLeaderNameBuf[96] = "";
   char factionLeaderTitleBuf[96] = "";
 
+  bool profilerOpen = false;
+  bool profilerShowWorstFrame = true;
+  bool profilerDumpTrace = false;
+
   bool warDebugOpen = false;
   int warDebugSettlementId = -1;
   int warDebugFactionId = -1;
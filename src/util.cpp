@@ -1,5 +1,6 @@
 #include "util.h"
 
+#include <algorithm>
 #include <atomic>
 #include <csignal>
 #include <cstdio>
@@ -25,15 +26,77 @@ struct CrashContextData {
   std::atomic<int> worldH{0};
   std::atomic<int> dayCount{0};
   std::atomic<int> population{0};
-  std::atomic<int> lastHumanId{-1};
-  std::atomic<int> lastHumanX{0};
-  std::atomic<int> lastHumanY{0};
-  char stage[64] = "startup";
-  char note[128] = "-";
+  std::atomic<const char*> note{"-"};
 };
 
 CrashContextData g_crash_context;
 
+constexpr int kFlightRecorderThreads = 64;
+constexpr uint32_t kFlightRecorderEvents = 256;
+constexpr int kFlightRecorderDumpEvents = 48;
+
+struct FlightEvent {
+  const char* stage = nullptr;
+  int32_t humanId = -1;
+  int32_t x = 0;
+  int32_t y = 0;
+  int32_t tick = 0;
+};
+
+// Single writer (the owning thread); the crash handler only reads.
+struct FlightRing {
+  std::atomic<bool> inUse{false};
+  std::atomic<uint32_t> head{0};
+  const char* stage = "startup";
+  int32_t tick = 0;
+  uint32_t sampleCounter = 0;
+  uint32_t ownerSerial = 0;
+  FlightEvent events[kFlightRecorderEvents];
+};
+
+FlightRing g_flight_rings[kFlightRecorderThreads];
+std::atomic<uint32_t> g_flight_serial{0};
+
+struct FlightRingOwner {
+  FlightRing* ring = nullptr;
+  ~FlightRingOwner() {
+    if (ring) ring->inUse.store(false, std::memory_order_release);
+  }
+};
+
+thread_local FlightRingOwner t_flight_owner;
+
+#if FUNSIM_FLIGHT_RECORDER
+FlightRing* ThreadFlightRing() {
+  FlightRing* ring = t_flight_owner.ring;
+  if (ring) return ring;
+  for (auto& candidate : g_flight_rings) {
+    bool expected = false;
+    if (candidate.inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+      candidate.head.store(0, std::memory_order_relaxed);
+      candidate.stage = "startup";
+      candidate.tick = 0;
+      candidate.sampleCounter = 0;
+      candidate.ownerSerial = g_flight_serial.fetch_add(1, std::memory_order_relaxed);
+      t_flight_owner.ring = &candidate;
+      return &candidate;
+    }
+  }
+  return nullptr;
+}
+
+void FlightRecord(FlightRing* ring, int humanId, int x, int y) {
+  const uint32_t head = ring->head.load(std::memory_order_relaxed);
+  FlightEvent& event = ring->events[head & (kFlightRecorderEvents - 1)];
+  event.stage = ring->stage;
+  event.humanId = humanId;
+  event.x = x;
+  event.y = y;
+  event.tick = ring->tick;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+#endif
+
 const char* SafeStr(const char* value) {
   return (value && value[0] != '\0') ? value : "unknown";
 }
@@ -73,14 +136,13 @@ void WriteCrashLogHeader(const char* reason) {
   std::fprintf(file, "==== Crash ====\n");
   std::fprintf(file, "time: %s\n", timebuf);
   std::fprintf(file, "reason: %s\n", reason ? reason : "unknown");
-  std::fprintf(file, "stage: %s\n", SafeStr(g_crash_context.stage));
-  std::fprintf(file, "note: %s\n", SafeStr(g_crash_context.note));
+  const FlightRing* ring = t_flight_owner.ring;
+  std::fprintf(file, "stage: %s\n", SafeStr(ring ? ring->stage : nullptr));
+  std::fprintf(file, "note: %s\n", SafeStr(g_crash_context.note.load()));
   std::fprintf(file, "world: %d x %d\n", g_crash_context.worldW.load(),
                g_crash_context.worldH.load());
   std::fprintf(file, "day: %d\n", g_crash_context.dayCount.load());
   std::fprintf(file, "population: %d\n", g_crash_context.population.load());
-  std::fprintf(file, "last human: id=%d pos=(%d,%d)\n", g_crash_context.lastHumanId.load(),
-               g_crash_context.lastHumanX.load(), g_crash_context.lastHumanY.load());
 #ifdef _WIN32
   std::fprintf(file, "pid: %lu tid: %lu\n",
                static_cast<unsigned long>(GetCurrentProcessId()),
@@ -99,6 +161,28 @@ void WriteCrashLogHeader(const char* reason) {
   std::fclose(file);
 }
 
+void WriteFlightRecorder() {
+  FILE* file = std::fopen("crash.log", "a");
+  if (!file) return;
+  const FlightRing* crashing = t_flight_owner.ring;
+  for (const auto& ring : g_flight_rings) {
+    const uint32_t head = ring.head.load(std::memory_order_acquire);
+    const bool live = ring.inUse.load(std::memory_order_acquire);
+    if (!live && head == 0) continue;
+    std::fprintf(file, "thread #%u%s%s: stage=%s tick=%d events=%u\n", ring.ownerSerial,
+                 (&ring == crashing) ? " [crashing]" : "", live ? "" : " [exited]",
+                 SafeStr(ring.stage), ring.tick, head);
+    const uint32_t shown = std::min<uint32_t>(head, kFlightRecorderDumpEvents);
+    for (uint32_t i = 0; i < shown; ++i) {
+      const FlightEvent& event = ring.events[(head - 1 - i) & (kFlightRecorderEvents - 1)];
+      std::fprintf(file, "  -%u %s tick=%d human=%d pos=(%d,%d)\n", i, SafeStr(event.stage),
+                   event.tick, event.humanId, event.x, event.y);
+    }
+  }
+  std::fflush(file);
+  std::fclose(file);
+}
+
 void WriteCrashStackSimple(void* const* stack, int count) {
   FILE* file = std::fopen("crash.log", "a");
   if (!file) return;
@@ -184,6 +268,7 @@ void WriteExceptionDetails(EXCEPTION_POINTERS* info) {
 
 void WriteCrashLog(const char* reason, void* const* stack, int count) {
   WriteCrashLogHeader(reason);
+  WriteFlightRecorder();
   WriteCrashStackSimple(stack, count);
 }
 
@@ -197,6 +282,7 @@ void HandleSignal(int sig) {
   char reason[32] = {};
   std::snprintf(reason, sizeof(reason), "signal %d", sig);
   WriteCrashLogHeader(reason);
+  WriteFlightRecorder();
   WriteCrashStackDetailed(stack, count);
 
   std::signal(sig, SIG_DFL);
@@ -211,6 +297,7 @@ LONG WINAPI HandleException(EXCEPTION_POINTERS* exception_info) {
   int count = static_cast<int>(CaptureStackBackTrace(0, 64, stack, nullptr));
   WriteCrashLogHeader("unhandled exception");
   WriteExceptionDetails(exception_info);
+  WriteFlightRecorder();
   WriteCrashStackDetailed(stack, count);
   return EXCEPTION_EXECUTE_HANDLER;
 }
@@ -241,6 +328,7 @@ void HandleTerminate() {
 #ifdef _WIN32
   int count = static_cast<int>(CaptureStackBackTrace(0, 64, stack, nullptr));
   WriteCrashLogHeader("terminate");
+  WriteFlightRecorder();
   WriteCrashStackDetailed(stack, count);
 #else
   int count = backtrace(stack, 64);
@@ -252,26 +340,64 @@ void HandleTerminate() {
 
 Random::Random() {
   std::random_device rd;
-  rng_.seed(rd());
+  key_ = RngMix((static_cast<uint64_t>(rd()) << 32) | rd());
+}
+
+Random::Random(uint32_t seed) : key_(RngMix(seed)) {}
+
+Random Random::Stream(uint64_t seed, uint64_t entity, uint64_t tick, RngPurpose purpose) {
+  return FromKey(RngKey(seed, entity, tick, purpose));
+}
+
+Random Random::FromKey(uint64_t key) {
+  Random out(0u);
+  out.key_ = key;
+  return out;
 }
 
-Random::Random(uint32_t seed) : rng_(seed) {}
+uint32_t Random::NextU32() {
+  return static_cast<uint32_t>(Next() >> 32);
+}
 
 int Random::RangeInt(int min_inclusive, int max_inclusive) {
-  std::uniform_int_distribution<int> dist(min_inclusive, max_inclusive);
-  return dist(rng_);
+  return RngRangeInt(Next(), min_inclusive, max_inclusive);
 }
 
 float Random::RangeFloat(float min_inclusive, float max_inclusive) {
-  std::uniform_real_distribution<float> dist(min_inclusive, max_inclusive);
-  return dist(rng_);
+  return min_inclusive + (max_inclusive - min_inclusive) * RngFloat01(Next());
 }
 
 bool Random::Chance(float probability) {
   if (probability <= 0.0f) return false;
   if (probability >= 1.0f) return true;
-  std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-  return dist(rng_) < probability;
+  return RngFloat01(Next()) < probability;
+}
+
+FrameArena::FrameArena(size_t initialBytes) : buffer_(initialBytes) {
+  resource_.emplace(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource());
+}
+
+void FrameArena::Reset() {
+  highWater_ = std::max(highWater_, used_);
+  if (used_ > buffer_.size()) {
+    resource_.reset();
+    buffer_.assign(std::max(used_, buffer_.size() * 2), std::byte{0});
+    resource_.emplace(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource());
+    regrows_++;
+  } else {
+    resource_->release();
+  }
+  used_ = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+  used_ += bytes + alignment - 1;
+  return resource_->allocate(bytes, alignment);
+}
+
+FrameArena& SimFrameArena() {
+  static FrameArena arena;
+  return arena;
 }
 
 void InstallCrashHandlers() {
@@ -295,10 +421,6 @@ void InstallCrashHandlers() {
   std::set_terminate(HandleTerminate);
 }
 
-void CrashContextSetStage(const char* stage) {
-  std::snprintf(g_crash_context.stage, sizeof(g_crash_context.stage), "%s",
-                stage ? stage : "");
-}
 
 void CrashContextSetWorld(int width, int height) {
   g_crash_context.worldW.store(width);
@@ -309,13 +431,29 @@ void CrashContextSetDay(int dayCount) { g_crash_context.dayCount.store(dayCount)
 
 void CrashContextSetPopulation(int population) { g_crash_context.population.store(population); }
 
-void CrashContextSetHuman(int id, int x, int y) {
-  g_crash_context.lastHumanId.store(id);
-  g_crash_context.lastHumanX.store(x);
-  g_crash_context.lastHumanY.store(y);
+void CrashContextSetNote(const char* note) {
+  g_crash_context.note.store((note && note[0] != '\0') ? note : "-", std::memory_order_relaxed);
 }
 
-void CrashContextSetNote(const char* note) {
-  const char* value = (note && note[0] != '\0') ? note : "-";
-  std::snprintf(g_crash_context.note, sizeof(g_crash_context.note), "%s", value);
+#if FUNSIM_FLIGHT_RECORDER
+void CrashContextSetStage(const char* stage) {
+  FlightRing* ring = ThreadFlightRing();
+  if (!ring) return;
+  ring->stage = stage ? stage : "";
+  FlightRecord(ring, -1, 0, 0);
 }
+
+void CrashContextSetTick(int tick) {
+  FlightRing* ring = ThreadFlightRing();
+  if (ring) ring->tick = tick;
+}
+
+void CrashContextSetHuman(int id, int x, int y) {
+  FlightRing* ring = ThreadFlightRing();
+  if (!ring) return;
+  if constexpr (FUNSIM_FLIGHT_RECORDER_HUMAN_SAMPLE > 1) {
+    if ((ring->sampleCounter++ & (FUNSIM_FLIGHT_RECORDER_HUMAN_SAMPLE - 1)) != 0) return;
+  }
+  FlightRecord(ring, id, x, y);
+}
+#endif
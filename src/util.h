@@ -1,25 +1,159 @@
 #pragma once
 
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <memory_resource>
+#include <optional>
 #include <random>
+#include <type_traits>
+#include <vector>
+
+// Draws are a pure function of (key, counter), so any thread can reproduce an entity's numbers
+// from (seed, entity, tick, purpose).
+// Values are mixed into stream keys; never renumber them, or recorded replays stop matching.
+enum class RngPurpose : uint32_t {
+  General = 0,
+  Rehydrate = 1,
+  Macro = 4,
+  Tasks = 5,
+  Economy = 6,
+};
+
+inline uint64_t RngMix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t RngKey(uint64_t seed, uint64_t entity, uint64_t tick, RngPurpose purpose) {
+  uint64_t key = RngMix(seed ^ (static_cast<uint64_t>(purpose) << 56));
+  key = RngMix(key ^ entity);
+  return RngMix(key ^ tick);
+}
+
+inline uint64_t RngAt(uint64_t key, uint64_t counter) {
+  return RngMix(key ^ (counter * 0xD1B54A32D192ED03ull));
+}
+
+inline int RngRangeInt(uint64_t bits, int min_inclusive, int max_inclusive) {
+  if (max_inclusive <= min_inclusive) return min_inclusive;
+  const uint64_t span = static_cast<uint64_t>(static_cast<int64_t>(max_inclusive) - min_inclusive) + 1u;
+  return static_cast<int>(static_cast<int64_t>(min_inclusive) +
+                          static_cast<int64_t>(((bits >> 32) * span) >> 32));
+}
+
+inline float RngFloat01(uint64_t bits) {
+  return static_cast<float>(bits >> 40) * (1.0f / 16777216.0f);
+}
 
 class Random {
  public:
   Random();
   explicit Random(uint32_t seed);
+  static Random Stream(uint64_t seed, uint64_t entity, uint64_t tick, RngPurpose purpose);
+  static Random FromKey(uint64_t key);
 
   int RangeInt(int min_inclusive, int max_inclusive);
   float RangeFloat(float min_inclusive, float max_inclusive);
   bool Chance(float probability);
+  uint32_t NextU32();
+
+  uint64_t Key() const { return key_; }
+  uint64_t Counter() const { return counter_; }
+
+ private:
+  uint64_t Next() { return RngAt(key_, counter_++); }
+
+  uint64_t key_ = 0;
+  uint64_t counter_ = 0;
+};
+
+// Order-sensitive running hash of simulation state for replay determinism checks. Floats are
+// hashed by bit pattern, so any change in the last ulp shows up.
+class StateHasher {
+ public:
+  template <typename T>
+  void Add(T value) {
+    if constexpr (std::is_enum_v<T>) {
+      Mix(static_cast<uint64_t>(static_cast<std::underlying_type_t<T>>(value)));
+    } else if constexpr (std::is_same_v<T, float>) {
+      Mix(std::bit_cast<uint32_t>(value));
+    } else if constexpr (std::is_same_v<T, double>) {
+      Mix(std::bit_cast<uint64_t>(value));
+    } else {
+      Mix(static_cast<uint64_t>(value));
+    }
+  }
+  void AddBytes(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    Mix(size);
+    for (size_t i = 0; i < size; ++i) Mix(bytes[i]);
+  }
+  uint64_t Digest() const { return RngMix(hash_); }
 
  private:
-  std::mt19937 rng_;
+  void Mix(uint64_t value) { hash_ = (((hash_ << 5) | (hash_ >> 59)) ^ value) * 0x517CC1B727220A95ull; }
+
+  uint64_t hash_ = 0;
+};
+
+// Bump allocator for simulation temporaries that die within one tick or day step; hand it to
+// std::pmr containers. Reset() drops everything at once and, if the step spilled past the
+// buffer, regrows the buffer to the high-water mark, so steady-state steps allocate nothing.
+// Not thread-safe: only the simulation thread may use SimFrameArena().
+class FrameArena final : public std::pmr::memory_resource {
+ public:
+  explicit FrameArena(size_t initialBytes = 64 * 1024);
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  void Reset();
+  size_t Capacity() const { return buffer_.size(); }
+  size_t HighWater() const { return highWater_; }
+  // Resets that had to grow the buffer; stops increasing once the workload is steady.
+  int Regrows() const { return regrows_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void*, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::vector<std::byte> buffer_;
+  std::optional<std::pmr::monotonic_buffer_resource> resource_;
+  size_t used_ = 0;
+  size_t highWater_ = 0;
+  int regrows_ = 0;
 };
 
+// Reset at the start of every tick and day step by the SimStep* functions.
+FrameArena& SimFrameArena();
+
+// Crash breadcrumbs go to a small lock-free ring owned by the calling thread; the crash handler
+// dumps every thread's ring. Stage and note strings must have static storage (literals).
+// Build with FUNSIM_FLIGHT_RECORDER=0 to compile the per-human/stage hooks out, or raise
+// FUNSIM_FLIGHT_RECORDER_HUMAN_SAMPLE (power of two) to keep only every Nth human breadcrumb.
+#ifndef FUNSIM_FLIGHT_RECORDER
+#define FUNSIM_FLIGHT_RECORDER 1
+#endif
+#ifndef FUNSIM_FLIGHT_RECORDER_HUMAN_SAMPLE
+#define FUNSIM_FLIGHT_RECORDER_HUMAN_SAMPLE 1
+#endif
+
 void InstallCrashHandlers();
-void CrashContextSetStage(const char* stage);
 void CrashContextSetWorld(int width, int height);
 void CrashContextSetDay(int dayCount);
 void CrashContextSetPopulation(int population);
-void CrashContextSetHuman(int id, int x, int y);
 void CrashContextSetNote(const char* note);
+#if FUNSIM_FLIGHT_RECORDER
+void CrashContextSetStage(const char* stage);
+void CrashContextSetTick(int tick);
+void CrashContextSetHuman(int id, int x, int y);
+#else
+inline void CrashContextSetStage(const char*) {}
+inline void CrashContextSetTick(int) {}
+inline void CrashContextSetHuman(int, int, int) {}
+#endif
@@ -95,6 +95,19 @@ uint8_t ClampU8(int value) {
   return static_cast<uint8_t>(value);
 }
 
+// Bit per ResourceKind held by tile.
+inline uint32_t ResourceBits(const Tile& tile) {
+  uint32_t bits = 0;
+  if (tile.type == TileType::Land && !tile.burning) {
+    if (tile.food > 0) bits |= 1u << static_cast<uint32_t>(ResourceKind::Food);
+    if (tile.trees > 0) bits |= 1u << static_cast<uint32_t>(ResourceKind::Trees);
+  }
+  if (tile.building == BuildingType::Farm && tile.farmStage >= Settlement::kFarmReadyStage) {
+    bits |= 1u << static_cast<uint32_t>(ResourceKind::ReadyFarm);
+  }
+  return bits;
+}
+
 inline uint16_t BaseFoodFromTile(const Tile& tile) {
   if (tile.type != TileType::Land || tile.burning) return 0;
   int value = static_cast<int>(tile.food) * 120 + static_cast<int>(tile.trees) * 8;
@@ -123,6 +136,15 @@ void World::ResizeStorage() {
   homeSourceStampByTile_.assign(
       static_cast<size_t>(std::max<int64_t>(0, static_cast<int64_t>(width_) * height_)), 0u);
   homeSourceGeneration_ = 1;
+  resourceLevels_.clear();
+  for (int shift = kResourceCellShift; width_ > 0 && height_ > 0; ++shift) {
+    ResourceLevel level;
+    level.cellsX = ((width_ - 1) >> shift) + 1;
+    level.cellsY = ((height_ - 1) >> shift) + 1;
+    level.counts.assign(static_cast<size_t>(level.cellsX * level.cellsY * kResourceKinds), 0);
+    resourceLevels_.push_back(std::move(level));
+    if (resourceLevels_.back().cellsX == 1 && resourceLevels_.back().cellsY == 1) break;
+  }
   terrainVersion_ = 1;
 }
 
@@ -154,9 +176,139 @@ const Tile& World::At(int x, int y) const {
   return AtUnchecked(x, y);
 }
 
-void World::ApplyTotalsDelta(const Tile& before, const Tile& after) {
+void World::ApplyTotalsDelta(int x, int y, const Tile& before, const Tile& after) {
   totalTrees_ += static_cast<int64_t>(after.trees) - static_cast<int64_t>(before.trees);
   totalFood_ += static_cast<int64_t>(after.food) - static_cast<int64_t>(before.food);
+
+  const uint32_t beforeBits = ResourceBits(before);
+  const uint32_t afterBits = ResourceBits(after);
+  if (beforeBits != afterBits) ApplyResourceDelta(x, y, beforeBits, afterBits);
+}
+
+void World::ApplyResourceDelta(int x, int y, uint32_t beforeBits, uint32_t afterBits) {
+  for (int kind = 0; kind < kResourceKinds; ++kind) {
+    const int delta = static_cast<int>((afterBits >> kind) & 1u) -
+                      static_cast<int>((beforeBits >> kind) & 1u);
+    if (delta == 0) continue;
+    int shift = kResourceCellShift;
+    for (ResourceLevel& level : resourceLevels_) {
+      const int cell = (y >> shift) * level.cellsX + (x >> shift);
+      level.counts[static_cast<size_t>(cell * kResourceKinds + kind)] += delta;
+      shift++;
+    }
+  }
+}
+
+void World::RebuildResourcePyramid() {
+  for (ResourceLevel& level : resourceLevels_) {
+    std::fill(level.counts.begin(), level.counts.end(), 0);
+  }
+  for (int y = 0; y < height_; ++y) {
+    for (int x = 0; x < width_; ++x) {
+      const uint32_t bits = ResourceBits(AtUnchecked(x, y));
+      if (bits != 0) ApplyResourceDelta(x, y, 0, bits);
+    }
+  }
+}
+
+bool World::FindNearestWithResource(int x, int y, ResourceKind kind, int maxRadius, int& outX,
+                                    int& outY) const {
+  if (resourceLevels_.empty() || maxRadius < 0) return false;
+  // Start at the first level whose cells are at least as wide as the radius, visiting only the
+  // cells the query diamond can reach.
+  int level = 0;
+  while (level + 1 < static_cast<int>(resourceLevels_.size()) &&
+         (1 << (kResourceCellShift + level)) <= maxRadius) {
+    level++;
+  }
+  const ResourceLevel& start = resourceLevels_[static_cast<size_t>(level)];
+  const int shift = kResourceCellShift + level;
+  const int minCellX = std::max(0, x - maxRadius) >> shift;
+  const int minCellY = std::max(0, y - maxRadius) >> shift;
+  const int maxCellX = std::min(start.cellsX - 1, std::max(0, x + maxRadius) >> shift);
+  const int maxCellY = std::min(start.cellsY - 1, std::max(0, y + maxRadius) >> shift);
+  int bestDist = maxRadius;
+  int bestX = -1;
+  int bestY = -1;
+  for (int cellY = minCellY; cellY <= maxCellY; ++cellY) {
+    for (int cellX = minCellX; cellX <= maxCellX; ++cellX) {
+      FindNearestInCell(level, cellX, cellY, static_cast<int>(kind), x, y, bestDist, bestX,
+                        bestY);
+    }
+  }
+  if (bestX == -1) return false;
+  outX = bestX;
+  outY = bestY;
+  return true;
+}
+
+void World::FindNearestInCell(int level, int cellX, int cellY, int kind, int x, int y,
+                              int& bestDist, int& bestX, int& bestY) const {
+  const ResourceLevel& cells = resourceLevels_[static_cast<size_t>(level)];
+  const size_t cell = static_cast<size_t>(cellY * cells.cellsX + cellX);
+  if (cells.counts[cell * kResourceKinds + static_cast<size_t>(kind)] == 0) return;
+
+  const int shift = kResourceCellShift + level;
+  const int x0 = cellX << shift;
+  const int y0 = cellY << shift;
+  const int x1 = std::min(width_, x0 + (1 << shift)) - 1;
+  const int y1 = std::min(height_, y0 + (1 << shift)) - 1;
+  const int boxDist = std::max({0, x0 - x, x - x1}) + std::max({0, y0 - y, y - y1});
+  // Equal distance still descends: a tile there may win the (y, x) tie-break.
+  if (boxDist > bestDist) return;
+
+  if (level == 0) {
+    // Finest cells never straddle a chunk, so each row is contiguous chunk storage.
+    const uint32_t bit = 1u << static_cast<uint32_t>(kind);
+    const Chunk& chunk =
+        chunks_[static_cast<size_t>((y0 / kChunkTiles) * chunksX_ + x0 / kChunkTiles)];
+    for (int ty = y0; ty <= y1; ++ty) {
+      const int dy = std::abs(ty - y);
+      if (dy > bestDist) continue;
+      const Tile* row = &chunk.tiles[static_cast<size_t>((ty % kChunkTiles) * kChunkTiles)];
+      const int fromX = std::max(x0, x - (bestDist - dy));
+      const int toX = std::min(x1, x + (bestDist - dy));
+      for (int tx = fromX; tx <= toX; ++tx) {
+        const int dist = dy + std::abs(tx - x);
+        if (dist > bestDist) continue;
+        if ((ResourceBits(row[tx % kChunkTiles]) & bit) == 0) continue;
+        if (dist < bestDist || bestX == -1 || ty < bestY || (ty == bestY && tx < bestX)) {
+          bestDist = dist;
+          bestX = tx;
+          bestY = ty;
+        }
+      }
+    }
+    return;
+  }
+
+  // Visit the (up to) four children nearest first so later ones are pruned sooner.
+  const ResourceLevel& children = resourceLevels_[static_cast<size_t>(level - 1)];
+  const int childShift = shift - 1;
+  std::array<std::pair<int, int>, 4> order{};
+  int childCount = 0;
+  for (int sub = 0; sub < 4; ++sub) {
+    const int childX = cellX * 2 + (sub & 1);
+    const int childY = cellY * 2 + (sub >> 1);
+    if (childX >= children.cellsX || childY >= children.cellsY) continue;
+    const int cx0 = childX << childShift;
+    const int cy0 = childY << childShift;
+    const int cx1 = cx0 + (1 << childShift) - 1;
+    const int cy1 = cy0 + (1 << childShift) - 1;
+    const int dist = std::max({0, cx0 - x, x - cx1}) + std::max({0, cy0 - y, y - cy1});
+    order[static_cast<size_t>(childCount++)] = {dist, sub};
+  }
+  for (int i = 1; i < childCount; ++i) {
+    for (int j = i; j > 0 && order[static_cast<size_t>(j)] < order[static_cast<size_t>(j - 1)];
+         --j) {
+      std::swap(order[static_cast<size_t>(j)], order[static_cast<size_t>(j - 1)]);
+    }
+  }
+  for (int i = 0; i < childCount; ++i) {
+    const int sub = order[static_cast<size_t>(i)].second;
+    FindNearestInCell(level - 1, cellX * 2 + (sub & 1), cellY * 2 + (sub >> 1), kind, x, y,
+                      bestDist, bestX, bestY);
+  }
 }
 
 void World::UpdateIndicesForTile(int x, int y, const Tile& before, const Tile& after) {
@@ -180,6 +332,13 @@ void World::UpdateIndicesForTile(int x, int y, const Tile& before, const Tile& a
     }
   }
 
+  if (!buildingEventsReset_ &&
+      (before.building != after.building || before.buildingOwnerId != after.buildingOwnerId ||
+       before.farmStage != after.farmStage)) {
+    const BuildingState state{before.building, before.farmStage, before.buildingOwnerId};
+    if (pendingBuildingBefore_.emplace(key, state).second) pendingBuildingTiles_.push_back(key);
+  }
+
   auto beforeWell = before.building == BuildingType::Well;
   auto afterWell = after.building == BuildingType::Well;
   if (beforeWell != afterWell) {
@@ -187,7 +346,9 @@ void World::UpdateIndicesForTile(int x, int y, const Tile& before, const Tile& a
       wellTiles_.insert(key);
     } else {
       wellTiles_.erase(key);
-      wellRadiusByTile_.erase(key);
+      if (wellRadiusByTile_.erase(key) != 0 && !waterEventsReset_) {
+        pendingWaterTiles_.push_back(key);
+      }
     }
     wellRadiusDirty_ = true;
   }
@@ -216,6 +377,7 @@ void World::UpdateIndicesForTile(int x, int y, const Tile& before, const Tile& a
     }
     if (before.type == TileType::FreshWater || after.type == TileType::FreshWater) {
       wellRadiusDirty_ = true;
+      if (!waterEventsReset_) pendingWaterTiles_.push_back(key);
     }
   }
 }
@@ -226,6 +388,54 @@ bool World::ConsumeBuildingDirty() {
   return was;
 }
 
+bool World::ConsumeBuildingEvents(std::vector<BuildingEvent>& out) {
+  out.clear();
+  const bool incremental = !buildingEventsReset_;
+  buildingEventsReset_ = false;
+  if (incremental) {
+    out.reserve(pendingBuildingTiles_.size());
+    for (uint64_t key : pendingBuildingTiles_) {
+      BuildingEvent event;
+      UnpackCoord(key, event.x, event.y);
+      event.before = pendingBuildingBefore_[key];
+      const Tile& tile = AtUnchecked(event.x, event.y);
+      event.after = BuildingState{tile.building, tile.farmStage, tile.buildingOwnerId};
+      if (event.before != event.after) out.push_back(event);
+    }
+  }
+  pendingBuildingBefore_.clear();
+  pendingBuildingTiles_.clear();
+  return incremental;
+}
+
+void WorldCommandBuffer::ApplyTo(World& world) {
+  for (const Command& command : commands_) {
+    world.EditTile(command.x, command.y, [&](Tile& t) {
+      int trees = static_cast<int>(t.trees);
+      trees = std::clamp(trees + command.trees, 0, 255);
+      t.trees = static_cast<uint8_t>(trees);
+    });
+  }
+  commands_.clear();
+}
+
+bool World::ConsumeWaterSourceEvents(std::vector<WaterSourceEvent>& out) {
+  EnsureWellRadius();
+  out.clear();
+  const bool incremental = !waterEventsReset_;
+  waterEventsReset_ = false;
+  if (incremental) {
+    out.reserve(pendingWaterTiles_.size());
+    for (uint64_t key : pendingWaterTiles_) {
+      WaterSourceEvent event;
+      UnpackCoord(key, event.x, event.y);
+      out.push_back(event);
+    }
+  }
+  pendingWaterTiles_.clear();
+  return incremental;
+}
+
 void World::MarkTerrainDirty(int x, int y) {
   if (!terrainDirty_) {
     terrainDirty_ = true;
@@ -414,13 +624,30 @@ void World::EnsureWellRadius() const {
 }
 
 void World::RecomputeWellRadius() {
+  previousWellRadius_.swap(wellRadiusByTile_);
   wellRadiusByTile_.clear();
   wellRadiusDirty_ = false;
+  ComputeWellRadius();
+  if (!waterEventsReset_) {
+    for (const auto& [key, radius] : previousWellRadius_) {
+      if (wellRadiusByTile_.find(key) == wellRadiusByTile_.end()) pendingWaterTiles_.push_back(key);
+    }
+    for (const auto& [key, radius] : wellRadiusByTile_) {
+      if (previousWellRadius_.find(key) == previousWellRadius_.end()) {
+        pendingWaterTiles_.push_back(key);
+      }
+    }
+  }
+  previousWellRadius_.clear();
+}
+
+void World::ComputeWellRadius() {
   if (wellTiles_.empty()) return;
 
-  std::unordered_set<uint64_t> strong;
-  std::unordered_set<uint64_t> medium;
-  std::unordered_set<uint64_t> weak;
+  FrameArena& arena = SimFrameArena();
+  std::pmr::unordered_set<uint64_t> strong(&arena);
+  std::pmr::unordered_set<uint64_t> medium(&arena);
+  std::pmr::unordered_set<uint64_t> weak(&arena);
 
   auto hasFreshWaterWithin = [&](int cx, int cy, int radius) {
     for (int dy = -radius; dy <= radius; ++dy) {
@@ -436,7 +663,8 @@ void World::RecomputeWellRadius() {
     return false;
   };
 
-  auto hasWellInSetWithin = [&](int cx, int cy, int radius, const std::unordered_set<uint64_t>& set) {
+  auto hasWellInSetWithin = [&](int cx, int cy, int radius,
+                                const std::pmr::unordered_set<uint64_t>& set) {
     for (int dy = -radius; dy <= radius; ++dy) {
       int y = cy + dy;
       if (y < 0 || y >= height_) continue;
@@ -499,13 +727,13 @@ void World::RecomputeWellRadius() {
 void World::UpdateDaily(Random& rng, int dayDelta) {
   if (dayDelta < 1) dayDelta = 1;
   CrashContextSetStage("World::UpdateDaily");
-  RecomputeWellRadius();
+  EnsureWellRadius();
 
   auto updateOneDay = [&]() {
-    std::vector<uint64_t> ignite;
+    std::pmr::vector<uint64_t> ignite(&SimFrameArena());
     ignite.reserve(128);
 
-    std::vector<uint64_t> burningSnapshot;
+    std::pmr::vector<uint64_t> burningSnapshot(&SimFrameArena());
     burningSnapshot.reserve(burningTiles_.size());
     for (uint64_t key : burningTiles_) {
       burningSnapshot.push_back(key);
@@ -575,7 +803,7 @@ void World::UpdateDaily(Random& rng, int dayDelta) {
       SetBurning(x, y, true, kFireDuration);
     }
 
-    std::vector<uint64_t> farmsSnapshot;
+    std::pmr::vector<uint64_t> farmsSnapshot(&SimFrameArena());
     farmsSnapshot.reserve(farmGrowTiles_.size());
     for (uint64_t key : farmGrowTiles_) {
       farmsSnapshot.push_back(key);
@@ -727,6 +955,11 @@ bool World::LoadMap(const std::string& path) {
   buildingTiles_.clear();
   farmGrowTiles_.clear();
   wellTiles_.clear();
+  pendingBuildingBefore_.clear();
+  pendingBuildingTiles_.clear();
+  buildingEventsReset_ = true;
+  pendingWaterTiles_.clear();
+  waterEventsReset_ = true;
   EnsureHomeSourceGrid();
   std::fill(homeSourceStampByTile_.begin(), homeSourceStampByTile_.end(), 0u);
   homeSourceGeneration_ = 1;
@@ -769,5 +1002,27 @@ bool World::LoadMap(const std::string& path) {
     }
   }
 
+  RebuildResourcePyramid();
   return true;
 }
+
+uint64_t World::StateHash() const {
+  StateHasher hasher;
+  hasher.Add(width_);
+  hasher.Add(height_);
+  for (int y = 0; y < height_; ++y) {
+    for (int x = 0; x < width_; ++x) {
+      const Tile& tile = AtUnchecked(x, y);
+      hasher.Add(static_cast<uint64_t>(tile.type) | (static_cast<uint64_t>(tile.trees) << 8) |
+                 (static_cast<uint64_t>(tile.food) << 16) |
+                 (static_cast<uint64_t>(tile.burning) << 24) |
+                 (static_cast<uint64_t>(tile.burnDaysRemaining) << 32) |
+                 (static_cast<uint64_t>(tile.building) << 40) |
+                 (static_cast<uint64_t>(tile.farmStage) << 48));
+      hasher.Add(tile.buildingOwnerId);
+    }
+  }
+  hasher.Add(totalTrees_);
+  hasher.Add(totalFood_);
+  return hasher.Digest();
+}
@@ -38,11 +38,46 @@ struct Tile {
   int buildingOwnerId = -1;
 };
 
+struct BuildingState {
+  BuildingType building = BuildingType::None;
+  uint8_t farmStage = 0;
+  int ownerId = -1;
+
+  bool operator==(const BuildingState&) const = default;
+};
+
+// Resources tracked by World's density pyramid. A tile counts for Food/Trees when it is unburnt
+// land holding some, and for ReadyFarm when it is a farm at harvest stage.
+enum class ResourceKind : uint8_t {
+  Food,
+  Trees,
+  ReadyFarm,
+};
+
+// One tile's building change since the last drain; before is the state at the first edit.
+struct BuildingEvent {
+  int x = 0;
+  int y = 0;
+  BuildingState before;
+  BuildingState after;
+};
+
+// A tile whose water-source status (fresh water, or a well with nonzero radius) may have
+// changed since the last drain.
+struct WaterSourceEvent {
+  int x = 0;
+  int y = 0;
+};
+
 class World {
  public:
   static constexpr int kScentIters = 6;
   static constexpr int kWaterScentIters = 10;
   static constexpr int kChunkTiles = 32;
+  // Finest resource pyramid cells match settlement zones (8 tiles) and tile chunks exactly;
+  // level 2 is one chunk.
+  static constexpr int kResourceCellShift = 3;
+  static constexpr int kResourceKinds = 3;
 
   World(int width, int height);
 
@@ -58,7 +93,7 @@ class World {
     Tile& tile = AtUnchecked(x, y);
     Tile before = tile;
     fn(tile);
-    ApplyTotalsDelta(before, tile);
+    ApplyTotalsDelta(x, y, before, tile);
     UpdateIndicesForTile(x, y, before, tile);
   }
 
@@ -124,12 +159,23 @@ class World {
 
   int TotalTrees() const;
   int TotalFood() const;
+  // Nearest tile to (x, y) holding kind within maxRadius (Manhattan), ties broken by lower y
+  // then x. Walks the resource pyramid down from cells about the radius wide, pruning cells that
+  // are empty or farther than the best hit so far.
+  bool FindNearestWithResource(int x, int y, ResourceKind kind, int maxRadius, int& outX,
+                               int& outY) const;
 
   uint16_t FoodScentAt(int x, int y) const;
   uint16_t WaterScentAt(int x, int y) const;
   uint16_t FireRiskAt(int x, int y) const;
   uint16_t HomeScentAt(int x, int y) const;
   uint8_t WellRadiusAt(int x, int y) const;
+  // Settles the lazily rebuilt well radii so WellRadiusAt (and the water scent built on it) can
+  // be read from several threads at once.
+  void EnsureWellRadius() const;
+  bool IsWaterSourceAt(int x, int y) const {
+    return At(x, y).type == TileType::FreshWater || WellRadiusAt(x, y) != 0;
+  }
   void MarkBuildingDirty() { buildingDirty_ = true; }
   bool ConsumeBuildingDirty();
   void MarkTerrainDirty(int x, int y);
@@ -141,6 +187,16 @@ class World {
   bool LoadMap(const std::string& path);
 
   const std::unordered_set<uint64_t>& BuildingTiles() const { return buildingTiles_; }
+  // Moves building add/remove/owner/farm-stage changes since the last call into out, coalesced
+  // per tile in first-edit order. Returns false if the building set was replaced wholesale (map
+  // load or a new world) and consumers must rescan BuildingTiles() instead.
+  bool ConsumeBuildingEvents(std::vector<BuildingEvent>& out);
+  // Moves the tiles whose fresh water or supplied-well status changed since the last call into
+  // out (possibly repeated). Well radii are settled first. Returns false after a wholesale
+  // replacement, in which case consumers must rescan the map.
+  bool ConsumeWaterSourceEvents(std::vector<WaterSourceEvent>& out);
+  // Hash of the tiles and totals only; derived caches (scents, wells, indices) are left out.
+  uint64_t StateHash() const;
 
  private:
   struct Chunk {
@@ -161,13 +217,17 @@ class World {
   const Tile& AtUnchecked(int x, int y) const;
 
   void RecomputeWellRadius();
+  void ComputeWellRadius();
   void UpdateIndicesForTile(int x, int y, const Tile& before, const Tile& after);
-  void ApplyTotalsDelta(const Tile& before, const Tile& after);
+  void ApplyTotalsDelta(int x, int y, const Tile& before, const Tile& after);
+  void ApplyResourceDelta(int x, int y, uint32_t beforeBits, uint32_t afterBits);
+  void RebuildResourcePyramid();
+  void FindNearestInCell(int level, int cellX, int cellY, int kind, int x, int y, int& bestDist,
+                         int& bestX, int& bestY) const;
   static uint16_t Decay(uint16_t value, int dist);
   uint16_t BaseFoodAt(int x, int y) const;
   uint16_t BaseWaterAt(int x, int y) const;
   uint16_t BaseFireAt(int x, int y) const;
-  void EnsureWellRadius() const;
   void EnsureHomeSourceGrid();
   bool IsHomeSourceAt(int x, int y) const;
 
@@ -178,13 +238,28 @@ class World {
   int chunksY_ = 0;
   std::vector<Chunk> chunks_;
 
+  // Counts of resource-holding tiles per kind; level L cells span kResourceCellShift + L bits of
+  // tile coordinates, up to a level with a single cell.
+  struct ResourceLevel {
+    int cellsX = 0;
+    int cellsY = 0;
+    std::vector<int32_t> counts;  // (cellY * cellsX + cellX) * kResourceKinds + kind
+  };
+  std::vector<ResourceLevel> resourceLevels_;
+
   std::unordered_set<uint64_t> burningTiles_;
   std::unordered_set<uint64_t> buildingTiles_;
   std::unordered_set<uint64_t> farmGrowTiles_;
   std::unordered_set<uint64_t> wellTiles_;
+  std::unordered_map<uint64_t, BuildingState> pendingBuildingBefore_;
+  std::vector<uint64_t> pendingBuildingTiles_;
+  bool buildingEventsReset_ = true;
+  std::vector<uint64_t> pendingWaterTiles_;
+  bool waterEventsReset_ = true;
   std::vector<uint32_t> homeSourceStampByTile_;
   uint32_t homeSourceGeneration_ = 1;
   mutable std::unordered_map<uint64_t, uint8_t> wellRadiusByTile_;
+  std::unordered_map<uint64_t, uint8_t> previousWellRadius_;
   mutable bool wellRadiusDirty_ = true;
 
   int64_t totalTrees_ = 0;
@@ -197,3 +272,22 @@ class World {
   int terrainMaxX_ = 0;
   int terrainMaxY_ = 0;
 };
+
+// World edits recorded while the world is shared read-only (parallel settlement phases) and
+// applied afterwards, in recording order, on one thread.
+class WorldCommandBuffer {
+ public:
+  void AddTrees(int x, int y, int amount) { commands_.push_back({x, y, amount}); }
+  bool Empty() const { return commands_.empty(); }
+  // Applies every command and clears the buffer.
+  void ApplyTo(World& world);
+
+ private:
+  struct Command {
+    int x = 0;
+    int y = 0;
+    int trees = 0;
+  };
+
+  std::vector<Command> commands_;
+};